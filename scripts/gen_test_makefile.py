@@ -67,6 +67,9 @@ Makefile_variable_list.append(std_flags)
 sources = MakefileVariable("SOURCES", "driver func")
 Makefile_variable_list.append(sources)
 
+# Number of translation units that the test function is split into (yarpgen --tu-count)
+tu_count = 1
+
 headers = MakefileVariable("HEADERS", "init.h")
 Makefile_variable_list.append(headers)
 
@@ -85,6 +88,14 @@ def adjust_sources_to_standard():
         new_sources += common.append_file_ext(source) + " "
     sources.value = new_sources.strip()
 
+def set_tu_count(count):
+    # Should be called before set_standard(), because it adjusts file extensions
+    global tu_count
+    tu_count = count
+    if tu_count > 1:
+        for i in range(1, tu_count + 1):
+            sources.value += " func_" + str(i)
+
 def set_standard ():
     std_flags.value += common.StdID.get_full_pretty_std_name(common.selected_standard)
     adjust_sources_to_standard()
@@ -378,7 +389,7 @@ def gen_makefile(out_file_name, force, config_file, only_target=None, inject_bla
         # For performance reasons driver should always be compiled with -O0
         optflags_name = "$(OPTFLAGS)" if source_name != "driver" else "$(DRIVER_OPTFLAGS)"
         output += "\t" + "$(COMPILER) $(CXXFLAGS) $(STDFLAGS) " + optflags_name + " -o $@ -c $<"
-        if source_name == "func":
+        if source_name == "func" or source_name.startswith("func_"):
             output += " $(STATFLAGS) "
             if inject_blame_opt is not None:
                 output += " $(BLAMEOPTS) "
@@ -445,6 +456,8 @@ if __name__ == '__main__':
                         help="Source file to reduce")
     parser.add_argument("--collect-stat", dest="collect_stat", default="", type=str,
                         help="List of testing sets for statistics collection")
+    parser.add_argument("--tu-count", dest="tu_count", default=1, type=int,
+                        help="Number of translation units that the test function is split into")
     args = parser.parse_args()
 
     log_level = logging.DEBUG if args.verbose else logging.INFO
@@ -452,6 +465,7 @@ if __name__ == '__main__':
 
     common.check_python_version()
     common.set_standard(args.std_str)
+    set_tu_count(args.tu_count)
     set_standard()
     gen_makefile(os.path.abspath(args.out_file), args.force, args.config_file, creduce_file=args.creduce_file,
                  stat_targets=args.collect_stat.split())
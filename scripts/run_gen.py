@@ -199,6 +199,12 @@ class Test(object):
     # Static variables
     # Don't save anything other than log-file if compile time expires
     ignore_comp_time_exp = True
+    # The generator bakes the expected checksum into the test,
+    # so the unoptimized reference runs are not needed
+    precompute = False
+    # Upper bound for the compile cost estimated by the generator (0 means no limit).
+    # Expensive seeds are pruned instead of burning the compiler timeout.
+    max_compile_cost = 0
 
     # Generate new test
     # stat is statistics object
@@ -210,6 +216,12 @@ class Test(object):
                             "--std=" + common.StdID.get_pretty_std_name(common.selected_standard)]
         if seed:
             yarpgen_run_list += ["-s", seed]
+        if gen_test_makefile.tu_count > 1:
+            yarpgen_run_list += ["--tu-count=" + str(gen_test_makefile.tu_count)]
+        if Test.precompute:
+            yarpgen_run_list += ["--check-algo=precompute"]
+        if Test.max_compile_cost:
+            yarpgen_run_list += ["--max-compile-cost=" + str(Test.max_compile_cost)]
         self.yarpgen_cmd = " ".join(str(p) for p in yarpgen_run_list)
         self.ret_code, self.stdout, self.stderr, self.is_time_expired, self.elapsed_time = \
             common.run_cmd(yarpgen_run_list, yarpgen_timeout, proc_num, yarpgen_mem_limit)
@@ -376,6 +388,9 @@ class Test(object):
                 bad_cmplrs.add(run.target.specs.name)
             if len(good_cmplrs) < len(bad_cmplrs):
                 good_runs, bad_runs = bad_runs, good_runs
+            # The precomputed checksum overrules the vote
+            if Test.precompute and "ERROR" in good_runs[0].checksum:
+                good_runs, bad_runs = bad_runs, good_runs
         else:
             # More than 2 different results.
             # Treat them all as bad
@@ -850,6 +865,9 @@ class TestRun(object):
     def build(self):
         # build
         build_params_list = ["make", "-f", gen_test_makefile.Test_Makefile_name, self.optset]
+        # Translation units of the test function are independent
+        if gen_test_makefile.tu_count > 1:
+            build_params_list.insert(1, "-j" + str(gen_test_makefile.tu_count))
         self.build_cmd = " ".join(str(p) for p in build_params_list)
         self.build_ret_code, self.build_stdout, self.build_stderr, self.is_build_time_expired, self.build_elapsed_time = \
             common.run_cmd(build_params_list, compiler_timeout, self.proc_num, compiler_mem_limit)
@@ -1635,6 +1653,9 @@ def gen_and_test(num, makefile, lock, end_time, task_queue, stat, targets, blame
             # Skip the target we are not supposed to run.
             if t.specs.name not in targets:
                 continue
+            # The reference runs are replaced by the precomputed checksum.
+            if Test.precompute and "no_opt" in t.name:
+                continue
             test_run = TestRun(test=test, stat=stat, target=t, proc_num=num,
                                parse_stats= True if (t.name in stat_targets) else False)
             if not test_run.build():
@@ -1750,6 +1771,14 @@ Use specified folder for testing
                         help="Do not run tmp_cleaner.sh script during the run")
     parser.add_argument("--collect-stat", dest="collect_stat", default="", type=str,
                         help="List of testing sets for statistics collection")
+    parser.add_argument("--tu-count", dest="tu_count", default=1, type=int,
+                        help="Split the test function into the given number of translation units "
+                             "and build them in parallel")
+    parser.add_argument("--precompute", dest="precompute", default=False, action="store_true",
+                        help="Let the generator precompute the expected checksum and skip the no_opt "
+                             "reference runs")
+    parser.add_argument("--max-compile-cost", dest="max_compile_cost", default=0, type=int,
+                        help="Let the generator prune the tests whose estimated compile cost exceeds the limit")
     parser.add_argument("--ignore-comp-time-exp", dest="ignore_comp_time_exp", default=True, action="store_true",
                         help="Don't save files (except log-file) when compile time expires")
     args = parser.parse_args()
@@ -1772,11 +1801,14 @@ Use specified folder for testing
         creduce_n = args.creduce
 
     common.set_standard(args.std_str)
+    gen_test_makefile.set_tu_count(args.tu_count)
     gen_test_makefile.set_standard()
 
     targets = re.split(' |,', args.target)
 
     Test.ignore_comp_time_exp = args.ignore_comp_time_exp
+    Test.precompute = args.precompute
+    Test.max_compile_cost = args.max_compile_cost
     prepare_env_and_start_testing(os.path.abspath(args.out_dir), args.timeout, targets, args.num_jobs,
                                   args.config_file, args.seeds_option_value, args.blame, args.creduce,
                                   args.no_tmp_cleaner, args.collect_stat)
@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2020, Intel Corporation
+Copyright (c) 2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "yarpgen.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace yarpgen;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__            \
+                      << ", function " << __func__ << "():\n    " << (msg)     \
+                      << std::endl;                                            \
+            abort();                                                           \
+        }                                                                      \
+    } while (false)
+
+static bool sameFiles(const GeneratedFile &a, const GeneratedFile &b) {
+    return a.name == b.name && a.content == b.content;
+}
+
+static bool samePrograms(const GeneratedProgram &a, const GeneratedProgram &b) {
+    if (a.seed != b.seed || !sameFiles(a.init, b.init) ||
+        !sameFiles(a.func, b.func) || !sameFiles(a.driver, b.driver) ||
+        a.func_parts.size() != b.func_parts.size() ||
+        a.has_checksum != b.has_checksum || a.checksum != b.checksum)
+        return false;
+    for (size_t i = 0; i < a.func_parts.size(); ++i)
+        if (!sameFiles(a.func_parts.at(i), b.func_parts.at(i)))
+            return false;
+    return true;
+}
+
+static GenOptions createOptions(const std::vector<std::string> &args) {
+    GenOptions options;
+    std::string err_msg;
+    CHECK(options.set(args, err_msg), "Can't set options: " + err_msg);
+    return options;
+}
+
+static void generateTest() {
+    GenOptions options;
+    GeneratedProgram program = generate(options, 42);
+    CHECK(program.seed == 42, "Seed");
+    CHECK(program.init.name == "init.h", "Init file name");
+    CHECK(program.func.name == "func.cpp", "Func file name");
+    CHECK(program.driver.name == "driver.cpp", "Driver file name");
+    CHECK(!program.func.content.empty(), "Empty test function");
+    CHECK(program.func_parts.empty(), "Unexpected translation units");
+    CHECK(!program.has_checksum, "Checksum of the default check algorithm");
+    CHECK(samePrograms(program, generate(options, 42)), "Reproducibility");
+
+    // The random seed is reported, so the test can be reproduced
+    GeneratedProgram rand_program = generate(options, 0);
+    CHECK(rand_program.seed != 0, "Random seed");
+    CHECK(samePrograms(rand_program, generate(options, rand_program.seed)),
+          "Reproducibility of the random seed");
+
+    // Every copy of the options is independent
+    GenOptions c_options = createOptions({"--std=c"});
+    GenOptions c_options_copy(c_options);
+    std::string err_msg;
+    CHECK(c_options_copy.set({"--std=ispc"}, err_msg), err_msg);
+    CHECK(generate(c_options, 42).func.name == "func.c", "C file name");
+    CHECK(generate(c_options_copy, 42).func.name == "func.ispc",
+          "ISPC file name");
+    CHECK(generate(options, 42).func.name == "func.cpp", "Default options");
+
+    GeneratedProgram split_program =
+        generate(createOptions({"--tu-count=3"}), 42);
+    CHECK(split_program.func_parts.size() == 3, "Translation units");
+
+    for (const auto &check_algo : {"precompute", "tree-hash"}) {
+        GenOptions check_options =
+            createOptions({"--check-algo=" + std::string(check_algo)});
+        GeneratedProgram check_program = generate(check_options, 42);
+        CHECK(check_program.has_checksum,
+              "Checksum of " + std::string(check_algo) + " check algorithm");
+    }
+
+    GeneratedProgram stream_program =
+        generate(createOptions({"--stream-emit=true"}), 42);
+    CHECK(!stream_program.func.content.empty(), "Streamed test function");
+}
+
+static void setErrorTest() {
+    GenOptions options;
+    GeneratedProgram program = generate(options, 42);
+
+    // Rejected arguments leave the options unchanged
+    for (const auto &args : std::vector<std::vector<std::string>>{
+             {"--unknown"},
+             {"--std=c", "--std=pascal"},
+             {"--std=c", "--max-dynamic-ops=many"},
+             {"--std=c", "--batch=2"},
+             {"--stats-json=true"},
+             {"--track-allocs=true"},
+             {"--trace=trace.json"},
+             {"--std=sycl", "--tu-count=2"},
+             {"--stream-emit=true", "--populate-jobs=2"}}) {
+        std::string err_msg;
+        CHECK(!options.set(args, err_msg), "Accepted " + args.back());
+        CHECK(!err_msg.empty(), "No error message for " + args.back());
+        CHECK(samePrograms(program, generate(options, 42)),
+              "Options are changed by " + args.back());
+    }
+}
+
+static void concurrencyTest() {
+    GenOptions options;
+    GeneratedProgram expected = generate(options, 42);
+
+    const size_t threads_num = 4;
+    std::vector<GeneratedProgram> programs(threads_num);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threads_num; ++i)
+        threads.emplace_back([&options, &programs, i]() {
+            programs.at(i) = generate(options, 42);
+        });
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &program : programs)
+        CHECK(samePrograms(expected, program), "Concurrent generation");
+}
+
+// The files contain the invocation that reproduces the test, so it is the only
+// line that can depend on the options that don't change the test
+static GeneratedProgram dropInvocation(GeneratedProgram program) {
+    auto drop_line = [](GeneratedFile &file) {
+        std::string prefix = "Invocation:";
+        size_t start = file.content.find(prefix);
+        if (start != std::string::npos)
+            file.content.erase(start, file.content.find('\n', start) - start);
+    };
+    drop_line(program.init);
+    drop_line(program.func);
+    drop_line(program.driver);
+    for (auto &part : program.func_parts)
+        drop_line(part);
+    return program;
+}
+
+// The test doesn't depend on the number of population threads
+static void populateJobsTest() {
+    for (const auto &std : {"c", "c++", "ispc", "sycl"}) {
+        std::string std_arg = "--std=" + std::string(std);
+        GenOptions options = createOptions({std_arg, "--populate-jobs=1"});
+        GenOptions par_options = createOptions({std_arg, "--populate-jobs=4"});
+        for (uint64_t seed : {1, 2, 3, 42, 777}) {
+            GeneratedProgram program = dropInvocation(generate(options, seed));
+            CHECK(samePrograms(program,
+                               dropInvocation(generate(par_options, seed))),
+                  std_arg + " --seed=" + std::to_string(seed) +
+                      " depends on the number of population jobs");
+        }
+    }
+}
+
+int main() {
+    generateTest();
+    setErrorTest();
+    concurrencyTest();
+    populateJobsTest();
+}
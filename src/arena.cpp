@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2019-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "arena.h"
+#include "session.h"
+
+using namespace yarpgen;
+
+Arena::Arena() : cur_ptr(nullptr), cur_left(0), alloc_stats(nullptr) {
+    free_lists.fill(nullptr);
+}
+
+void *Arena::allocate(size_t size) {
+    size_t size_class = getSizeClass(size);
+    size_t chunk_size = (size_class + 1) * granularity;
+    if (alloc_stats != nullptr)
+        alloc_stats->addArenaChunk(chunk_size);
+
+    if (size_class < size_classes_num && free_lists[size_class] != nullptr) {
+        FreeChunk *chunk = free_lists[size_class];
+        free_lists[size_class] = chunk->next;
+        return chunk;
+    }
+
+    if (chunk_size > cur_left) {
+        // Big chunks get a block of their own, so we don't waste the rest
+        // of the current block
+        if (chunk_size > block_size / 4) {
+            if (alloc_stats != nullptr)
+                alloc_stats->addArenaBlock(chunk_size);
+            blocks.emplace_back(new char[chunk_size]);
+            return blocks.back().get();
+        }
+        if (alloc_stats != nullptr)
+            alloc_stats->addArenaBlock(block_size);
+        blocks.emplace_back(new char[block_size]);
+        cur_ptr = blocks.back().get();
+        cur_left = block_size;
+    }
+    void *ret = cur_ptr;
+    cur_ptr += chunk_size;
+    cur_left -= chunk_size;
+    return ret;
+}
+
+void Arena::deallocate(void *ptr, size_t size) {
+    // Big chunks are released only with the whole arena.
+    // The same goes for the chunks that are released by a thread that doesn't
+    // own the arena (e.g., a parallel population task can drop the last
+    // reference to a node of its parent), because free lists are not
+    // thread-safe.
+    size_t size_class = getSizeClass(size);
+    if (size_class >= size_classes_num || &getCurrentArena() != this)
+        return;
+    if (alloc_stats != nullptr)
+        alloc_stats->removeArenaChunk((size_class + 1) * granularity);
+    auto chunk = static_cast<FreeChunk *>(ptr);
+    chunk->next = free_lists[size_class];
+    free_lists[size_class] = chunk;
+}
+
+Arena &yarpgen::getCurrentArena() {
+    return GenerationSession::getCurrent().getArena();
+}
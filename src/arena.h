@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2019-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "statistics.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace yarpgen {
+
+// Arena that owns the memory of all IR nodes of a single program.
+// Memory is taken from large blocks with a bump pointer and all of it is
+// released at once when the arena is destroyed. Chunks of small size classes
+// that were freed (e.g., temporary values of the evaluation) are kept in the
+// free lists and reused, so they don't inflate the footprint.
+// It is not thread-safe, because each arena belongs to a GenerationSession,
+// which is bound to at most one thread at a time.
+class Arena {
+  public:
+    Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size);
+    void deallocate(void *ptr, size_t size);
+
+    // Chunks and blocks are accounted only if the statistics are set
+    void setAllocStats(AllocStats *_alloc_stats) { alloc_stats = _alloc_stats; }
+
+  private:
+    static size_t constexpr block_size = 64 * 1024;
+    // All chunks are aligned the same way as malloc does it
+    static size_t constexpr granularity = alignof(std::max_align_t);
+    static size_t constexpr size_classes_num = 32;
+
+    static size_t getSizeClass(size_t size) {
+        return (size + granularity - 1) / granularity - 1;
+    }
+
+    struct FreeChunk {
+        FreeChunk *next;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *cur_ptr;
+    size_t cur_left;
+    std::array<FreeChunk *, size_classes_num> free_lists;
+    AllocStats *alloc_stats;
+};
+
+template <typename T> class ArenaAllocator {
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &_arena) : arena(&_arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.getArena()) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T)));
+    }
+    void deallocate(T *ptr, size_t n) { arena->deallocate(ptr, n * sizeof(T)); }
+
+    Arena *getArena() const { return arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const {
+        return arena == other.getArena();
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const {
+        return arena != other.getArena();
+    }
+
+  private:
+    Arena *arena;
+};
+
+// Arena of the generation session that is active on the current thread
+Arena &getCurrentArena();
+
+// Expressions and statements report their IRNodeKind, while data reports its
+// DataKind
+template <typename T, typename = void>
+struct HasIRNodeKind : std::false_type {};
+template <typename T>
+struct HasIRNodeKind<
+    T, std::enable_if_t<std::is_same<decltype(std::declval<T &>().getKind()),
+                                     IRNodeKind>::value>> : std::true_type {};
+template <typename T, typename = void> struct HasDataKind : std::false_type {};
+template <typename T>
+struct HasDataKind<
+    T, std::enable_if_t<std::is_same<decltype(std::declval<T &>().getKind()),
+                                     DataKind>::value>> : std::true_type {};
+
+// Creates a new IR node (expression, statement or data) in the arena of the
+// current session. Nodes are still reference-counted, but they don't go to
+// malloc, and the session can't be destroyed while they are alive.
+template <typename T, typename... Args>
+std::shared_ptr<T> makeIRNode(Args &&... args) {
+    auto ret = std::allocate_shared<T>(ArenaAllocator<T>(getCurrentArena()),
+                                       std::forward<Args>(args)...);
+    if constexpr (HasIRNodeKind<T>::value) {
+        Statistics &stats = Statistics::getInstance();
+        stats.addIRNode(ret->getKind());
+        stats.getAllocStats().addIRNode(ret->getKind(), sizeof(T));
+    }
+    else if constexpr (HasDataKind<T>::value)
+        Statistics::getInstance().getAllocStats().addData(ret->getKind(),
+                                                          sizeof(T));
+    return ret;
+}
+
+} // namespace yarpgen
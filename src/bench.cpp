@@ -0,0 +1,296 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+// Benchmark of the generator. It generates and emits a pinned corpus of seeds
+// for each language standard, and then measures the hot primitives of the
+// generation in isolation. The numbers are comparable only between the builds
+// that run on the same machine.
+//
+// Usage: yarpgen_bench [seeds_per_std]
+
+#include "context.h"
+#include "expr.h"
+#include "options.h"
+#include "program.h"
+#include "session.h"
+#include "statistics.h"
+#include "yarpgen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace yarpgen;
+
+// The first seed of the corpus. The corpus is fixed, so the results of
+// different builds can be compared.
+static constexpr uint64_t corpus_first_seed = 1;
+static constexpr size_t default_seeds_per_std = 16;
+
+// The results of the micro-benchmarks are stored here, so they are not
+// optimized away
+static volatile uint64_t result_sink = 0;
+
+// Sink that drops everything, so the emission doesn't measure the filesystem
+class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override {
+        return n;
+    }
+};
+
+static double getTimeMs(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> ret =
+        std::chrono::steady_clock::now() - start;
+    return ret.count();
+}
+
+static double getPercentile(std::vector<double> vals, size_t percent) {
+    // Nearest-rank method, so p99 of a small corpus is its slowest seed
+    std::sort(vals.begin(), vals.end());
+    size_t rank = (vals.size() * percent + 99) / 100;
+    return vals.at(std::max(rank, static_cast<size_t>(1)) - 1);
+}
+
+static GenOptions makeOptions(const std::string &std_name) {
+    GenOptions ret;
+    std::string err_msg;
+    if (!ret.set({"--std=" + std_name}, err_msg)) {
+        std::cerr << err_msg << std::endl;
+        exit(-1);
+    }
+    return ret;
+}
+
+static std::shared_ptr<GenerationSession>
+makeSession(const GenOptions &options, uint64_t seed, std::ostream &log) {
+    Options prog_options(options.getOptions());
+    prog_options.setSeed(seed);
+    return std::make_shared<GenerationSession>(prog_options, log);
+}
+
+static void emitToNull(ProgramGenerator &program) {
+    NullBuffer null_buf;
+    std::ostream null_stream(&null_buf);
+    std::vector<std::ostream *> part_streams(
+        program.getFuncPartFileNames().size(), &null_stream);
+    program.emit(null_stream, null_stream, part_streams, null_stream);
+}
+
+static void benchPipeline(const std::string &std_name, size_t seeds_num) {
+    GenOptions options = makeOptions(std_name);
+    std::vector<double> latencies;
+    size_t nodes_num = 0;
+    auto total_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < seeds_num; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        // The destruction of the program is a part of the latency too
+        {
+            std::stringstream log;
+            auto session = makeSession(options, corpus_first_seed + i, log);
+            ProgramGenerator program(session);
+            emitToNull(program);
+            nodes_num += session->getStatistics().getIRNodeNum();
+        }
+        latencies.push_back(getTimeMs(start));
+    }
+    double total_s = getTimeMs(total_start) / 1000;
+
+    std::cout << std::left << std::setw(8) << std_name << std::right
+              << std::setw(8) << seeds_num << std::setw(12)
+              << seeds_num / total_s << std::setw(14) << nodes_num / total_s
+              << std::setw(12) << getPercentile(latencies, 50) << std::setw(12)
+              << getPercentile(latencies, 99) << std::endl;
+}
+
+static void reportMicro(const std::string &name, size_t ops_num,
+                        double time_ms) {
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(12) << ops_num << std::setw(14)
+              << time_ms * 1000000 / ops_num << std::endl;
+}
+
+static void benchIRValue() {
+    const size_t vals_num = 1024;
+    const size_t rounds_num = 2000;
+    std::vector<IRValue> vals;
+    vals.reserve(vals_num);
+    for (size_t i = 0; i < vals_num; ++i)
+        vals.push_back(rand_val_gen->getRandValue(IntTypeID::INT));
+
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds_num; ++round) {
+        for (size_t i = 0; i + 1 < vals_num; ++i) {
+            IRValue &a = vals.at(i);
+            IRValue &b = vals.at(i + 1);
+            IRValue res = (a + b) ^ (a - b);
+            res = res & (a | b);
+            res = res < a;
+            sink += res.getAbsValue().value;
+        }
+    }
+    double time_ms = getTimeMs(start);
+    reportMicro("IRValue ops", rounds_num * (vals_num - 1) * 5, time_ms);
+    result_sink = sink;
+}
+
+static void benchIRValueVector() {
+    const size_t vals_num = 4096;
+    const size_t rounds_num = 2000;
+    IRValueVector vals;
+    vals.reserve(vals_num);
+    for (size_t i = 0; i < vals_num; ++i)
+        vals.push_back(rand_val_gen->getRandValue(IntTypeID::INT));
+
+    // Batch scan over the raw arrays: the sum of the values without UB
+    const std::vector<uint64_t> &payloads = vals.getPayloads();
+    const std::vector<uint8_t> &ub_tags = vals.getUBTags();
+    const auto no_ub_tag = static_cast<uint8_t>(UBKind::NoUB);
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds_num; ++round)
+        for (size_t i = 0; i < vals_num; ++i)
+            sink += ub_tags[i] == no_ub_tag ? payloads[i] : 0;
+    double time_ms = getTimeMs(start);
+    reportMicro("IRValueVector scan", rounds_num * vals_num, time_ms);
+    result_sink = sink;
+}
+
+static void benchGetRandId() {
+    const size_t ops_num = 1000000;
+    auto gen_pol = std::make_shared<GenPolicy>();
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops_num; ++i)
+        sink += static_cast<size_t>(
+            rand_val_gen->getRandId(gen_pol->arith_node_distr));
+    double time_ms = getTimeMs(start);
+    reportMicro("RandValGen::getRandId", ops_num, time_ms);
+    result_sink = sink;
+}
+
+static void benchArithExprCreate() {
+    const size_t ops_num = 20000;
+    auto pop_ctx = std::make_shared<PopulateCtx>();
+    auto gen_pol = pop_ctx->getGenPolicy();
+    auto ext_inp_sym_tbl = pop_ctx->getExtInpSymTable();
+    for (size_t i = 0; i < gen_pol->max_inp_vars_num; ++i) {
+        auto new_var = ScalarVar::create(pop_ctx);
+        ext_inp_sym_tbl->addVar(new_var);
+        ext_inp_sym_tbl->addVarExpr(makeIRNode<ScalarVarUseExpr>(new_var));
+    }
+
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops_num; ++i)
+        sink += ArithmeticExpr::create(pop_ctx)->getComplexity();
+    double time_ms = getTimeMs(start);
+    reportMicro("ArithmeticExpr::create", ops_num, time_ms);
+    result_sink = sink;
+}
+
+static void benchEmit(const GenOptions &options) {
+    const size_t ops_num = 20;
+    std::stringstream log;
+    auto session = makeSession(options, corpus_first_seed, log);
+    ProgramGenerator program(session);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops_num; ++i)
+        emitToNull(program);
+    double time_ms = getTimeMs(start);
+    reportMicro("ProgramGenerator::emit", ops_num, time_ms);
+}
+
+// Peak resident set size of the process in megabytes (negative if it is
+// unknown)
+static double getPeakRSSMb() {
+#if defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // macOS reports it in bytes
+    return static_cast<double>(usage.ru_maxrss) / (1024 * 1024);
+#elif defined(__unix__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // Linux reports it in kilobytes
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+#else
+    return -1;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    size_t seeds_num = default_seeds_per_std;
+    if (argc > 1) {
+        std::stringstream arg_ss(argv[1]);
+        arg_ss >> seeds_num;
+        if (arg_ss.fail() || seeds_num == 0) {
+            std::cerr << "Usage: " << argv[0] << " [seeds_per_std]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Pipeline (generate + emit), seeds " << corpus_first_seed
+              << ".." << corpus_first_seed + seeds_num - 1 << std::endl;
+    std::cout << std::left << std::setw(8) << "std" << std::right
+              << std::setw(8) << "seeds" << std::setw(12) << "seeds/s"
+              << std::setw(14) << "nodes/s" << std::setw(12) << "p50 ms"
+              << std::setw(12) << "p99 ms" << std::endl;
+    for (const char *std_name : {"c", "c++", "ispc", "sycl"})
+        benchPipeline(std_name, seeds_num);
+
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(28) << "Micro-benchmark" << std::right
+              << std::setw(12) << "ops" << std::setw(14) << "ns/op"
+              << std::endl;
+    GenOptions options = makeOptions("c++");
+    {
+        std::stringstream log;
+        auto session = makeSession(options, corpus_first_seed, log);
+        GenerationSession::Scope session_scope(*session);
+        benchIRValue();
+        benchIRValueVector();
+        benchGetRandId();
+        benchArithExprCreate();
+    }
+    benchEmit(options);
+
+    std::cout << std::endl << "Peak RSS: ";
+    double peak_rss = getPeakRSSMb();
+    if (peak_rss < 0)
+        std::cout << "unknown" << std::endl;
+    else
+        std::cout << peak_rss << " MB" << std::endl;
+    return 0;
+}
@@ -17,17 +17,25 @@ limitations under the License.
 
 //////////////////////////////////////////////////////////////////////////////
 #include "context.h"
+#include "session.h"
 
 #include <utility>
 
 using namespace yarpgen;
 
-std::shared_ptr<EmitCtx> EmitCtx::default_emit_ctx =
-    std::make_shared<EmitCtx>();
+// Child context uses the policy of its parent, so there is no need to create
+// a new one. The only exception is parameter shuffling: it consumes random
+// values, so we have to do it anyway to keep the tests reproducible.
+static std::shared_ptr<GenPolicy>
+getInitialGenPolicy(const std::shared_ptr<PopulateCtx> &par_ctx) {
+    Options &options = Options::getInstance();
+    if (par_ctx.use_count() != 0 && !options.getUseParamShuffle())
+        return par_ctx->getGenPolicy();
+    return std::make_shared<GenPolicy>();
+}
 
 PopulateCtx::PopulateCtx(std::shared_ptr<PopulateCtx> _par_ctx)
-    : PopulateCtx() {
-    local_sym_tbl = std::make_shared<SymbolTable>();
+    : PopulateCtx(getInitialGenPolicy(_par_ctx)) {
     if (_par_ctx.use_count() != 0) {
         par_ctx = _par_ctx;
         gen_policy = par_ctx->gen_policy;
@@ -45,10 +53,14 @@ PopulateCtx::PopulateCtx(std::shared_ptr<PopulateCtx> _par_ctx)
         in_stencil = par_ctx->in_stencil;
         mul_vals_iter = par_ctx->mul_vals_iter;
         allow_mul_vals = par_ctx->allow_mul_vals;
+        task_group = par_ctx->task_group;
     }
 }
 
-PopulateCtx::PopulateCtx() {
+PopulateCtx::PopulateCtx() : PopulateCtx(std::make_shared<GenPolicy>()) {}
+
+PopulateCtx::PopulateCtx(std::shared_ptr<GenPolicy> _gen_policy)
+    : GenCtx(std::move(_gen_policy)) {
     par_ctx = nullptr;
     local_sym_tbl = std::make_shared<SymbolTable>();
     ext_inp_sym_tbl = std::make_shared<SymbolTable>();
@@ -60,6 +72,7 @@ PopulateCtx::PopulateCtx() {
     in_stencil = false;
     mul_vals_iter = nullptr;
     allow_mul_vals = false;
+    task_group = nullptr;
 }
 
 size_t PopulateCtx::generateNumberOfDims(ArrayDimsUseKind dims_use_kind) const {
@@ -82,17 +95,69 @@ size_t PopulateCtx::generateNumberOfDims(ArrayDimsUseKind dims_use_kind) const {
 }
 
 void SymbolTable::addArray(std::shared_ptr<Array> array) {
-    arrays.push_back(array);
+    modify(arrays).push_back(array);
     assert(array->getType()->isArrayType() &&
            "Array should have an array type");
     auto array_type = std::static_pointer_cast<ArrayType>(array->getType());
-    array_dim_map[array_type->getDimensions().size()].push_back(array);
+    modify(array_dim_map)[array_type->getDimensions().size()].push_back(
+        std::move(array));
 }
 
-std::vector<std::shared_ptr<Array>>
+const std::vector<std::shared_ptr<Array>> &
 SymbolTable::getArraysWithDimNum(size_t dim) {
-    auto find_res = array_dim_map.find(dim);
-    if (find_res != array_dim_map.end())
+    static const std::vector<std::shared_ptr<Array>> empty;
+    const ArrayDimMap &dim_map = view(array_dim_map);
+    auto find_res = dim_map.find(dim);
+    if (find_res != dim_map.end())
         return find_res->second;
-    return {};
+    return empty;
+}
+
+void PopulateTaskGroup::spawn(const std::shared_ptr<PopulateCtx> &ctx,
+                              PopulateFunc func) {
+    Task task;
+    task.session = GenerationSession::getCurrent().createTaskSession();
+
+    // The task can't share anything mutable with the parent
+    task.ctx = std::make_shared<PopulateCtx>(*ctx);
+    task.ctx->setGenPolicy(std::make_shared<GenPolicy>(*ctx->getGenPolicy()));
+    task.ctx->setLocalSymTable(
+        std::make_shared<SymbolTable>(*ctx->getLocalSymTable()));
+    task.ctx->setExtInpSymTable(
+        std::make_shared<SymbolTable>(*ctx->getExtInpSymTable()));
+    task.ctx->setExtOutSymTable(std::make_shared<SymbolTable>());
+    task.ctx->setTaskGroup(std::make_shared<PopulateTaskGroup>(pool));
+    task.inp_arrays_num = ctx->getExtInpSymTable()->getArrays().size();
+
+    auto session = task.session;
+    auto task_ctx = task.ctx;
+    task.handle = pool->submit([session, task_ctx, func]() {
+        GenerationSession::Scope session_scope(*session);
+        func(task_ctx);
+        task_ctx->getTaskGroup()->join(task_ctx->getExtInpSymTable(),
+                                       task_ctx->getExtOutSymTable());
+    });
+    tasks.push_back(std::move(task));
+}
+
+void PopulateTaskGroup::join(
+    const std::shared_ptr<SymbolTable> &ext_inp_sym_tbl,
+    const std::shared_ptr<SymbolTable> &ext_out_sym_tbl) {
+    GenerationSession &session = GenerationSession::getCurrent();
+    for (auto &task : tasks) {
+        pool->wait(task.handle);
+
+        // Only arrays are added to the input table during the population
+        auto &task_inp_arrays = task.ctx->getExtInpSymTable()->getArrays();
+        for (size_t i = task.inp_arrays_num; i < task_inp_arrays.size(); ++i)
+            ext_inp_sym_tbl->addArray(task_inp_arrays.at(i));
+
+        for (auto &var : task.ctx->getExtOutSymTable()->getVars())
+            ext_out_sym_tbl->addVar(var);
+        for (auto &array : task.ctx->getExtOutSymTable()->getArrays())
+            ext_out_sym_tbl->addArray(array);
+
+        session.mergeTaskSession(*task.session);
+    }
+    tasks.clear();
 }
@@ -23,7 +23,10 @@ limitations under the License.
 #include "emit_policy.h"
 #include "expr.h"
 #include "gen_policy.h"
+#include "task_pool.h"
 
+#include <algorithm>
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -51,11 +54,15 @@ class EvalCtx {
     bool use_main_vals;
 };
 
+class GenerationSession;
+
 class GenCtx {
   public:
-    GenCtx() : loop_depth(0), if_else_depth(0), inside_foreach(false) {
-        gen_policy = std::make_shared<GenPolicy>();
-    }
+    GenCtx() : GenCtx(std::make_shared<GenPolicy>()) {}
+    explicit GenCtx(std::shared_ptr<GenPolicy> _gen_policy)
+        : gen_policy(std::move(_gen_policy)), loop_depth(0), if_else_depth(0),
+          inside_foreach(false) {}
+
     void setGenPolicy(std::shared_ptr<GenPolicy> gen_pol) {
         gen_policy = std::move(gen_pol);
     }
@@ -129,40 +136,77 @@ class ArrayStencilParams {
     std::vector<ArrayStencilDimParams> params;
 };
 
+// Symbol table is copied every time we create a new PopulateCtx, so the copy
+// has to be cheap. All of the containers are shared between the copies, and
+// each copy clones a container only before it modifies it (copy-on-write).
+// The getters return views that stay valid until the table is modified.
 class SymbolTable {
   public:
-    void addVar(std::shared_ptr<ScalarVar> var) { vars.push_back(var); }
+    void addVar(std::shared_ptr<ScalarVar> var) {
+        modify(vars).push_back(std::move(var));
+    }
     void addArray(std::shared_ptr<Array> array);
-    void addIters(std::shared_ptr<Iterator> iter) { iters.push_back(iter); }
-    void deleteLastIters() { iters.pop_back(); }
+    void addIters(std::shared_ptr<Iterator> iter) {
+        modify(iters).push_back(std::move(iter));
+    }
+    void deleteLastIters() { modify(iters).pop_back(); }
 
-    std::vector<std::shared_ptr<ScalarVar>> getVars() { return vars; }
-    std::vector<std::shared_ptr<Array>> getArrays() { return arrays; }
-    std::vector<std::shared_ptr<Array>> getArraysWithDimNum(size_t dim);
-    std::vector<std::shared_ptr<Iterator>> &getIters() { return iters; }
+    const std::vector<std::shared_ptr<ScalarVar>> &getVars() {
+        return view(vars);
+    }
+    const std::vector<std::shared_ptr<Array>> &getArrays() {
+        return view(arrays);
+    }
+    const std::vector<std::shared_ptr<Array>> &getArraysWithDimNum(size_t dim);
+    const std::vector<std::shared_ptr<Iterator>> &getIters() {
+        return view(iters);
+    }
 
     void addVarExpr(std::shared_ptr<ScalarVarUseExpr> var) {
-        avail_vars.push_back(var);
+        modify(avail_vars).push_back(std::move(var));
     }
 
-    std::vector<std::shared_ptr<ScalarVarUseExpr>> getAvailVars() {
-        return avail_vars;
+    const std::vector<std::shared_ptr<ScalarVarUseExpr>> &getAvailVars() {
+        return view(avail_vars);
     }
 
     void setStencilsParams(std::vector<ArrayStencilParams> _stencils) {
-        stencils = _stencils;
+        stencils = std::make_shared<std::vector<ArrayStencilParams>>(
+            std::move(_stencils));
+    }
+    const std::vector<ArrayStencilParams> &getStencilsParams() {
+        return view(stencils);
     }
-    std::vector<ArrayStencilParams> &getStencilsParams() { return stencils; }
 
   private:
-    std::vector<std::shared_ptr<ScalarVar>> vars;
-    std::vector<std::shared_ptr<Array>> arrays;
-    std::map<size_t, std::vector<std::shared_ptr<Array>>> array_dim_map;
-    std::vector<std::shared_ptr<Iterator>> iters;
-    std::vector<std::shared_ptr<ScalarVarUseExpr>> avail_vars;
-    std::vector<ArrayStencilParams> stencils;
+    // Null pointer represents an empty container, so a new table doesn't
+    // allocate anything
+    template <typename T> static const T &view(const std::shared_ptr<T> &ptr) {
+        static const T empty;
+        return ptr ? *ptr : empty;
+    }
+    template <typename T> static T &modify(std::shared_ptr<T> &ptr) {
+        if (!ptr)
+            ptr = std::make_shared<T>();
+        else if (ptr.use_count() > 1)
+            ptr = std::make_shared<T>(*ptr);
+        return *ptr;
+    }
+
+    using ArrayDimMap = std::map<size_t, std::vector<std::shared_ptr<Array>>>;
+
+    std::shared_ptr<std::vector<std::shared_ptr<ScalarVar>>> vars;
+    std::shared_ptr<std::vector<std::shared_ptr<Array>>> arrays;
+    std::shared_ptr<ArrayDimMap> array_dim_map;
+    std::shared_ptr<std::vector<std::shared_ptr<Iterator>>> iters;
+    std::shared_ptr<std::vector<std::shared_ptr<ScalarVarUseExpr>>> avail_vars;
+    std::shared_ptr<std::vector<ArrayStencilParams>> stencils;
+
+    AllocCounter<SymbolTable, AllocKind::SYMBOL_TABLE> alloc_counter;
 };
 
+class PopulateTaskGroup;
+
 // TODO: should we inherit it from Generation Context or should it be a separate
 // thing?
 class PopulateCtx : public GenCtx {
@@ -175,6 +219,9 @@ class PopulateCtx : public GenCtx {
     std::shared_ptr<SymbolTable> getExtInpSymTable() { return ext_inp_sym_tbl; }
     std::shared_ptr<SymbolTable> getExtOutSymTable() { return ext_out_sym_tbl; }
     std::shared_ptr<SymbolTable> getLocalSymTable() { return local_sym_tbl; }
+    void setLocalSymTable(std::shared_ptr<SymbolTable> _sym_table) {
+        local_sym_tbl = std::move(_sym_table);
+    }
     void setExtInpSymTable(std::shared_ptr<SymbolTable> _sym_table) {
         ext_inp_sym_tbl = std::move(_sym_table);
     }
@@ -211,7 +258,15 @@ class PopulateCtx : public GenCtx {
     void setAllowMulVals(bool _val) { allow_mul_vals = _val; }
     bool getAllowMulVals() { return allow_mul_vals; }
 
+    // If the group is set, the statements are populated as parallel tasks
+    void setTaskGroup(std::shared_ptr<PopulateTaskGroup> _group) {
+        task_group = std::move(_group);
+    }
+    std::shared_ptr<PopulateTaskGroup> getTaskGroup() { return task_group; }
+
   private:
+    explicit PopulateCtx(std::shared_ptr<GenPolicy> _gen_policy);
+
     std::shared_ptr<PopulateCtx> par_ctx;
     std::shared_ptr<SymbolTable> ext_inp_sym_tbl;
     std::shared_ptr<SymbolTable> ext_out_sym_tbl;
@@ -245,17 +300,48 @@ class PopulateCtx : public GenCtx {
     std::shared_ptr<Iterator> mul_vals_iter;
     // If we want to allow multiple values in this context
     bool allow_mul_vals;
+
+    std::shared_ptr<PopulateTaskGroup> task_group;
+
+    AllocCounter<PopulateCtx, AllocKind::POPULATE_CTX> alloc_counter;
+};
+
+// Sibling statements interact with each other only through the external
+// symbol tables, so they can be populated independently. Each task gets its
+// own generation session (with a separate stream of random numbers), a copy of
+// the generation policy and private copies of the symbol tables. When the
+// group is joined, the data that was created by the tasks is appended to the
+// tables of the parent in the order of spawning, so the result doesn't depend
+// on the scheduling or on the number of threads.
+class PopulateTaskGroup {
+  public:
+    using PopulateFunc = std::function<void(std::shared_ptr<PopulateCtx>)>;
+
+    explicit PopulateTaskGroup(std::shared_ptr<TaskPool> _pool)
+        : pool(std::move(_pool)) {}
+
+    void spawn(const std::shared_ptr<PopulateCtx> &ctx, PopulateFunc func);
+    // Waits for all of the tasks and merges them into the given tables and
+    // into the current session
+    void join(const std::shared_ptr<SymbolTable> &ext_inp_sym_tbl,
+              const std::shared_ptr<SymbolTable> &ext_out_sym_tbl);
+
+  private:
+    struct Task {
+        std::shared_ptr<GenerationSession> session;
+        std::shared_ptr<PopulateCtx> ctx;
+        // Number of input arrays when the task was spawned
+        size_t inp_arrays_num;
+        TaskPool::TaskPtr handle;
+    };
+
+    std::shared_ptr<TaskPool> pool;
+    std::vector<Task> tasks;
 };
 
 // TODO: maybe we need to inherit from some class
 class EmitCtx {
   public:
-    // This is a hack. EmitPolicy is required to get a name of a variable.
-    // Because we use a name of a variable as a unique ID, we end up creating
-    // a lot of objects that are useless.
-    // TODO: replace UID type of vars to something better
-    static std::shared_ptr<EmitCtx> default_emit_ctx;
-
     EmitCtx() : ispc_types(false), sycl_access(false) {
         emit_policy = std::make_shared<EmitPolicy>();
     }
@@ -270,10 +356,20 @@ class EmitCtx {
     void setSYCLPrefix(std::string _val) { sycl_prefix = std::move(_val); }
     std::string getSYCLPrefix() { return sycl_prefix; }
 
+    // Input data that we pass as a parameters to test functions
+    void addParamName(std::string _name) {
+        pass_as_param_buffer.push_back(std::move(_name));
+    }
+    bool isPassedAsParam(const std::string &_name) {
+        auto &buf = pass_as_param_buffer;
+        return std::find(buf.begin(), buf.end(), _name) != buf.end();
+    }
+
   private:
     std::shared_ptr<EmitPolicy> emit_policy;
     bool ispc_types;
     bool sycl_access;
     std::string sycl_prefix;
+    std::vector<std::string> pass_as_param_buffer;
 };
 } // namespace yarpgen
@@ -20,7 +20,10 @@ limitations under the License.
 #include "data.h"
 #include "context.h"
 #include "expr.h"
+#include "statistics.h"
 
+#include <functional>
+#include <numeric>
 #include <utility>
 
 using namespace yarpgen;
@@ -40,7 +43,7 @@ std::shared_ptr<ScalarVar> ScalarVar::create(std::shared_ptr<PopulateCtx> ctx) {
     IRValue init_val = rand_val_gen->getRandValue(type_id);
     auto int_type = IntegralType::init(type_id);
     NameHandler &nh = NameHandler::getInstance();
-    return std::make_shared<ScalarVar>(nh.getVarName(), int_type, init_val);
+    return makeIRNode<ScalarVar>(nh.getVarName(), int_type, init_val);
 }
 
 std::string ScalarVar::getName(std::shared_ptr<EmitCtx> ctx) {
@@ -126,8 +129,7 @@ std::shared_ptr<Array> Array::create(std::shared_ptr<PopulateCtx> ctx,
     auto int_type = std::static_pointer_cast<IntegralType>(base_type);
     IRValue init_val = rand_val_gen->getRandValue(int_type->getIntTypeId());
     NameHandler &nh = NameHandler::getInstance();
-    auto new_array =
-        std::make_shared<Array>(nh.getArrayName(), array_type, init_val);
+    auto new_array = makeIRNode<Array>(nh.getArrayName(), array_type, init_val);
 
     auto mul_vals =
         ctx->getMulValsIter() != nullptr &&
@@ -145,6 +147,15 @@ std::shared_ptr<Array> Array::create(std::shared_ptr<PopulateCtx> ctx,
         new_array->setInitValue(init_val, false, mul_val_idx);
         new_array->setCurrentValue(init_val, false);
     }
+
+    // Each element is initialized, and the output arrays are also added to
+    // the checksum
+    auto &dims = array_type->getDimensions();
+    uint64_t elems_num = std::accumulate(dims.begin(), dims.end(), uint64_t(1),
+                                         std::multiplies<uint64_t>());
+    Statistics &stats = Statistics::getInstance();
+    stats.addDynOps(inp ? elems_num : 2 * elems_num);
+    stats.addArray();
     return new_array;
 }
 
@@ -196,8 +207,7 @@ std::shared_ptr<Iterator> Iterator::create(std::shared_ptr<PopulateCtx> ctx,
     if (options.isISPC() && !is_uniform)
         left_span = 0;
 
-    auto start =
-        std::make_shared<ConstantExpr>(IRValue{type_id, {false, left_span}});
+    auto start = makeIRNode<ConstantExpr>(IRValue{type_id, {false, left_span}});
 
     size_t end_val = _end_val;
     // We can't go pass the maximal value of the type
@@ -218,8 +228,7 @@ std::shared_ptr<Iterator> Iterator::create(std::shared_ptr<PopulateCtx> ctx,
         end_val = _end_val - right_span;
     }
 
-    auto end =
-        std::make_shared<ConstantExpr>(IRValue(type_id, {false, end_val}));
+    auto end = makeIRNode<ConstantExpr>(IRValue(type_id, {false, end_val}));
 
     size_t step_val = rand_val_gen->getRandId(gen_pol->iters_step_distr);
     if (!is_uniform)
@@ -229,15 +238,14 @@ std::shared_ptr<Iterator> Iterator::create(std::shared_ptr<PopulateCtx> ctx,
     if ((end_val / step_val + 1) * step_val >=
         int_type->getMax().getAbsValue().value)
         step_val = 1;
-    auto step =
-        std::make_shared<ConstantExpr>(IRValue{type_id, {false, step_val}});
+    auto step = makeIRNode<ConstantExpr>(IRValue{type_id, {false, step_val}});
 
     size_t total_iters_num = (end_val - left_span + step_val - 1) / step_val;
 
     NameHandler &nh = NameHandler::getInstance();
-    auto iter = std::make_shared<Iterator>(
-        nh.getIterName(), type, start, left_span, end, right_span, step,
-        end_val == left_span, total_iters_num);
+    auto iter = makeIRNode<Iterator>(nh.getIterName(), type, start, left_span,
+                                     end, right_span, step,
+                                     end_val == left_span, total_iters_num);
 
     bool supports_mul_vals = step_val % 2 != Options::main_val_idx ||
                              left_span % 2 != Options::main_val_idx;
@@ -281,7 +289,7 @@ static std::shared_ptr<Expr> adjustIterExprValue(std::shared_ptr<Expr> expr,
     Options &options = Options::getInstance();
     if (options.isISPC())
         if (!eval_res->getType()->isUniform()) {
-            auto tmp = std::make_shared<ExtractCall>(expr);
+            auto tmp = makeIRNode<ExtractCall>(expr);
             tmp->setIsImplicit(true);
             expr = tmp;
         }
@@ -289,7 +297,7 @@ static std::shared_ptr<Expr> adjustIterExprValue(std::shared_ptr<Expr> expr,
     // Every binary operation applies integral promotion first, so we need to
     // guarantee that expression can be processed
     if (int_type->getIntTypeId() < IntTypeID::INT) {
-        expr = std::make_shared<TypeCastExpr>(
+        expr = makeIRNode<TypeCastExpr>(
             expr, IntegralType::init(IntTypeID::INT), true);
         value = value.castToType(IntTypeID::INT);
     }
@@ -317,11 +325,11 @@ static std::shared_ptr<Expr> adjustIterExprValue(std::shared_ptr<Expr> expr,
             break;
 
         if ((value > expr_val).getValueRef<bool>())
-            ret = std::make_shared<BinaryExpr>(
-                BinaryOp::ADD, ret, std::make_shared<ConstantExpr>(diff));
+            ret = makeIRNode<BinaryExpr>(BinaryOp::ADD, ret,
+                                         makeIRNode<ConstantExpr>(diff));
         else
-            ret = std::make_shared<BinaryExpr>(
-                BinaryOp::SUB, ret, std::make_shared<ConstantExpr>(diff));
+            ret = makeIRNode<BinaryExpr>(BinaryOp::SUB, ret,
+                                         makeIRNode<ConstantExpr>(diff));
     } while (true);
 
     return ret;
@@ -384,14 +392,14 @@ void Iterator::populate(std::shared_ptr<PopulateCtx> ctx) {
 
         if (options.isISPC())
             if (!ret_eval_res->getType()->isUniform()) {
-                ret = std::make_shared<ExtractCall>(ret);
+                ret = makeIRNode<ExtractCall>(ret);
                 ret_eval_res = ret->rebuild(eval_ctx);
                 int_eval_res_type = std::static_pointer_cast<IntegralType>(
                     ret_eval_res->getType());
             }
 
         if (int_type->getIntTypeId() != int_eval_res_type->getIntTypeId()) {
-            ret = std::make_shared<TypeCastExpr>(
+            ret = makeIRNode<TypeCastExpr>(
                 ret, IntegralType::init(int_type->getIntTypeId()), true);
             ret_eval_res = ret->rebuild(eval_ctx);
         }
@@ -19,11 +19,13 @@ limitations under the License.
 
 #pragma once
 
+#include "arena.h"
 #include "enums.h"
 #include "ir_value.h"
 #include "options.h"
 #include "type.h"
 #include <array>
+#include <atomic>
 #include <deque>
 #include <string>
 #include <utility>
@@ -33,12 +35,16 @@ namespace yarpgen {
 class GenCtx;
 class PopulateCtx;
 class EmitCtx;
+class SubscriptExpr;
 
 class Data {
   public:
     Data(std::string _name, std::shared_ptr<Type> _type)
         : name(std::move(_name)), type(std::move(_type)),
           ub_code(UBKind::Uninit), is_dead(true), alignment(0) {}
+    Data(const Data &other)
+        : name(other.name), type(other.type), ub_code(other.ub_code),
+          is_dead(other.is_dead.load()), alignment(other.alignment) {}
     virtual ~Data() = default;
 
     virtual std::string getName(std::shared_ptr<EmitCtx> ctx) { return name; }
@@ -68,7 +74,7 @@ class Data {
 
   protected:
     template <typename T> static std::shared_ptr<Data> makeVaryingImpl(T val) {
-        auto ret = std::make_shared<T>(val);
+        auto ret = makeIRNode<T>(val);
         ret->type = ret->getType()->makeVarying();
         return ret;
     }
@@ -82,7 +88,9 @@ class Data {
 
     // Sometimes we create more variables than we use.
     // They create a lot of dead code in the test, so we need to prune them.
-    bool is_dead;
+    // Input data is shared between parallel population tasks, which mark it
+    // as used concurrently.
+    std::atomic<bool> is_dead;
     size_t alignment;
 };
 
@@ -161,6 +169,12 @@ class Array : public Data {
                       int64_t mul_val_axis_idx);
     void setCurrentValue(IRValue _val, bool use_main_vals);
     int64_t getMulValsAxisIdx() { return mul_vals_axis_idx; }
+    // Output arrays are written by a single assignment, so its subscript
+    // defines which of the elements hold the current values in the end
+    void setWriteSubs(std::shared_ptr<SubscriptExpr> _subs) {
+        write_subs = std::move(_subs);
+    }
+    std::shared_ptr<SubscriptExpr> getWriteSubs() { return write_subs; }
 
     bool isArray() final { return true; }
     DataKind getKind() final { return DataKind::ARR; }
@@ -191,6 +205,7 @@ class Array : public Data {
     // We use int64_t to use negative values as poison values that
     // indicate that the values are uniform
     int64_t mul_vals_axis_idx;
+    std::shared_ptr<SubscriptExpr> write_subs;
 };
 
 class Expr;
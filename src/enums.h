@@ -78,6 +78,16 @@ enum class ArrayKind {
 
 enum class DataKind { VAR, ARR, ITER, MAX_DATA_KIND };
 
+// Objects that are accounted with --track-allocs (besides the IR nodes)
+enum class AllocKind {
+    INT_TYPE,
+    ARRAY_TYPE,
+    POPULATE_CTX,
+    GEN_POLICY,
+    SYMBOL_TABLE,
+    MAX_ALLOC_KIND
+};
+
 enum class IRNodeKind {
     CONST,
     SCALAR_VAR_USE,
@@ -163,6 +173,19 @@ enum class OptionKind {
     MUTATE,
     MUTATION_SEED,
     UB_IN_DC,
+    BATCH,
+    JOBS,
+    SEED_FILE,
+    SERVE,
+    POPULATE_JOBS,
+    STREAM_EMIT,
+    TU_COUNT,
+    BUNDLE,
+    MAX_DYN_OPS,
+    MAX_COMPILE_COST,
+    STATS_JSON,
+    TRACE,
+    TRACK_ALLOCS,
     MAX_OPTION_ID
 };
 
@@ -212,10 +235,24 @@ enum class SpecialConst {
     MAX_SPECIAL_CONST
 };
 
-enum class CheckAlgo { HASH, ASSERTS, PRECOMPUTE, MAX_CHECK_ALGO };
+enum class CheckAlgo { HASH, ASSERTS, PRECOMPUTE, TREE_HASH, MAX_CHECK_ALGO };
 
 enum class MutationKind { NONE, EXPRS, ALL, MAX_MUTATION_FIND };
 
+// Phases of the generation that are timed by Statistics
+enum class GenPhase {
+    STRUCTURE,
+    POPULATE,
+    REBUILD,
+    EMIT_EXT_DECL,
+    EMIT_TEST,
+    EMIT_DECL,
+    EMIT_INIT,
+    EMIT_CHECK,
+    EMIT_MAIN,
+    MAX_GEN_PHASE
+};
+
 // TODO: not all of the cases are supported yet
 enum class ArrayDimsUseKind { FEWER, SAME, MORE };
 enum class ArrayDimsReuseKind { SAME, OFFSET, SCALE, COMBINE };
@@ -20,19 +20,74 @@ limitations under the License.
 #include "expr.h"
 #include "context.h"
 #include "options.h"
+#include "session.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <deque>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <utility>
 
 using namespace yarpgen;
 
-std::unordered_map<std::shared_ptr<Data>, std::shared_ptr<ScalarVarUseExpr>>
-    yarpgen::ScalarVarUseExpr::scalar_var_use_set;
-std::unordered_map<std::shared_ptr<Data>, std::shared_ptr<ArrayUseExpr>>
-    yarpgen::ArrayUseExpr::array_use_set;
-std::unordered_map<std::shared_ptr<Data>, std::shared_ptr<IterUseExpr>>
-    yarpgen::IterUseExpr::iter_use_set;
+// Rebuild passes can't overlap within a thread, so we just count them.
+// Parallel population tasks can evaluate the nodes of their parent, so the
+// epochs are unique across all threads.
+static std::atomic<uint64_t> last_rebuild_epoch(0);
+static thread_local uint64_t rebuild_epoch = 0;
+static thread_local size_t rebuild_depth = 0;
+// Only the outermost pass is timed
+static thread_local std::unique_ptr<Statistics::PhaseTimer> rebuild_timer;
+// The trace shows how many times the outermost pass had to fix the UB
+static thread_local size_t rebuild_start_ub_num = 0;
+
+Expr::RebuildPass::RebuildPass() {
+    if (rebuild_depth++ == 0) {
+        rebuild_epoch = ++last_rebuild_epoch;
+        rebuild_timer =
+            std::make_unique<Statistics::PhaseTimer>(GenPhase::REBUILD);
+        if (rebuild_timer->getSpan().isEnabled())
+            rebuild_start_ub_num = Statistics::getInstance().getUBNum();
+    }
+}
+
+Expr::RebuildPass::~RebuildPass() {
+    if (--rebuild_depth != 0)
+        return;
+    if (rebuild_timer->getSpan().isEnabled())
+        rebuild_timer->getSpan().addArg("retries",
+                                        Statistics::getInstance().getUBNum() -
+                                            rebuild_start_ub_num);
+    rebuild_timer.reset();
+}
+
+bool Expr::isPropagated() {
+    return rebuild_depth > 0 && propagated_epoch == rebuild_epoch;
+}
+
+void Expr::markPropagated() {
+    if (rebuild_depth > 0)
+        propagated_epoch = rebuild_epoch;
+}
+
+bool Expr::isRebuilt(EvalCtx &ctx) {
+    return rebuild_depth > 0 && rebuilt_epoch == rebuild_epoch &&
+           rebuilt_use_main_vals == ctx.use_main_vals;
+}
+
+void Expr::markRebuilt(EvalCtx &ctx) {
+    rebuilt_epoch = rebuild_epoch;
+    rebuilt_use_main_vals = ctx.use_main_vals;
+    rebuilt_value = value;
+}
+
+void Expr::markDirty() {
+    propagated_epoch = 0;
+    rebuilt_epoch = 0;
+    rebuilt_value = nullptr;
+}
 
 static std::shared_ptr<Data>
 replaceValueWith(std::shared_ptr<Data> &_value,
@@ -48,13 +103,11 @@ std::shared_ptr<Data> Expr::getValue() {
     return value;
 }
 
-std::vector<std::shared_ptr<ConstantExpr>> yarpgen::ConstantExpr::used_consts;
-
 ConstantExpr::ConstantExpr(IRValue _value) {
     // TODO: maybe we need a constant data type rather than an anonymous scalar
     // variable
-    value = std::make_shared<ScalarVar>(
-        "", IntegralType::init(_value.getIntTypeID()), _value);
+    value = makeIRNode<ScalarVar>("", IntegralType::init(_value.getIntTypeID()),
+                                  _value);
 }
 
 Expr::EvalResType ConstantExpr::evaluate(EvalCtx &ctx) { return value; }
@@ -102,6 +155,7 @@ void ConstantExpr::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 std::shared_ptr<ConstantExpr>
 ConstantExpr::create(std::shared_ptr<PopulateCtx> ctx) {
     auto gen_pol = ctx->getGenPolicy();
+    auto &used_consts = GenerationSession::getCurrent().getUsedConsts();
     bool reuse_const = rand_val_gen->getRandId(gen_pol->reuse_const_prob);
     std::shared_ptr<ConstantExpr> ret;
     bool can_add_to_buf = true;
@@ -147,7 +201,7 @@ ConstantExpr::create(std::shared_ptr<PopulateCtx> ctx) {
             if (type_id < IntTypeID::INT)
                 ir_val = ir_val.castToType(type_id);
 
-            ret = std::make_shared<ConstantExpr>(ir_val);
+            ret = makeIRNode<ConstantExpr>(ir_val);
         }
     }
     else {
@@ -205,7 +259,7 @@ ConstantExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         else
             init_val = rand_val_gen->getRandValue(type_id);
 
-        ret = std::make_shared<ConstantExpr>(init_val);
+        ret = makeIRNode<ConstantExpr>(init_val);
     }
 
     bool use_offset = rand_val_gen->getRandId(gen_pol->use_const_offset_distr);
@@ -240,7 +294,7 @@ ConstantExpr::create(std::shared_ptr<PopulateCtx> ctx) {
             ir_val = ir_val.castToType(type_id);
 
         if (!ir_val.hasUB()) {
-            ret = std::make_shared<ConstantExpr>(ir_val);
+            ret = makeIRNode<ConstantExpr>(ir_val);
             can_add_to_buf = true;
         }
     }
@@ -263,7 +317,7 @@ ConstantExpr::create(std::shared_ptr<PopulateCtx> ctx) {
 }
 
 std::shared_ptr<Expr> ConstantExpr::copy() {
-    return std::make_shared<ConstantExpr>(
+    return makeIRNode<ConstantExpr>(
         std::static_pointer_cast<ScalarVar>(value)->getCurrentValue());
 }
 
@@ -271,11 +325,13 @@ std::shared_ptr<ScalarVarUseExpr>
 ScalarVarUseExpr::init(std::shared_ptr<Data> _val) {
     assert(_val->isScalarVar() &&
            "ScalarVarUseExpr accepts only scalar variables!");
+    auto &scalar_var_use_set =
+        GenerationSession::getCurrent().getScalarVarUseSet();
     auto find_res = scalar_var_use_set.find(_val);
     if (find_res != scalar_var_use_set.end())
         return find_res->second;
 
-    auto ret = std::make_shared<ScalarVarUseExpr>(_val);
+    auto ret = makeIRNode<ScalarVarUseExpr>(_val);
     scalar_var_use_set[_val] = ret;
     return ret;
 }
@@ -292,7 +348,8 @@ void ScalarVarUseExpr::setValue(std::shared_ptr<Expr> _expr) {
 
 Expr::EvalResType ScalarVarUseExpr::evaluate(EvalCtx &ctx) {
     // This variable is defined, and we can just return it.
-    auto find_res = ctx.input.find(value->getName(EmitCtx::default_emit_ctx));
+    auto find_res = ctx.input.find(
+        value->getName(GenerationSession::getCurrent().getDefaultEmitCtx()));
     if (find_res != ctx.input.end())
         value = find_res->second;
     return value;
@@ -304,22 +361,23 @@ Expr::EvalResType ScalarVarUseExpr::rebuild(EvalCtx &ctx) {
 
 std::shared_ptr<ScalarVarUseExpr>
 ScalarVarUseExpr::create(std::shared_ptr<PopulateCtx> ctx) {
-    auto avail_vars = ctx->getExtInpSymTable()->getAvailVars();
+    auto &avail_vars = ctx->getExtInpSymTable()->getAvailVars();
     return rand_val_gen->getRandElem(avail_vars);
 }
 
 std::shared_ptr<Expr> ScalarVarUseExpr::copy() {
-    return std::make_shared<ScalarVarUseExpr>(value);
+    return makeIRNode<ScalarVarUseExpr>(value);
 }
 
 std::shared_ptr<ArrayUseExpr> ArrayUseExpr::init(std::shared_ptr<Data> _val) {
     assert(_val->isArray() &&
            "ArrayUseExpr can be initialized only with Arrays");
+    auto &array_use_set = GenerationSession::getCurrent().getArrayUseSet();
     auto find_res = array_use_set.find(_val);
     if (find_res != array_use_set.end())
         return find_res->second;
 
-    auto ret = std::make_shared<ArrayUseExpr>(_val);
+    auto ret = makeIRNode<ArrayUseExpr>(_val);
     array_use_set[_val] = ret;
     return ret;
 }
@@ -343,7 +401,8 @@ void ArrayUseExpr::setValue(std::shared_ptr<Expr> _expr, bool main_val) {
 
 Expr::EvalResType ArrayUseExpr::evaluate(EvalCtx &ctx) {
     // This array is defined, and we can just return it.
-    auto find_res = ctx.input.find(value->getName(EmitCtx::default_emit_ctx));
+    auto find_res = ctx.input.find(
+        value->getName(GenerationSession::getCurrent().getDefaultEmitCtx()));
     if (find_res != ctx.input.end())
         value = find_res->second;
 
@@ -353,16 +412,17 @@ Expr::EvalResType ArrayUseExpr::evaluate(EvalCtx &ctx) {
 Expr::EvalResType ArrayUseExpr::rebuild(EvalCtx &ctx) { return evaluate(ctx); }
 
 std::shared_ptr<Expr> ArrayUseExpr::copy() {
-    return std::make_shared<ArrayUseExpr>(value);
+    return makeIRNode<ArrayUseExpr>(value);
 }
 
 std::shared_ptr<IterUseExpr> IterUseExpr::init(std::shared_ptr<Data> _iter) {
     assert(_iter->isIterator() && "IterUseExpr accepts only iterators!");
+    auto &iter_use_set = GenerationSession::getCurrent().getIterUseSet();
     auto find_res = iter_use_set.find(_iter);
     if (find_res != iter_use_set.end())
         return find_res->second;
 
-    auto ret = std::make_shared<IterUseExpr>(_iter);
+    auto ret = makeIRNode<IterUseExpr>(_iter);
     iter_use_set[_iter] = ret;
     return ret;
 }
@@ -380,7 +440,8 @@ void IterUseExpr::setValue(std::shared_ptr<Expr> _expr) {
 
 Expr::EvalResType IterUseExpr::evaluate(EvalCtx &ctx) {
     // This iterator is defined, and we can just return it.
-    auto find_res = ctx.input.find(value->getName(EmitCtx::default_emit_ctx));
+    auto find_res = ctx.input.find(
+        value->getName(GenerationSession::getCurrent().getDefaultEmitCtx()));
     if (find_res != ctx.input.end())
         value = find_res->second;
     return value;
@@ -389,7 +450,7 @@ Expr::EvalResType IterUseExpr::evaluate(EvalCtx &ctx) {
 Expr::EvalResType IterUseExpr::rebuild(EvalCtx &ctx) { return evaluate(ctx); }
 
 std::shared_ptr<Expr> IterUseExpr::copy() {
-    return std::make_shared<IterUseExpr>(value);
+    return makeIRNode<IterUseExpr>(value);
 }
 
 TypeCastExpr::TypeCastExpr(std::shared_ptr<Expr> _expr,
@@ -400,11 +461,14 @@ TypeCastExpr::TypeCastExpr(std::shared_ptr<Expr> _expr,
     auto to_int_type = std::static_pointer_cast<IntegralType>(to_type);
     if (!to_type->isUniform())
         to_int_type->makeVarying();
-    value = std::make_shared<TypedData>(to_int_type);
+    value = makeIRNode<TypedData>(to_int_type);
 }
 
 bool TypeCastExpr::propagateType() {
+    if (isPropagated())
+        return true;
     expr->propagateType();
+    markPropagated();
     return true;
 }
 
@@ -432,12 +496,14 @@ TypeCastExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         is_uniform = expr_val->getType()->isUniform();
     }
 
-    return std::make_shared<TypeCastExpr>(
+    return makeIRNode<TypeCastExpr>(
         expr, IntegralType::init(to_type, false, CVQualifier::NONE, is_uniform),
         /*is_implicit*/ false);
 }
 
 Expr::EvalResType TypeCastExpr::evaluate(EvalCtx &ctx) {
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
     EvalResType expr_eval_res = expr->evaluate(ctx);
     std::shared_ptr<Type> base_type = expr_eval_res->getType();
     // Check that we try to convert between compatible types.
@@ -449,7 +515,7 @@ Expr::EvalResType TypeCastExpr::evaluate(EvalCtx &ctx) {
     if (base_type->isIntType() && expr_eval_res->isScalarVar()) {
         std::shared_ptr<IntegralType> to_int_type =
             std::static_pointer_cast<IntegralType>(to_type);
-        auto scalar_val = std::make_shared<ScalarVar>(
+        auto scalar_val = makeIRNode<ScalarVar>(
             "", to_int_type, IRValue(to_int_type->getIntTypeId()));
         std::shared_ptr<ScalarVar> base_scalar_var =
             std::static_pointer_cast<ScalarVar>(expr_eval_res);
@@ -472,6 +538,10 @@ Expr::EvalResType TypeCastExpr::evaluate(EvalCtx &ctx) {
 }
 
 Expr::EvalResType TypeCastExpr::rebuild(EvalCtx &ctx) {
+    RebuildPass pass;
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
+
     propagateType();
     expr->rebuild(ctx);
     std::shared_ptr<Data> eval_res = evaluate(ctx);
@@ -481,6 +551,7 @@ Expr::EvalResType TypeCastExpr::rebuild(EvalCtx &ctx) {
     auto eval_scalar_res = std::static_pointer_cast<ScalarVar>(eval_res);
     if (!eval_scalar_res->getCurrentValue().hasUB()) {
         value = eval_res;
+        markRebuilt(ctx);
         return eval_res;
     }
 
@@ -493,12 +564,13 @@ Expr::EvalResType TypeCastExpr::rebuild(EvalCtx &ctx) {
     } while (eval_scalar_res->getCurrentValue().hasUB());
 
     value = eval_res;
+    markRebuilt(ctx);
     return value;
 }
 
 std::shared_ptr<Expr> TypeCastExpr::copy() {
     auto new_expr = expr->copy();
-    return std::make_shared<TypeCastExpr>(new_expr, to_type, is_implicit);
+    return makeIRNode<TypeCastExpr>(new_expr, to_type, is_implicit);
 }
 
 std::shared_ptr<Expr> ArithmeticExpr::integralProm(std::shared_ptr<Expr> arg) {
@@ -515,7 +587,7 @@ std::shared_ptr<Expr> ArithmeticExpr::integralProm(std::shared_ptr<Expr> arg) {
         IntTypeID::INT) // can't perform integral promotion
         return arg;
     // TODO: we need to check if type fits in int or unsigned int
-    return std::make_shared<TypeCastExpr>(
+    return makeIRNode<TypeCastExpr>(
         arg,
         IntegralType::init(IntTypeID::INT, false, CVQualifier::NONE,
                            arg->getValue()->getType()->isUniform()),
@@ -531,7 +603,7 @@ std::shared_ptr<Expr> ArithmeticExpr::convToBool(std::shared_ptr<Expr> arg) {
         std::static_pointer_cast<IntegralType>(arg->getValue()->getType());
     if (int_type->getIntTypeId() == IntTypeID::BOOL)
         return arg;
-    return std::make_shared<TypeCastExpr>(
+    return makeIRNode<TypeCastExpr>(
         arg,
         IntegralType::init(IntTypeID::BOOL, false, CVQualifier::NONE,
                            arg->getValue()->getType()->isUniform()),
@@ -562,11 +634,11 @@ void ArithmeticExpr::arithConv(std::shared_ptr<Expr> &lhs,
             lhs_type->getIntTypeId() > rhs_type->getIntTypeId() ? lhs_type
                                                                 : rhs_type;
         if (lhs_type->getIntTypeId() > rhs_type->getIntTypeId())
-            rhs = std::make_shared<TypeCastExpr>(rhs, max_type,
-                                                 /*is_implicit*/ true);
+            rhs = makeIRNode<TypeCastExpr>(rhs, max_type,
+                                           /*is_implicit*/ true);
         else
-            lhs = std::make_shared<TypeCastExpr>(lhs, max_type,
-                                                 /*is_implicit*/ true);
+            lhs = makeIRNode<TypeCastExpr>(lhs, max_type,
+                                           /*is_implicit*/ true);
         return;
     }
 
@@ -577,8 +649,8 @@ void ArithmeticExpr::arithConv(std::shared_ptr<Expr> &lhs,
                                       std::shared_ptr<Expr> &b_expr) -> bool {
         if (!a_type->getIsSigned() &&
             (a_type->getIntTypeId() >= b_type->getIntTypeId())) {
-            b_expr = std::make_shared<TypeCastExpr>(b_expr, a_type,
-                                                    /*is_implicit*/ true);
+            b_expr = makeIRNode<TypeCastExpr>(b_expr, a_type,
+                                              /*is_implicit*/ true);
             return true;
         }
         return false;
@@ -595,8 +667,8 @@ void ArithmeticExpr::arithConv(std::shared_ptr<Expr> &lhs,
         if (a_type->getIsSigned() &&
             IntegralType::canRepresentType(b_type->getIntTypeId(),
                                            a_type->getIntTypeId())) {
-            b_expr = std::make_shared<TypeCastExpr>(b_expr, a_type,
-                                                    /*is_implicit*/ true);
+            b_expr = makeIRNode<TypeCastExpr>(b_expr, a_type,
+                                              /*is_implicit*/ true);
             return true;
         }
         return false;
@@ -615,10 +687,10 @@ void ArithmeticExpr::arithConv(std::shared_ptr<Expr> &lhs,
             if (!a_type->isUniform())
                 new_type = std::static_pointer_cast<IntegralType>(
                     new_type->makeVarying());
-            a_expr = std::make_shared<TypeCastExpr>(a_expr, new_type,
-                                                    /*is_implicit*/ true);
-            b_expr = std::make_shared<TypeCastExpr>(b_expr, new_type,
-                                                    /*is_implicit*/ true);
+            a_expr = makeIRNode<TypeCastExpr>(a_expr, new_type,
+                                              /*is_implicit*/ true);
+            b_expr = makeIRNode<TypeCastExpr>(b_expr, new_type,
+                                              /*is_implicit*/ true);
             return true;
         }
         return false;
@@ -640,8 +712,8 @@ void ArithmeticExpr::varyingPromotion(std::shared_ptr<Expr> &lhs,
                                  std::shared_ptr<Expr> &b_expr) -> bool {
         if (!a_type->isUniform() && b_type->isUniform()) {
             auto new_type = b_type->makeVarying();
-            b_expr = std::make_shared<TypeCastExpr>(b_expr, new_type,
-                                                    /*is_implicit*/ true);
+            b_expr = makeIRNode<TypeCastExpr>(b_expr, new_type,
+                                              /*is_implicit*/ true);
             return true;
         }
         return false;
@@ -714,12 +786,16 @@ createSpecialKindSubsDims(
 
 static std::shared_ptr<Expr> createStencil(std::shared_ptr<PopulateCtx> ctx) {
     auto gen_pol = ctx->getGenPolicy();
+    Statistics &stats = Statistics::getInstance();
+    stats.addStencil();
     std::shared_ptr<Expr> new_node;
     // Change distribution of leaf exprs
     // TODO: maybe we need to bump up the probability of binary operators to get
     // a proper stencil pattern
+    // Const access doesn't detach the distribution from the parent policy
+    const auto &arith_node_distr = gen_pol->arith_node_distr;
     uint64_t scalar_var_prob = 0, const_prob = 0;
-    for (auto &node_distr : gen_pol->arith_node_distr) {
+    for (auto &node_distr : arith_node_distr) {
         switch (node_distr.getId()) {
             case IRNodeKind::SCALAR_VAR_USE:
                 scalar_var_prob = node_distr.getProb();
@@ -737,7 +813,7 @@ static std::shared_ptr<Expr> createStencil(std::shared_ptr<PopulateCtx> ctx) {
     const_prob = const_prob * gen_pol->stencil_prob_weight_alternation;
 
     std::vector<Probability<IRNodeKind>> new_node_distr;
-    for (auto &item : gen_pol->arith_node_distr) {
+    for (auto &item : arith_node_distr) {
         Probability<IRNodeKind> prob = item;
         if (item.getId() == IRNodeKind::SCALAR_VAR_USE)
             prob.setProb(scalar_var_prob);
@@ -1131,18 +1207,37 @@ static std::shared_ptr<Expr> createStencil(std::shared_ptr<PopulateCtx> ctx) {
 #endif
 }
 
+// The deepest level that was reached by the expression tree that is being
+// created on this thread. It is reported in the trace.
+static thread_local size_t arith_trace_depth = 0;
+
 std::shared_ptr<Expr> ArithmeticExpr::create(std::shared_ptr<PopulateCtx> ctx) {
+    // Only the whole expression trees are traced. Some of the leaves (e.g.,
+    // indices of the stencils) are separate trees, so they are nested.
+    std::optional<TraceSpan> span;
+    size_t outer_trace_depth = 0;
+    if (ctx->getArithDepth() == 0) {
+        span.emplace("ArithmeticExpr::create", "populate");
+        outer_trace_depth = arith_trace_depth;
+        arith_trace_depth = 0;
+    }
+
     auto gen_pol = ctx->getGenPolicy();
     std::shared_ptr<Expr> new_node;
     ctx->incArithDepth();
     auto active_ctx = std::make_shared<PopulateCtx>(ctx);
+    Statistics &stats = Statistics::getInstance();
+    stats.updateExprDepth(active_ctx->getArithDepth());
+    arith_trace_depth =
+        std::max(arith_trace_depth, active_ctx->getArithDepth());
     // If we are getting close to the maximum depth, we need to make sure that
     // we generate leaves
     if (active_ctx->getArithDepth() == gen_pol->max_arith_depth) {
         // We can have only constants, variables and arrays as leaves
         std::vector<Probability<IRNodeKind>> new_node_distr;
         bool zero_prob = true;
-        for (auto &item : gen_pol->arith_node_distr) {
+        const auto &arith_node_distr = gen_pol->arith_node_distr;
+        for (auto &item : arith_node_distr) {
             if (item.getId() == IRNodeKind::CONST ||
                 item.getId() == IRNodeKind::SCALAR_VAR_USE ||
                 item.getId() == IRNodeKind::SUBSCRIPT) {
@@ -1258,10 +1353,20 @@ std::shared_ptr<Expr> ArithmeticExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         }
     }
 
+    if (span) {
+        if (span->isEnabled()) {
+            span->addArg("depth", arith_trace_depth);
+            span->addArg("nodes", new_node->getComplexity());
+        }
+        arith_trace_depth = std::max(outer_trace_depth, arith_trace_depth);
+    }
+
     return new_node;
 }
 
 bool UnaryExpr::propagateType() {
+    if (isPropagated())
+        return true;
     arg->propagateType();
     switch (op) {
         case UnaryOp::PLUS:
@@ -1276,11 +1381,14 @@ bool UnaryExpr::propagateType() {
             ERROR("Bad unary operator");
             break;
     }
-    value = std::make_shared<TypedData>(arg->getValue()->getType());
+    value = makeIRNode<TypedData>(arg->getValue()->getType());
+    markPropagated();
     return true;
 }
 
 Expr::EvalResType UnaryExpr::evaluate(EvalCtx &ctx) {
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
     propagateType();
     EvalResType eval_res = arg->evaluate(ctx);
     assert(eval_res->getKind() == DataKind::VAR &&
@@ -1309,7 +1417,7 @@ Expr::EvalResType UnaryExpr::evaluate(EvalCtx &ctx) {
            "Types only");
     value = replaceValueWith(
         value,
-        std::make_shared<ScalarVar>(
+        makeIRNode<ScalarVar>(
             "",
             IntegralType::init(new_val.getIntTypeID(), false, CVQualifier::NONE,
                                arg->getValue()->getType()->isUniform()),
@@ -1318,6 +1426,10 @@ Expr::EvalResType UnaryExpr::evaluate(EvalCtx &ctx) {
 }
 
 Expr::EvalResType UnaryExpr::rebuild(EvalCtx &ctx) {
+    RebuildPass pass;
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
+
     propagateType();
     arg->rebuild(ctx);
     EvalResType eval_res = evaluate(ctx);
@@ -1327,15 +1439,20 @@ Expr::EvalResType UnaryExpr::rebuild(EvalCtx &ctx) {
     auto eval_scalar_res = std::static_pointer_cast<ScalarVar>(eval_res);
     if (!eval_scalar_res->getCurrentValue().hasUB()) {
         value = eval_res;
+        markRebuilt(ctx);
         return value;
     }
 
+    Statistics &stats = Statistics::getInstance();
+    stats.addUB(eval_scalar_res->getCurrentValue().getUBCode());
+
     if (op == UnaryOp::NEGATE) {
         op = UnaryOp::PLUS;
     }
     else {
         ERROR("Something went wrong, this should be unreachable");
     }
+    markDirty();
 
     do {
         eval_res = evaluate(ctx);
@@ -1346,6 +1463,7 @@ Expr::EvalResType UnaryExpr::rebuild(EvalCtx &ctx) {
     } while (eval_scalar_res->getCurrentValue().hasUB());
 
     value = eval_res;
+    markRebuilt(ctx);
     return value;
 }
 
@@ -1377,7 +1495,7 @@ std::shared_ptr<UnaryExpr> UnaryExpr::create(std::shared_ptr<PopulateCtx> ctx) {
     auto gen_pol = ctx->getGenPolicy();
     UnaryOp op = rand_val_gen->getRandId(gen_pol->unary_op_distr);
     auto expr = ArithmeticExpr::create(ctx);
-    return std::make_shared<UnaryExpr>(op, expr);
+    return makeIRNode<UnaryExpr>(op, expr);
 }
 
 UnaryExpr::UnaryExpr(UnaryOp _op, std::shared_ptr<Expr> _expr)
@@ -1385,10 +1503,12 @@ UnaryExpr::UnaryExpr(UnaryOp _op, std::shared_ptr<Expr> _expr)
 
 std::shared_ptr<Expr> UnaryExpr::copy() {
     auto new_arg = arg->copy();
-    return std::make_shared<UnaryExpr>(op, new_arg);
+    return makeIRNode<UnaryExpr>(op, new_arg);
 }
 
 bool BinaryExpr::propagateType() {
+    if (isPropagated())
+        return true;
     lhs->propagateType();
     rhs->propagateType();
 
@@ -1438,13 +1558,15 @@ bool BinaryExpr::propagateType() {
     if (options.isISPC() && !lhs->getValue()->getType()->isUniform())
         bool_type =
             std::static_pointer_cast<IntegralType>(bool_type->makeVarying());
-    value = std::make_shared<TypedData>(
-        result_is_bool ? bool_type : lhs->getValue()->getType());
-
+    value = makeIRNode<TypedData>(result_is_bool ? bool_type
+                                                 : lhs->getValue()->getType());
+    markPropagated();
     return true;
 }
 
 Expr::EvalResType BinaryExpr::evaluate(EvalCtx &ctx) {
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
     propagateType();
     EvalResType lhs_eval_res = lhs->evaluate(ctx);
     EvalResType rhs_eval_res = rhs->evaluate(ctx);
@@ -1524,7 +1646,7 @@ Expr::EvalResType BinaryExpr::evaluate(EvalCtx &ctx) {
 
     value = replaceValueWith(
         value,
-        std::make_shared<ScalarVar>(
+        makeIRNode<ScalarVar>(
             "",
             IntegralType::init(new_val.getIntTypeID(), false, CVQualifier::NONE,
                                lhs->getValue()->getType()->isUniform()),
@@ -1533,6 +1655,10 @@ Expr::EvalResType BinaryExpr::evaluate(EvalCtx &ctx) {
 }
 
 Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
+    RebuildPass pass;
+    if (isRebuilt(ctx))
+        return value = rebuilt_value;
+
     propagateType();
     lhs->rebuild(ctx);
     rhs->rebuild(ctx);
@@ -1544,10 +1670,13 @@ Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
 
     if (!eval_scalar_res->getCurrentValue().hasUB()) {
         value = eval_res;
+        markRebuilt(ctx);
         return eval_res;
     }
 
     UBKind ub = eval_scalar_res->getCurrentValue().getUBCode();
+    Statistics &stats = Statistics::getInstance();
+    stats.addUB(ub);
 
     switch (op) {
         case BinaryOp::ADD:
@@ -1625,14 +1754,12 @@ Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
                 auto adjust_val = IRValue(rhs_int_type->getIntTypeId());
                 assert(new_val > 0 && "Correction values can't be negative");
                 adjust_val.setValue(IRValue::AbsValue{false, new_val});
-                auto const_val = std::make_shared<ConstantExpr>(adjust_val);
+                auto const_val = makeIRNode<ConstantExpr>(adjust_val);
                 if (ub == UBKind::ShiftRhsNeg)
-                    rhs = std::make_shared<BinaryExpr>(BinaryOp::ADD, rhs,
-                                                       const_val);
+                    rhs = makeIRNode<BinaryExpr>(BinaryOp::ADD, rhs, const_val);
                 // UBKind::ShiftRhsLarge
                 else
-                    rhs = std::make_shared<BinaryExpr>(BinaryOp::SUB, rhs,
-                                                       const_val);
+                    rhs = makeIRNode<BinaryExpr>(BinaryOp::SUB, rhs, const_val);
             }
             // UBKind::NegShift
             else {
@@ -1643,9 +1770,8 @@ Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
                 auto lhs_int_type = std::static_pointer_cast<IntegralType>(
                     lhs->getValue()->getType());
                 auto const_val =
-                    std::make_shared<ConstantExpr>(lhs_int_type->getMax());
-                lhs =
-                    std::make_shared<BinaryExpr>(BinaryOp::ADD, lhs, const_val);
+                    makeIRNode<ConstantExpr>(lhs_int_type->getMax());
+                lhs = makeIRNode<BinaryExpr>(BinaryOp::ADD, lhs, const_val);
             }
             break;
         case BinaryOp::LT:
@@ -1664,6 +1790,7 @@ Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
             ERROR("Bad binary operator");
             break;
     }
+    markDirty();
 
     do {
         eval_res = evaluate(ctx);
@@ -1674,6 +1801,7 @@ Expr::EvalResType BinaryExpr::rebuild(EvalCtx &ctx) {
     } while (eval_scalar_res->getCurrentValue().hasUB());
 
     value = eval_res;
+    markRebuilt(ctx);
     return eval_res;
 }
 
@@ -1756,13 +1884,13 @@ BinaryExpr::create(std::shared_ptr<PopulateCtx> ctx) {
     BinaryOp op = rand_val_gen->getRandId(gen_pol->binary_op_distr);
     auto lhs = ArithmeticExpr::create(ctx);
     auto rhs = ArithmeticExpr::create(ctx);
-    return std::make_shared<BinaryExpr>(op, lhs, rhs);
+    return makeIRNode<BinaryExpr>(op, lhs, rhs);
 }
 
 std::shared_ptr<Expr> BinaryExpr::copy() {
     auto new_lhs = lhs->copy();
     auto new_rhs = rhs->copy();
-    return std::make_shared<BinaryExpr>(op, new_lhs, new_rhs);
+    return makeIRNode<BinaryExpr>(op, new_lhs, new_rhs);
 }
 
 TernaryExpr::TernaryExpr(std::shared_ptr<Expr> _cond,
@@ -1792,7 +1920,7 @@ bool TernaryExpr::propagateType() {
     false_br = integralProm(false_br);
     arithConv(true_br, false_br);
 
-    value = std::make_shared<TypedData>(true_br->getValue()->getType());
+    value = makeIRNode<TypedData>(true_br->getValue()->getType());
 
     return true;
 }
@@ -1815,7 +1943,7 @@ Expr::EvalResType TernaryExpr::evaluate(EvalCtx &ctx) {
         auto scalar_var = std::static_pointer_cast<ScalarVar>(value);
         auto scalar_val = scalar_var->getCurrentValue();
         scalar_val.setUBCode(cond_eval->getUBCode());
-        value = std::make_shared<ScalarVar>(
+        value = makeIRNode<ScalarVar>(
             "", std::static_pointer_cast<IntegralType>(scalar_var->getType()),
             scalar_val);
     }
@@ -1847,14 +1975,14 @@ TernaryExpr::create(std::shared_ptr<PopulateCtx> ctx) {
     auto true_br = ArithmeticExpr::create(ctx);
     auto false_br = ArithmeticExpr::create(ctx);
 
-    return std::make_shared<TernaryExpr>(cond, true_br, false_br);
+    return makeIRNode<TernaryExpr>(cond, true_br, false_br);
 }
 
 std::shared_ptr<Expr> TernaryExpr::copy() {
     auto new_cond = cond->copy();
     auto new_true_br = true_br->copy();
     auto new_false_br = false_br->copy();
-    return std::make_shared<TernaryExpr>(new_cond, new_true_br, new_false_br);
+    return makeIRNode<TernaryExpr>(new_cond, new_true_br, new_false_br);
 }
 
 bool SubscriptExpr::propagateType() {
@@ -1864,11 +1992,11 @@ bool SubscriptExpr::propagateType() {
     auto array_type =
         std::static_pointer_cast<ArrayType>(array->getValue()->getType());
     if (active_dim < array_type->getDimensions().size() - 1)
-        value = std::make_shared<TypedData>(array_type);
+        value = makeIRNode<TypedData>(array_type);
     else {
         if (!array_type->getBaseType()->isIntType())
             ERROR("Only integral types are supported for now");
-        value = std::make_shared<TypedData>(array_type->getBaseType());
+        value = makeIRNode<TypedData>(array_type->getBaseType());
     }
 
     Options &options = Options::getInstance();
@@ -1901,6 +2029,13 @@ bool SubscriptExpr::inBounds(size_t dim, std::shared_ptr<Data> idx_val,
         return in_bounds;
     }
     else if (idx_val->isIterator()) {
+        // Iterators of the enclosing loops are shared between parallel
+        // population tasks, so their limits are evaluated one at a time
+        static std::recursive_mutex iter_limits_mutex;
+        std::unique_lock<std::recursive_mutex> lock(iter_limits_mutex,
+                                                    std::defer_lock);
+        if (Options::getInstance().getPopulateJobsNum() != 0)
+            lock.lock();
         auto iter_var = std::static_pointer_cast<Iterator>(idx_val);
         return inBounds(dim, iter_var->getStart()->evaluate(ctx), ctx) &&
                inBounds(dim, iter_var->getEnd()->evaluate(ctx), ctx);
@@ -1958,8 +2093,15 @@ Expr::EvalResType SubscriptExpr::evaluate(EvalCtx &ctx) {
     if (!inBounds(active_size, idx_eval_res, new_ctx))
         ub_code = UBKind::OutOfBounds;
 
-    if (active_dim < array_type->getDimensions().size() - 1)
+    // UB code is saved in the data itself. The input arrays are shared
+    // between parallel population tasks, so in that case we use a copy of the
+    // array instead of modifying them.
+    if (active_dim < array_type->getDimensions().size() - 1) {
+        if (options.getPopulateJobsNum() != 0)
+            array_eval_res = makeIRNode<Array>(
+                *std::static_pointer_cast<Array>(array_eval_res));
         value = replaceValueWith(value, array_eval_res);
+    }
     else {
         auto array_val = std::static_pointer_cast<Array>(array_eval_res);
         if (!array_type->getBaseType()->isIntType())
@@ -1969,7 +2111,7 @@ Expr::EvalResType SubscriptExpr::evaluate(EvalCtx &ctx) {
         if (!array_type->isUniform())
             value_type->makeVarying();
         value = replaceValueWith(
-            value, std::make_shared<ScalarVar>(
+            value, makeIRNode<ScalarVar>(
                        "",
                        std::static_pointer_cast<IntegralType>(
                            array_type->getBaseType()),
@@ -1993,11 +2135,13 @@ Expr::EvalResType SubscriptExpr::rebuild(EvalCtx &ctx) {
 
     assert(eval_res->getUBCode() == UBKind::OutOfBounds &&
            "Every other UB should be handled before");
+    Statistics &stats = Statistics::getInstance();
+    stats.addUB(UBKind::OutOfBounds);
 
     IRValue active_size_val(idx_int_type_id);
     active_size_val.setValue({false, active_size});
-    auto size_constant = std::make_shared<ConstantExpr>(active_size_val);
-    idx = std::make_shared<BinaryExpr>(BinaryOp::MOD, idx, size_constant);
+    auto size_constant = makeIRNode<ConstantExpr>(active_size_val);
+    idx = makeIRNode<BinaryExpr>(BinaryOp::MOD, idx, size_constant);
 
     eval_res = evaluate(ctx);
     assert(eval_res->hasUB() && "All of the UB should be fixed by now");
@@ -2021,7 +2165,7 @@ void SubscriptExpr::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 
 std::vector<std::shared_ptr<Array>>
 SubscriptExpr::getSuitableArrays(std::shared_ptr<PopulateCtx> ctx) {
-    auto arrays = ctx->getExtInpSymTable()->getArrays();
+    auto &arrays = ctx->getExtInpSymTable()->getArrays();
     std::vector<std::shared_ptr<Array>> avail_arrs;
     for (auto &arr : arrays) {
         assert(arr->getType()->isArrayType() &&
@@ -2255,7 +2399,7 @@ SubscriptExpr::initImpl(ArrayStencilParams array_params,
             }
             IRValue new_val(rand_val_gen->getRandId(gen_pol->int_type_distr));
             new_val.setValue(IRValue::AbsValue{false, init_val});
-            iter_use_expr = std::make_shared<ConstantExpr>(new_val);
+            iter_use_expr = makeIRNode<ConstantExpr>(new_val);
         }
         else if (subs_kind == SubscriptKind::ITER ||
                  subs_kind == SubscriptKind::OFFSET ||
@@ -2330,7 +2474,7 @@ SubscriptExpr::initImpl(ArrayStencilParams array_params,
                     ERROR("Unknown dims order kind");
             }
             assert(iter && "Iterator not defined");
-            iter_use_expr = std::make_shared<IterUseExpr>(iter);
+            iter_use_expr = makeIRNode<IterUseExpr>(iter);
         }
         else if (subs_kind == SubscriptKind::REPEAT) {
             auto repeated_elem = rand_val_gen->getRandElem(subs_exprs);
@@ -2378,25 +2522,31 @@ SubscriptExpr::initImpl(ArrayStencilParams array_params,
             std::reverse(subs_exprs.begin(), subs_exprs.end());
     }
 
-    std::shared_ptr<Expr> res_expr = std::make_shared<ArrayUseExpr>(array);
+    assert(mul_val_axis_idx == array->getMulValsAxisIdx() &&
+           "Every dimension of the array should have a subscript");
+    return init(array, subs_exprs);
+}
+
+std::shared_ptr<SubscriptExpr> SubscriptExpr::init(
+    std::shared_ptr<Array> arr,
+    const std::vector<std::pair<std::shared_ptr<Expr>, int64_t>> &subs_exprs) {
+    std::shared_ptr<Expr> res_expr = makeIRNode<ArrayUseExpr>(arr);
     for (size_t i = 0; i < subs_exprs.size(); ++i) {
         auto new_expr =
-            std::make_shared<SubscriptExpr>(res_expr, subs_exprs.at(i).first);
+            makeIRNode<SubscriptExpr>(res_expr, subs_exprs.at(i).first);
         new_expr->active_dim = i;
         new_expr->setOffset(subs_exprs.at(i).second);
-        new_expr->at_mul_val_axis = mul_val_axis_idx == static_cast<int64_t>(i);
+        new_expr->at_mul_val_axis =
+            arr->getMulValsAxisIdx() == static_cast<int64_t>(i);
         res_expr = new_expr;
     }
-
-    res_expr = std::static_pointer_cast<SubscriptExpr>(res_expr);
-
     return std::static_pointer_cast<SubscriptExpr>(res_expr);
 }
 
 std::shared_ptr<Expr> SubscriptExpr::copy() {
     auto new_arr = array->copy();
     auto new_idx = idx->copy();
-    auto ret = std::make_shared<SubscriptExpr>(new_arr, new_idx);
+    auto ret = makeIRNode<SubscriptExpr>(new_arr, new_idx);
     ret->active_dim = active_dim;
     ret->active_size = active_size;
     ret->idx_int_type_id = idx_int_type_id;
@@ -2413,8 +2563,8 @@ bool AssignmentExpr::propagateType() {
     auto from_int_type =
         std::static_pointer_cast<IntegralType>(from->getValue()->getType());
     if (to_int_type != from_int_type) {
-        from = std::make_shared<TypeCastExpr>(from, to_int_type,
-                                              /*is_implicit*/ true);
+        from = makeIRNode<TypeCastExpr>(from, to_int_type,
+                                        /*is_implicit*/ true);
         from->propagateType();
     }
 
@@ -2424,13 +2574,13 @@ bool AssignmentExpr::propagateType() {
             second_from->getValue()->getType());
         if (to_int_type != second_from_int_type)
             second_from =
-                std::make_shared<TypeCastExpr>(second_from, to_int_type, true);
+                makeIRNode<TypeCastExpr>(second_from, to_int_type, true);
         second_from->propagateType();
     }
 
     // TODO: what do we do with the second value? For now it doesn't really
     //  matter, because the types match, and it's all we care about here
-    value = std::make_shared<TypedData>(from->getValue()->getType());
+    value = makeIRNode<TypedData>(from->getValue()->getType());
 
     return true;
 }
@@ -2538,8 +2688,10 @@ void AssignmentExpr::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
                << (cast_to_uniform ? "programIndex"
                                    : versioning_iter->getName(ctx))
                << " % " << Options::vals_number << " == ";
-        stream << (use_zero_as_var ? "zero"
-                                   : std::to_string(Options::main_val_idx))
+        // The variable has the same prefix as the rest of the test symbols
+        stream << (use_zero_as_var
+                       ? NameHandler::getInstance().getPrefix() + "zero"
+                       : std::to_string(Options::main_val_idx))
                << ") ? (";
     }
 
@@ -2582,19 +2734,20 @@ AssignmentExpr::create(std::shared_ptr<PopulateCtx> ctx) {
     std::shared_ptr<Expr> to;
 
     if (!from_val->getType()->isUniform()) {
+        const auto &out_kind_distr = gen_pol->out_kind_distr;
         auto find_res = std::find_if(
-            gen_pol->out_kind_distr.begin(), gen_pol->out_kind_distr.end(),
-            [](Probability<DataKind> &p) {
+            out_kind_distr.begin(), out_kind_distr.end(),
+            [](const Probability<DataKind> &p) {
                 return p.getId() == DataKind::ARR && p.getProb() > 0.0;
             });
-        if (find_res != gen_pol->out_kind_distr.end())
+        if (find_res != out_kind_distr.end())
             out_kind = DataKind::ARR;
     }
 
     if ((out_kind == DataKind::VAR || ctx->getLoopDepth() == 0)) {
         auto new_var = ScalarVar::create(ctx);
         ctx->getExtOutSymTable()->addVar(new_var);
-        auto new_scalar_use_expr = std::make_shared<ScalarVarUseExpr>(new_var);
+        auto new_scalar_use_expr = makeIRNode<ScalarVarUseExpr>(new_var);
         new_scalar_use_expr->setIsDead(false);
         to = new_scalar_use_expr;
     }
@@ -2603,6 +2756,7 @@ AssignmentExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         ctx->getExtOutSymTable()->addArray(new_array);
         auto new_subs_expr = SubscriptExpr::init(new_array, ctx);
         new_subs_expr->setIsDead(false);
+        new_array->setWriteSubs(new_subs_expr);
         to = new_subs_expr;
     }
     else
@@ -2610,15 +2764,15 @@ AssignmentExpr::create(std::shared_ptr<PopulateCtx> ctx) {
 
     if (!from_val->getType()->isUniform() &&
         to->getValue()->getType()->isUniform())
-        from = std::make_shared<ExtractCall>(from);
+        from = makeIRNode<ExtractCall>(from);
 
-    return std::make_shared<AssignmentExpr>(to, from, ctx->isTaken());
+    return makeIRNode<AssignmentExpr>(to, from, ctx->isTaken());
 }
 
 std::shared_ptr<Expr> AssignmentExpr::copy() {
     auto new_from = from->copy();
     auto new_to = to->copy();
-    auto ret = std::make_shared<AssignmentExpr>(new_to, new_from, taken);
+    auto ret = makeIRNode<AssignmentExpr>(new_to, new_from, taken);
     ret->second_from = second_from;
     ret->versioning_iter = versioning_iter;
     return ret;
@@ -2635,37 +2789,183 @@ AssignmentExpr::AssignmentExpr(std::shared_ptr<Expr> _to,
 
 bool ReductionExpr::propagateType() { return AssignmentExpr::propagateType(); }
 
-template <class BinOp>
+// Reductions are evaluated with a bit pattern of the value (zero- or
+// sign-extended to 64 bits). All of the supported types use two's complement
+// representation, so wrap-around arithmetic on the pattern is the same as
+// arithmetic modulo the size of the type.
+static uint64_t getBitPattern(IRValue val) {
+    return val.castToType(IntTypeID::ULLONG).getValueRef<uint64_t>();
+}
+
+static IRValue fromBitPattern(uint64_t pattern, IntTypeID type_id) {
+    return IRValue(IntTypeID::ULLONG, {false, pattern}).castToType(type_id);
+}
+
+static uint64_t powMod64(uint64_t base, uint64_t exp) {
+    uint64_t ret = 1;
+    while (exp != 0) {
+        if (exp & 1)
+            ret *= base;
+        base *= base;
+        exp >>= 1;
+    }
+    return ret;
+}
+
+// Applies the reduction step one iteration at a time. Reductions usually
+// reach a fixed point or a short cycle quickly (e.g., division and modulo),
+// so we detect them and skip the rest of the iterations.
+template <class StepFunc>
+static IRValue simulateReduction(IRValue base, uint64_t total_iters_num,
+                                 StepFunc step) {
+    static size_t constexpr max_cycle_len = 8;
+    std::array<uint64_t, max_cycle_len> history{};
+    history[0] = getBitPattern(base);
+    IRValue ret = base;
+    for (uint64_t i = 1; i <= total_iters_num; ++i) {
+        ret = step(ret);
+        if (ret.hasUB())
+            return IRValue(base.getIntTypeID());
+        uint64_t pattern = getBitPattern(ret);
+        for (uint64_t len = 1; len <= std::min<uint64_t>(max_cycle_len, i);
+             ++len) {
+            if (history[(i - len) % max_cycle_len] != pattern)
+                continue;
+            uint64_t offset = (total_iters_num - i) % len;
+            return fromBitPattern(history[(i - len + offset) % max_cycle_len],
+                                  base.getIntTypeID());
+        }
+        history[i % max_cycle_len] = pattern;
+    }
+    return ret;
+}
+
+// Computes the result of "base op= inc" after total_iters_num iterations.
+// The computation is performed in the common type of base and inc and the
+// result is converted back to the type of the base after each iteration.
+// If any of the iterations has UB, the result has UB too.
 static IRValue reductionHelper(IRValue base, IRValue inc,
-                               size_t total_iters_num, BinOp foo) {
-    auto tmp_op = std::make_shared<BinaryExpr>(
-        BinaryOp::ADD, std::make_shared<ConstantExpr>(base),
-        std::make_shared<ConstantExpr>(inc));
+                               size_t total_iters_num, BinaryOp op) {
+    auto tmp_op =
+        makeIRNode<BinaryExpr>(BinaryOp::ADD, makeIRNode<ConstantExpr>(base),
+                               makeIRNode<ConstantExpr>(inc));
     tmp_op->propagateType();
     auto max_int_type =
         std::static_pointer_cast<IntegralType>(tmp_op->getValue()->getType());
     IntTypeID max_type_id = max_int_type->getIntTypeId();
+    IntTypeID base_type_id = base.getIntTypeID();
 
-    // IRValue approach is about as fast as approach with C++ types, but it
-    // detects UB automatically
-    // Ideally, we want to come up with a precise formula for result
     IRValue conv_inc =
         inc.getIntTypeID() == max_type_id ? inc : inc.castToType(max_type_id);
-    bool need_to_cast_ret = base.getIntTypeID() != max_type_id;
+    if (total_iters_num == 0)
+        return base;
+    if (base.hasUB() || conv_inc.hasUB())
+        return IRValue(base_type_id);
+
+    auto step = [&op, &conv_inc, &max_type_id, &base_type_id](IRValue val) {
+        IRValue conv_val = val.castToType(max_type_id);
+        switch (op) {
+            case BinaryOp::ADD:
+                return (conv_val + conv_inc).castToType(base_type_id);
+            case BinaryOp::SUB:
+                return (conv_val - conv_inc).castToType(base_type_id);
+            case BinaryOp::MUL:
+                return (conv_val * conv_inc).castToType(base_type_id);
+            case BinaryOp::DIV:
+                return (conv_val / conv_inc).castToType(base_type_id);
+            case BinaryOp::MOD:
+                return (conv_val % conv_inc).castToType(base_type_id);
+            case BinaryOp::BIT_XOR:
+                return (conv_val ^ conv_inc).castToType(base_type_id);
+            default:
+                ERROR("Unsupported reduction operation");
+        }
+    };
 
-    IRValue ret = base;
-    for (size_t i = 0; i < total_iters_num; i++) {
-        ret = foo((need_to_cast_ret ? ret.castToType(max_type_id) : ret),
-                  conv_inc)
-                  .castToType(base.getIntTypeID());
+    // Conversion to bool is not a truncation, so closed forms don't work
+    // for it. It has only two values, so the simulation is short anyway.
+    if (base_type_id == IntTypeID::BOOL)
+        return simulateReduction(base, total_iters_num, step);
+
+    uint64_t base_bits = getBitPattern(base);
+    uint64_t inc_bits = getBitPattern(conv_inc);
+    uint64_t iters_num = total_iters_num;
+
+    if (op == BinaryOp::BIT_XOR)
+        return iters_num % 2 == 0
+                   ? base
+                   : fromBitPattern(base_bits ^ inc_bits, base_type_id);
+
+    if (op != BinaryOp::ADD && op != BinaryOp::SUB && op != BinaryOp::MUL)
+        return simulateReduction(base, total_iters_num, step);
+
+    // Unsigned arithmetic can't overflow, and neither can signed arithmetic
+    // if the result fits into the common type for any value of the base type.
+    // In this case the result is the same as the result of wrap-around
+    // arithmetic.
+    bool no_ub = !max_int_type->getIsSigned();
+    auto base_int_type = IntegralType::init(base_type_id);
+    int64_t max_val = max_int_type->getMax().getAbsValue().value;
+    int64_t min_val = -max_val - 1;
+    int64_t inc_val = static_cast<int64_t>(inc_bits);
+    // Base type is narrower than the common type here, so its limits and the
+    // limits of intermediate values fit into int64_t
+    if (!no_ub && base_type_id != max_type_id) {
+        int64_t base_max = base_int_type->getMax().getAbsValue().value;
+        int64_t base_min = base_int_type->getIsSigned() ? -base_max - 1 : 0;
+        if (op == BinaryOp::ADD)
+            no_ub = inc_val >= 0 ? base_max <= max_val - inc_val
+                                 : base_min >= min_val - inc_val;
+        else if (op == BinaryOp::SUB)
+            no_ub = inc_val >= 0 ? base_min >= min_val + inc_val
+                                 : base_max <= max_val + inc_val;
+        else {
+            uint64_t abs_inc = inc_val >= 0 ? inc_val : 0 - inc_bits;
+            uint64_t base_abs_max = std::max<uint64_t>(
+                base_max, 0 - static_cast<uint64_t>(base_min));
+            no_ub = abs_inc <= static_cast<uint64_t>(max_val) / base_abs_max;
+        }
     }
-    return ret;
+
+    if (no_ub) {
+        if (op == BinaryOp::ADD)
+            return fromBitPattern(base_bits + iters_num * inc_bits,
+                                  base_type_id);
+        if (op == BinaryOp::SUB)
+            return fromBitPattern(base_bits - iters_num * inc_bits,
+                                  base_type_id);
+        return fromBitPattern(base_bits * powMod64(inc_bits, iters_num),
+                              base_type_id);
+    }
+
+    // Signed addition and subtraction are monotonic, so we can compute how
+    // many iterations are left before the overflow
+    if (base_type_id == max_type_id && op != BinaryOp::MUL) {
+        bool grows = (op == BinaryOp::ADD) == (inc_val >= 0);
+        uint64_t abs_inc = inc_val >= 0 ? inc_bits : 0 - inc_bits;
+        uint64_t room = grows ? static_cast<uint64_t>(max_val) - base_bits
+                              : base_bits - static_cast<uint64_t>(min_val);
+        if (abs_inc != 0 && iters_num > room / abs_inc)
+            return IRValue(base_type_id);
+        uint64_t diff = iters_num * inc_bits;
+        return fromBitPattern(op == BinaryOp::ADD ? base_bits + diff
+                                                  : base_bits - diff,
+                              base_type_id);
+    }
+
+    // Signed multiplication either overflows in a few iterations or reaches
+    // a fixed point or a cycle of length two. The only remaining case is the
+    // base type that is narrower than the common type and a huge increment.
+    return simulateReduction(base, total_iters_num, step);
 }
 
 Expr::EvalResType ReductionExpr::evaluate(EvalCtx &ctx) {
     if (is_degenerate)
         return AssignmentExpr::evaluate(ctx);
 
+    Statistics &stats = Statistics::getInstance();
+    stats.addReductionEval();
+
     propagateType();
     if (!to->getValue()->getType()->isIntType() ||
         !from->getValue()->getType()->isIntType())
@@ -2696,42 +2996,42 @@ Expr::EvalResType ReductionExpr::evaluate(EvalCtx &ctx) {
     if (bin_op != BinaryOp::MAX_BIN_OP) {
         switch (bin_op) {
             case BinaryOp::ADD:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::plus()));
+                                    ctx.total_iter_num, BinaryOp::ADD));
                 break;
             case BinaryOp::SUB:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::minus()));
+                                    ctx.total_iter_num, BinaryOp::SUB));
                 break;
             case BinaryOp::MUL:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::multiplies()));
+                                    ctx.total_iter_num, BinaryOp::MUL));
                 break;
             case BinaryOp::DIV:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::divides()));
+                                    ctx.total_iter_num, BinaryOp::DIV));
                 break;
             case BinaryOp::MOD:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::modulus()));
+                                    ctx.total_iter_num, BinaryOp::MOD));
                 break;
             case BinaryOp::BIT_AND:
                 result_expr =
-                    std::make_shared<BinaryExpr>(BinaryOp::BIT_AND, to, from);
+                    makeIRNode<BinaryExpr>(BinaryOp::BIT_AND, to, from);
                 break;
             case BinaryOp::BIT_OR:
                 result_expr =
-                    std::make_shared<BinaryExpr>(BinaryOp::BIT_OR, to, from);
+                    makeIRNode<BinaryExpr>(BinaryOp::BIT_OR, to, from);
                 break;
             case BinaryOp::BIT_XOR:
-                result_expr = std::make_shared<ConstantExpr>(
+                result_expr = makeIRNode<ConstantExpr>(
                     reductionHelper(to_eval_val, from_eval_val,
-                                    ctx.total_iter_num, std::bit_xor()));
+                                    ctx.total_iter_num, BinaryOp::BIT_XOR));
                 break;
             default:
                 ERROR("Unsupported Binary Operation");
@@ -2740,18 +3040,17 @@ Expr::EvalResType ReductionExpr::evaluate(EvalCtx &ctx) {
     else if (lib_call_kind != LibCallKind::MAX_LIB_CALL_KIND) {
         switch (lib_call_kind) {
             case LibCallKind::MAX:
-                result_expr = std::make_shared<MaxCall>(to, from);
+                result_expr = makeIRNode<MaxCall>(to, from);
                 break;
             case LibCallKind::MIN:
-                result_expr = std::make_shared<MinCall>(to, from);
+                result_expr = makeIRNode<MinCall>(to, from);
                 break;
             default:
                 ERROR("Unsupported Lib Call");
         }
     }
 
-    result_expr =
-        std::make_shared<TypeCastExpr>(result_expr, to_int_type, true);
+    result_expr = makeIRNode<TypeCastExpr>(result_expr, to_int_type, true);
     result_expr->propagateType();
     auto result_expr_eval_res = result_expr->evaluate(ctx);
     if (result_expr_eval_res->hasUB())
@@ -2877,7 +3176,7 @@ ReductionExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         }
         if (!other_option_exists) {
             auto base_assign_expr = AssignmentExpr::create(ctx);
-            return std::make_shared<ReductionExpr>(
+            return makeIRNode<ReductionExpr>(
                 base_assign_expr, BinaryOp::MAX_BIN_OP,
                 LibCallKind::MAX_LIB_CALL_KIND, true, ctx->isTaken());
         }
@@ -2911,7 +3210,7 @@ ReductionExpr::create(std::shared_ptr<PopulateCtx> ctx) {
             }
 
             if (!bin_op_red_is_supported)
-                return std::make_shared<ReductionExpr>(
+                return makeIRNode<ReductionExpr>(
                     base_assign_expr, BinaryOp::MAX_BIN_OP,
                     LibCallKind::MAX_LIB_CALL_KIND, true, ctx->isTaken());
 
@@ -2920,14 +3219,14 @@ ReductionExpr::create(std::shared_ptr<PopulateCtx> ctx) {
         }
     }
 
-    return std::make_shared<ReductionExpr>(base_assign_expr, bin_op, lib_call,
-                                           false, ctx->isTaken());
+    return makeIRNode<ReductionExpr>(base_assign_expr, bin_op, lib_call, false,
+                                     ctx->isTaken());
 }
 
 std::shared_ptr<Expr> ReductionExpr::copy() {
     auto new_result_expr = result_expr->copy();
     auto new_assign = AssignmentExpr::copy();
-    auto new_reduction = std::make_shared<ReductionExpr>(
+    auto new_reduction = makeIRNode<ReductionExpr>(
         std::static_pointer_cast<AssignmentExpr>(new_assign), bin_op,
         lib_call_kind, is_degenerate, taken);
     new_reduction->result_expr = new_result_expr;
@@ -2992,7 +3291,7 @@ void static ispcBoolPromotion(std::shared_ptr<Expr> &expr) {
     if (!expr_int_type->isUniform())
         int_type =
             std::static_pointer_cast<IntegralType>(int_type->makeVarying());
-    expr = std::make_shared<TypeCastExpr>(expr, int_type, false);
+    expr = makeIRNode<TypeCastExpr>(expr, int_type, false);
 }
 
 void LibCallExpr::ispcArgPromotion(std::shared_ptr<Expr> &arg) {
@@ -3000,7 +3299,7 @@ void LibCallExpr::ispcArgPromotion(std::shared_ptr<Expr> &arg) {
     if (!arg_type->isUniform())
         return;
     arg_type = arg_type->makeVarying();
-    arg = std::make_shared<TypeCastExpr>(arg, arg_type, true);
+    arg = makeIRNode<TypeCastExpr>(arg, arg_type, true);
 }
 
 IntTypeID LibCallExpr::getTopIntID(std::vector<std::shared_ptr<Expr>> args) {
@@ -3026,7 +3325,7 @@ void LibCallExpr::cxxArgPromotion(std::shared_ptr<Expr> &arg,
     auto arg_int_type = std::static_pointer_cast<IntegralType>(arg_type);
     if (arg_int_type->getIntTypeId() == type_id)
         return;
-    arg = std::make_shared<TypeCastExpr>(
+    arg = makeIRNode<TypeCastExpr>(
         arg,
         IntegralType::init(type_id, arg_type->getIsStatic(),
                            arg_type->getCVQualifier(), arg_type->isUniform()),
@@ -3045,7 +3344,7 @@ void static syclBoolPromotion(std::shared_ptr<Expr> &expr) {
         return;
 
     auto int_type = IntegralType::init(IntTypeID::SCHAR);
-    expr = std::make_shared<TypeCastExpr>(expr, int_type, false);
+    expr = makeIRNode<TypeCastExpr>(expr, int_type, false);
 }
 
 MinMaxCallBase::MinMaxCallBase(std::shared_ptr<Expr> _a,
@@ -3076,7 +3375,7 @@ bool MinMaxCallBase::propagateType() {
     cxxArgPromotion(a, top_type_id);
     cxxArgPromotion(b, top_type_id);
 
-    value = std::make_shared<TypedData>(a->getValue()->getType());
+    value = makeIRNode<TypedData>(a->getValue()->getType());
     return true;
 }
 
@@ -3114,8 +3413,8 @@ Expr::EvalResType MinMaxCallBase::evaluate(yarpgen::EvalCtx &ctx) {
         res_val = (a_max_val < b_max_val).getValueRef<bool>() ? a_val : b_val;
     else
         ERROR("Unsupported LibCallKind");
-    value = replaceValueWith(
-        value, std::make_shared<ScalarVar>("", a_int_type, res_val));
+    value =
+        replaceValueWith(value, makeIRNode<ScalarVar>("", a_int_type, res_val));
 
     return value;
 }
@@ -3167,7 +3466,7 @@ MinMaxCallBase::createHelper(std::shared_ptr<PopulateCtx> ctx,
             auto new_type = IntegralType::init(
                 new_type_id, expr_int_type->getIsStatic(),
                 expr_int_type->getCVQualifier(), expr_int_type->isUniform());
-            expr = std::make_shared<TypeCastExpr>(expr, new_type, false);
+            expr = makeIRNode<TypeCastExpr>(expr, new_type, false);
         }
     };
 
@@ -3178,9 +3477,9 @@ MinMaxCallBase::createHelper(std::shared_ptr<PopulateCtx> ctx,
     }
 
     if (kind == LibCallKind::MAX)
-        return std::make_shared<MaxCall>(a, b);
+        return makeIRNode<MaxCall>(a, b);
     else if (kind == LibCallKind::MIN)
-        return std::make_shared<MinCall>(a, b);
+        return makeIRNode<MinCall>(a, b);
     else
         ERROR("Unsupported LibCallKind");
 }
@@ -3218,7 +3517,7 @@ bool SelectCall::propagateType() {
     assert(cond_type->isIntType() && "We support only integral types for now");
     auto cond_int_type = std::static_pointer_cast<IntegralType>(cond_type);
     if (cond_int_type->getIntTypeId() != IntTypeID::BOOL)
-        cond = std::make_shared<TypeCastExpr>(
+        cond = makeIRNode<TypeCastExpr>(
             cond,
             IntegralType::init(IntTypeID::BOOL, cond_type->getIsStatic(),
                                cond_type->getCVQualifier(),
@@ -3243,7 +3542,7 @@ bool SelectCall::propagateType() {
             ispcArgPromotion(false_arg);
         }
     }
-    value = std::make_shared<TypedData>(true_arg->getValue()->getType());
+    value = makeIRNode<TypedData>(true_arg->getValue()->getType());
     return true;
 }
 
@@ -3299,7 +3598,7 @@ SelectCall::create(std::shared_ptr<PopulateCtx> ctx) {
     auto cond = ArithmeticExpr::create(ctx);
     auto true_arg = ArithmeticExpr::create(ctx);
     auto false_arg = ArithmeticExpr::create(ctx);
-    return std::make_shared<SelectCall>(cond, true_arg, false_arg);
+    return makeIRNode<SelectCall>(cond, true_arg, false_arg);
 }
 
 LogicalReductionBase::LogicalReductionBase(std::shared_ptr<Expr> _arg,
@@ -3313,7 +3612,7 @@ bool LogicalReductionBase::propagateType() {
         cxxArgPromotion(arg, IntTypeID::BOOL);
     if (!isAnyArgVarying({arg}))
         ispcArgPromotion(arg);
-    value = std::make_shared<TypedData>(IntegralType::init(IntTypeID::BOOL));
+    value = makeIRNode<TypedData>(IntegralType::init(IntTypeID::BOOL));
     return true;
 }
 
@@ -3336,8 +3635,7 @@ Expr::EvalResType LogicalReductionBase::evaluate(EvalCtx &ctx) {
         ERROR("Unsupported LibCallKind");
     if (arg_val.hasUB())
         init_val.setUBCode(arg_val.getUBCode());
-    value = replaceValueWith(value,
-                             std::make_shared<ScalarVar>("", type, init_val));
+    value = replaceValueWith(value, makeIRNode<ScalarVar>("", type, init_val));
 
     return value;
 }
@@ -3363,11 +3661,11 @@ LogicalReductionBase::createHelper(std::shared_ptr<PopulateCtx> ctx,
                                    LibCallKind kind) {
     auto arg = ArithmeticExpr::create(std::move(ctx));
     if (kind == LibCallKind::ANY)
-        return std::make_shared<AnyCall>(arg);
+        return makeIRNode<AnyCall>(arg);
     else if (kind == LibCallKind::ALL)
-        return std::make_shared<AllCall>(arg);
+        return makeIRNode<AllCall>(arg);
     else if (kind == LibCallKind::NONE)
-        return std::make_shared<NoneCall>(arg);
+        return makeIRNode<NoneCall>(arg);
     else
         ERROR("Unsupported LibCallKind");
 }
@@ -3391,7 +3689,7 @@ bool MinMaxEqReductionBase::propagateType() {
             ->getIntTypeId();
     arg_int_type_id =
         kind != LibCallKind::RED_EQ ? arg_int_type_id : IntTypeID::BOOL;
-    value = std::make_shared<TypedData>(IntegralType::init(arg_int_type_id));
+    value = makeIRNode<TypedData>(IntegralType::init(arg_int_type_id));
     return true;
 }
 
@@ -3411,7 +3709,7 @@ Expr::EvalResType MinMaxEqReductionBase::evaluate(EvalCtx &ctx) {
             std::static_pointer_cast<IntegralType>(arg_eval_res->getType())
                 ->getIntTypeId();
         value = replaceValueWith(
-            value, std::make_shared<ScalarVar>(
+            value, makeIRNode<ScalarVar>(
                        "", IntegralType::init(ret_int_type_id), arg_val));
     }
     else if (kind == LibCallKind::RED_EQ) {
@@ -3419,7 +3717,7 @@ Expr::EvalResType MinMaxEqReductionBase::evaluate(EvalCtx &ctx) {
         init_val.setValue(IRValue::AbsValue{false, true});
         init_val.setUBCode(arg_val.getUBCode());
         value = replaceValueWith(
-            value, std::make_shared<ScalarVar>(
+            value, makeIRNode<ScalarVar>(
                        "", IntegralType::init(IntTypeID::BOOL), init_val));
     }
     else
@@ -3449,11 +3747,11 @@ MinMaxEqReductionBase::createHelper(std::shared_ptr<PopulateCtx> ctx,
                                     LibCallKind kind) {
     auto arg = ArithmeticExpr::create(std::move(ctx));
     if (kind == LibCallKind::RED_MIN)
-        return std::make_shared<ReduceMinCall>(arg);
+        return makeIRNode<ReduceMinCall>(arg);
     else if (kind == LibCallKind::RED_MAX)
-        return std::make_shared<ReduceMaxCall>(arg);
+        return makeIRNode<ReduceMaxCall>(arg);
     else if (kind == LibCallKind::RED_EQ)
-        return std::make_shared<ReduceEqCall>(arg);
+        return makeIRNode<ReduceEqCall>(arg);
     else
         ERROR("Unsupported LibCallKind");
 }
@@ -3462,7 +3760,7 @@ ExtractCall::ExtractCall(std::shared_ptr<Expr> _arg)
     : arg(_arg), is_implicit(false) {
     IRValue idx_val(IntTypeID::UINT);
     idx_val.setValue(IRValue::AbsValue{false, 0});
-    idx = std::make_shared<ConstantExpr>(idx_val);
+    idx = makeIRNode<ConstantExpr>(idx_val);
 }
 
 bool ExtractCall::propagateType() {
@@ -3470,7 +3768,7 @@ bool ExtractCall::propagateType() {
     auto arg_int_type_id =
         std::static_pointer_cast<IntegralType>(arg->getValue()->getType())
             ->getIntTypeId();
-    value = std::make_shared<TypedData>(IntegralType::init(arg_int_type_id));
+    value = makeIRNode<TypedData>(IntegralType::init(arg_int_type_id));
     return true;
 }
 
@@ -3486,8 +3784,8 @@ Expr::EvalResType ExtractCall::evaluate(EvalCtx &ctx) {
     auto arg_type =
         std::static_pointer_cast<IntegralType>(arg_eval_res->getType());
     auto ret_type = IntegralType::init(arg_type->getIntTypeId());
-    value = replaceValueWith(
-        value, std::make_shared<ScalarVar>("", ret_type, arg_val));
+    value =
+        replaceValueWith(value, makeIRNode<ScalarVar>("", ret_type, arg_val));
     return value;
 }
 
@@ -3507,5 +3805,5 @@ void ExtractCall::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 std::shared_ptr<LibCallExpr>
 ExtractCall::create(std::shared_ptr<PopulateCtx> ctx) {
     auto arg = ArithmeticExpr::create(std::move(ctx));
-    return std::make_shared<ExtractCall>(arg);
+    return makeIRNode<ExtractCall>(arg);
 }
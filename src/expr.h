@@ -37,8 +37,11 @@ class PopulateCtx;
 // Common ancestor for all classes that represent various expressions
 class Expr : public IRNode {
   public:
-    explicit Expr(std::shared_ptr<Data> _value) : value(std::move(_value)) {}
-    Expr() = default;
+    explicit Expr(std::shared_ptr<Data> _value)
+        : value(std::move(_value)), propagated_epoch(0), rebuilt_epoch(0),
+          rebuilt_use_main_vals(true) {}
+    Expr()
+        : propagated_epoch(0), rebuilt_epoch(0), rebuilt_use_main_vals(true) {}
 
     // This type represent result of computation. We keep it simple for now,
     // but it might change in the future.
@@ -66,19 +69,41 @@ class Expr : public IRNode {
     // case of UB for multiple values
     virtual std::shared_ptr<Expr> copy() = 0;
 
+    // The number of operations that the expression performs when it is
+    // executed (leaves count as one)
+    virtual size_t getComplexity() { return 1; }
+
   protected:
+    // UB elimination swaps operators and rebuilds the node until the UB is
+    // gone. In order to avoid re-evaluation of the whole subtree on each
+    // attempt, the nodes remember that they were already processed during the
+    // current rebuild pass (i.e. the outermost call of rebuild()).
+    // Only the nodes that were changed and their ancestors are recomputed.
+    class RebuildPass {
+      public:
+        RebuildPass();
+        ~RebuildPass();
+        RebuildPass(const RebuildPass &) = delete;
+        RebuildPass &operator=(const RebuildPass &) = delete;
+    };
+
+    bool isPropagated();
+    void markPropagated();
+    // The result of the evaluation depends on the context, so we compare it
+    // against the context that was used for rebuild
+    bool isRebuilt(EvalCtx &ctx);
+    void markRebuilt(EvalCtx &ctx);
+    // Has to be called every time the node or its child nodes are changed
+    void markDirty();
+
     std::shared_ptr<Data> value;
+    // Value that was computed during the current rebuild pass
+    std::shared_ptr<Data> rebuilt_value;
 
   private:
-    // TODO: add complexity tracker
-    /*
-    uint32_t complexity;
-
-    // Count of expression over all test program
-    static uint32_t total_expr_count;
-    // Count of expression per single test function
-    static uint32_t func_expr_count;
-    */
+    uint64_t propagated_epoch;
+    uint64_t rebuilt_epoch;
+    bool rebuilt_use_main_vals;
 };
 
 // Constant representation
@@ -97,9 +122,6 @@ class ConstantExpr : public Expr {
     create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
-
-  private:
-    static std::vector<std::shared_ptr<ConstantExpr>> used_consts;
 };
 
 // Abstract class that represents access to all sorts of variables
@@ -112,7 +134,7 @@ class VarUseExpr : public Expr {
 class ScalarVarUseExpr : public VarUseExpr {
   public:
     // No one is supposed to call this constructor directly.
-    // It is left public in order to use std::make_shared
+    // It is left public in order to use makeIRNode
     explicit ScalarVarUseExpr(std::shared_ptr<Data> _val)
         : VarUseExpr(std::move(_val)) {}
     static std::shared_ptr<ScalarVarUseExpr> init(std::shared_ptr<Data> _val);
@@ -132,11 +154,6 @@ class ScalarVarUseExpr : public VarUseExpr {
     create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
-
-  private:
-    static std::unordered_map<std::shared_ptr<Data>,
-                              std::shared_ptr<ScalarVarUseExpr>>
-        scalar_var_use_set;
 };
 
 class ArrayUseExpr : public VarUseExpr {
@@ -158,11 +175,6 @@ class ArrayUseExpr : public VarUseExpr {
     };
 
     std::shared_ptr<Expr> copy() final;
-
-  private:
-    static std::unordered_map<std::shared_ptr<Data>,
-                              std::shared_ptr<ArrayUseExpr>>
-        array_use_set;
 };
 
 class IterUseExpr : public VarUseExpr {
@@ -184,11 +196,6 @@ class IterUseExpr : public VarUseExpr {
     };
 
     std::shared_ptr<Expr> copy() final;
-
-  private:
-    static std::unordered_map<std::shared_ptr<Data>,
-                              std::shared_ptr<IterUseExpr>>
-        iter_use_set;
 };
 
 class TypeCastExpr : public Expr {
@@ -208,6 +215,7 @@ class TypeCastExpr : public Expr {
     create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
+    size_t getComplexity() final { return expr->getComplexity() + 1; }
 
   private:
     std::shared_ptr<Expr> expr;
@@ -246,6 +254,7 @@ class UnaryExpr : public ArithmeticExpr {
     static std::shared_ptr<UnaryExpr> create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
+    size_t getComplexity() final { return arg->getComplexity() + 1; }
 
   private:
     UnaryOp op;
@@ -258,6 +267,10 @@ class BinaryExpr : public ArithmeticExpr {
                std::shared_ptr<Expr> _rhs);
     IRNodeKind getKind() final { return IRNodeKind::BINARY; }
 
+    BinaryOp getOp() { return op; }
+    std::shared_ptr<Expr> getLHS() { return lhs; }
+    std::shared_ptr<Expr> getRHS() { return rhs; }
+
     bool propagateType() final;
     EvalResType evaluate(EvalCtx &ctx) final;
     EvalResType rebuild(EvalCtx &ctx) final;
@@ -267,6 +280,9 @@ class BinaryExpr : public ArithmeticExpr {
     static std::shared_ptr<BinaryExpr> create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
+    size_t getComplexity() final {
+        return lhs->getComplexity() + rhs->getComplexity() + 1;
+    }
 
   private:
     BinaryOp op;
@@ -290,6 +306,10 @@ class TernaryExpr : public ArithmeticExpr {
     create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() final;
+    size_t getComplexity() final {
+        return cond->getComplexity() + true_br->getComplexity() +
+               false_br->getComplexity() + 1;
+    }
 
   private:
     std::shared_ptr<Expr> cond;
@@ -305,6 +325,9 @@ class SubscriptExpr : public Expr {
     IRNodeKind getKind() final { return IRNodeKind::SUBSCRIPT; }
 
     size_t getActiveDim() { return active_dim; }
+    std::shared_ptr<Expr> getArray() { return array; }
+    std::shared_ptr<Expr> getIdx() { return idx; }
+    int64_t getOffset() { return stencil_offset; }
 
     bool propagateType() final;
     EvalResType evaluate(EvalCtx &ctx) final;
@@ -314,6 +337,12 @@ class SubscriptExpr : public Expr {
               std::string offset = "") final;
     static std::shared_ptr<SubscriptExpr>
     init(std::shared_ptr<Array> arr, std::shared_ptr<PopulateCtx> ctx);
+    // Subscripts of all of the dimensions of the array with the given index
+    // expressions and stencil offsets
+    static std::shared_ptr<SubscriptExpr>
+    init(std::shared_ptr<Array> arr,
+         const std::vector<std::pair<std::shared_ptr<Expr>, int64_t>>
+             &subs_exprs);
     static std::vector<std::shared_ptr<Array>>
     getSuitableArrays(std::shared_ptr<PopulateCtx> ctx);
     static std::shared_ptr<SubscriptExpr>
@@ -323,6 +352,9 @@ class SubscriptExpr : public Expr {
     void setIsDead(bool val);
 
     std::shared_ptr<Expr> copy() final;
+    size_t getComplexity() final {
+        return array->getComplexity() + idx->getComplexity();
+    }
 
   private:
     static std::shared_ptr<SubscriptExpr>
@@ -330,7 +362,6 @@ class SubscriptExpr : public Expr {
     bool inBounds(size_t dim, std::shared_ptr<Data> idx_val, EvalCtx &ctx);
 
     void setOffset(int64_t _offset) { stencil_offset = _offset; }
-    int64_t getOffset() { return stencil_offset; }
 
     std::shared_ptr<Expr> array;
     std::shared_ptr<Expr> idx;
@@ -364,6 +395,12 @@ class AssignmentExpr : public Expr {
     create(std::shared_ptr<PopulateCtx> ctx);
 
     std::shared_ptr<Expr> copy() override;
+    size_t getComplexity() override {
+        size_t ret = to->getComplexity() + from->getComplexity();
+        if (second_from.use_count() != 0)
+            ret += second_from->getComplexity();
+        return ret;
+    }
 
     std::shared_ptr<Expr> getTo() { return to; }
 
@@ -444,6 +481,9 @@ class MinMaxCallBase : public LibCallExpr {
     }
     void emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
               std::string offset = "") override;
+    size_t getComplexity() final {
+        return a->getComplexity() + b->getComplexity() + 1;
+    }
 
   protected:
     MinMaxCallBase(std::shared_ptr<Expr> _a, std::shared_ptr<Expr> _b,
@@ -473,7 +513,7 @@ class MinCall : public MinMaxCallBase {
     std::shared_ptr<Expr> copy() final {
         auto new_a = a->copy();
         auto new_b = b->copy();
-        return std::make_shared<MinCall>(new_a, new_b);
+        return makeIRNode<MinCall>(new_a, new_b);
     }
 };
 
@@ -492,7 +532,7 @@ class MaxCall : public MinMaxCallBase {
     std::shared_ptr<Expr> copy() final {
         auto new_a = a->copy();
         auto new_b = b->copy();
-        return std::make_shared<MaxCall>(new_a, new_b);
+        return makeIRNode<MaxCall>(new_a, new_b);
     }
 };
 
@@ -507,13 +547,16 @@ class SelectCall : public LibCallExpr {
               std::string offset = "") final;
     static std::shared_ptr<LibCallExpr>
     create(std::shared_ptr<PopulateCtx> ctx);
+    size_t getComplexity() final {
+        return cond->getComplexity() + true_arg->getComplexity() +
+               false_arg->getComplexity() + 1;
+    }
 
     std::shared_ptr<Expr> copy() final {
         auto new_cond = cond->copy();
         auto new_true_arg = true_arg->copy();
         auto new_false_arg = false_arg->copy();
-        return std::make_shared<SelectCall>(new_cond, new_true_arg,
-                                            new_false_arg);
+        return makeIRNode<SelectCall>(new_cond, new_true_arg, new_false_arg);
     }
 
   private:
@@ -532,6 +575,7 @@ class LogicalReductionBase : public LibCallExpr {
     }
     void emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
               std::string offset = "") final;
+    size_t getComplexity() final { return arg->getComplexity() + 1; }
 
   protected:
     LogicalReductionBase(std::shared_ptr<Expr> _arg, LibCallKind _kind);
@@ -553,7 +597,7 @@ class AnyCall : public LogicalReductionBase {
 
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<AnyCall>(new_arg);
+        return makeIRNode<AnyCall>(new_arg);
     }
 };
 
@@ -568,7 +612,7 @@ class AllCall : public LogicalReductionBase {
     }
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<AllCall>(new_arg);
+        return makeIRNode<AllCall>(new_arg);
     }
 };
 
@@ -583,7 +627,7 @@ class NoneCall : public LogicalReductionBase {
     }
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<NoneCall>(new_arg);
+        return makeIRNode<NoneCall>(new_arg);
     }
 };
 
@@ -597,6 +641,7 @@ class MinMaxEqReductionBase : public LibCallExpr {
     }
     void emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
               std::string offset = "") final;
+    size_t getComplexity() final { return arg->getComplexity() + 1; }
 
   protected:
     MinMaxEqReductionBase(std::shared_ptr<Expr> _arg, LibCallKind _kind);
@@ -617,7 +662,7 @@ class ReduceMinCall : public MinMaxEqReductionBase {
     }
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<ReduceMinCall>(new_arg);
+        return makeIRNode<ReduceMinCall>(new_arg);
     }
 };
 
@@ -632,7 +677,7 @@ class ReduceMaxCall : public MinMaxEqReductionBase {
     }
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<ReduceMaxCall>(new_arg);
+        return makeIRNode<ReduceMaxCall>(new_arg);
     }
 };
 
@@ -647,7 +692,7 @@ class ReduceEqCall : public MinMaxEqReductionBase {
     }
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<ReduceEqCall>(new_arg);
+        return makeIRNode<ReduceEqCall>(new_arg);
     }
 };
 
@@ -668,9 +713,11 @@ class ExtractCall : public LibCallExpr {
 
     std::shared_ptr<Expr> copy() final {
         auto new_arg = arg->copy();
-        return std::make_shared<ExtractCall>(new_arg);
+        return makeIRNode<ExtractCall>(new_arg);
     }
 
+    size_t getComplexity() final { return arg->getComplexity() + 1; }
+
     void setIsImplicit(bool _val) { is_implicit = _val; }
 
   protected:
@@ -17,12 +17,151 @@ limitations under the License.
 
 //////////////////////////////////////////////////////////////////////////////
 
+#include "context.h"
 #include "data.h"
 #include "expr.h"
 
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
 using namespace yarpgen;
 
+// Values that are interesting for the reductions: small ones, the ones
+// around zero and the limits of the type
+static std::vector<IRValue> getReductionVals(IntTypeID type_id) {
+    std::vector<IRValue> ret;
+    for (int64_t val : {0, 1, 2, 3, -1, -2, 100, -100}) {
+        IRValue llong_val(IntTypeID::LLONG,
+                          {val < 0, static_cast<uint64_t>(std::abs(val))});
+        ret.push_back(llong_val.castToType(type_id));
+    }
+    auto int_type = IntegralType::init(type_id);
+    ret.push_back(int_type->getMin());
+    ret.push_back(int_type->getMax());
+    IRValue one(IntTypeID::ULLONG, {false, 1});
+    IRValue max_val = int_type->getMax().castToType(IntTypeID::ULLONG);
+    ret.push_back((max_val - one).castToType(type_id));
+    return ret;
+}
+
+// Reference result of "base op= inc": the loop is executed one iteration
+// at a time. As in the emitted code, inc is converted to the type of the base
+// before the reduction.
+static IRValue iterateReduction(IRValue base, IRValue inc, size_t iters_num,
+                                BinaryOp op) {
+    inc = inc.castToType(base.getIntTypeID());
+    auto tmp_expr =
+        std::make_shared<BinaryExpr>(op, std::make_shared<ConstantExpr>(base),
+                                     std::make_shared<ConstantExpr>(inc));
+    tmp_expr->propagateType();
+    auto common_type =
+        std::static_pointer_cast<IntegralType>(tmp_expr->getValue()->getType());
+    IntTypeID common_type_id = common_type->getIntTypeId();
+    IntTypeID base_type_id = base.getIntTypeID();
+    IRValue conv_inc = inc.castToType(common_type_id);
+
+    IRValue ret = base;
+    for (size_t i = 0; i < iters_num; ++i) {
+        IRValue conv_ret = ret.castToType(common_type_id);
+        IRValue step_res;
+        switch (op) {
+            case BinaryOp::ADD:
+                step_res = conv_ret + conv_inc;
+                break;
+            case BinaryOp::SUB:
+                step_res = conv_ret - conv_inc;
+                break;
+            case BinaryOp::MUL:
+                step_res = conv_ret * conv_inc;
+                break;
+            case BinaryOp::DIV:
+                step_res = conv_ret / conv_inc;
+                break;
+            case BinaryOp::MOD:
+                step_res = conv_ret % conv_inc;
+                break;
+            case BinaryOp::BIT_XOR:
+                step_res = conv_ret ^ conv_inc;
+                break;
+            default:
+                ERROR("Unsupported reduction operation");
+        }
+        if (step_res.hasUB())
+            return step_res;
+        ret = step_res.castToType(base_type_id);
+    }
+    return ret;
+}
+
+// Result of "base op= inc" that ReductionExpr computes in closed form
+static IRValue evaluateReduction(IRValue base, IRValue inc, size_t iters_num,
+                                 BinaryOp op) {
+    auto to_var = std::make_shared<ScalarVar>(
+        "to", IntegralType::init(base.getIntTypeID()), base);
+    auto from_var = std::make_shared<ScalarVar>(
+        "from", IntegralType::init(inc.getIntTypeID()), inc);
+    auto assign_expr = std::make_shared<AssignmentExpr>(
+        ScalarVarUseExpr::init(to_var), ScalarVarUseExpr::init(from_var));
+    auto reduction_expr = std::make_shared<ReductionExpr>(
+        assign_expr, op, LibCallKind::MAX_LIB_CALL_KIND, false);
+
+    EvalCtx ctx;
+    ctx.total_iter_num = static_cast<int64_t>(iters_num);
+    auto eval_res = reduction_expr->evaluate(ctx);
+    if (eval_res->hasUB())
+        return IRValue(base.getIntTypeID());
+    reduction_expr->propagateValue(ctx);
+    return to_var->getCurrentValue();
+}
+
+static std::string toString(IRValue val) {
+    if (val.hasUB())
+        return "UB";
+    // The absolute value holds the value sign-extended to 64 bits
+    IRValue::AbsValue abs_val = val.getAbsValue();
+    if (abs_val.isNegative)
+        return std::to_string(static_cast<int64_t>(abs_val.value));
+    return std::to_string(abs_val.value);
+}
+
+static void reductionTest() {
+    auto type_begin = static_cast<int>(IntTypeID::BOOL);
+    auto type_end = static_cast<int>(IntTypeID::MAX_INT_TYPE_ID);
+    for (auto i = type_begin; i < type_end; ++i)
+        for (auto j = type_begin; j < type_end; ++j) {
+            auto base_type_id = static_cast<IntTypeID>(i);
+            auto inc_type_id = static_cast<IntTypeID>(j);
+            for (auto &base : getReductionVals(base_type_id))
+                for (auto &inc : getReductionVals(inc_type_id))
+                    for (BinaryOp op :
+                         {BinaryOp::ADD, BinaryOp::SUB, BinaryOp::MUL,
+                          BinaryOp::DIV, BinaryOp::MOD, BinaryOp::BIT_XOR})
+                        for (size_t iters_num : {0, 1, 2, 3, 7, 64, 1000}) {
+                            IRValue expected =
+                                iterateReduction(base, inc, iters_num, op);
+                            IRValue result =
+                                evaluateReduction(base, inc, iters_num, op);
+                            if (expected.hasUB() == result.hasUB() &&
+                                (expected.hasUB() || expected.getAbsValue() ==
+                                                         result.getAbsValue()))
+                                continue;
+                            std::cout << "ERROR: reduction " << i << " "
+                                      << static_cast<int>(op) << "= " << j
+                                      << " over " << iters_num
+                                      << " iterations: ";
+                            std::cout << toString(base) << ", " << toString(inc)
+                                      << ": expected " << toString(expected)
+                                      << ", got " << toString(result)
+                                      << std::endl;
+                        }
+        }
+}
+
 int main() {
+    reductionTest();
+
     IRValue start_val(IntTypeID::INT);
     start_val.setValue({false, 0});
     auto start_expr = std::make_shared<ConstantExpr>(start_val);
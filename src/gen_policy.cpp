@@ -17,13 +17,16 @@ limitations under the License.
 
 #include "gen_policy.h"
 #include "options.h"
+#include "statistics.h"
+
+#include <algorithm>
+#include <limits>
 
 using namespace yarpgen;
 
 size_t GenPolicy::leaves_prob_bump = 30;
 
-template <typename T>
-static void shuffleProbProxy(std::vector<Probability<T>> &vec) {
+template <typename T> static void shuffleProbProxy(ProbDistr<T> &vec) {
     Options &options = Options::getInstance();
     if (!options.getUseParamShuffle())
         return;
@@ -419,6 +422,51 @@ GenPolicy::GenPolicy() {
     vectorizable_loop_distr.emplace_back(true, 20);
     vectorizable_loop_distr.emplace_back(false, 70);
     shuffleProbProxy(vectorizable_loop_distr);
+
+    if (options.getMaxDynOps() != 0)
+        fitIntoDynOps(options.getMaxDynOps());
+}
+
+uint64_t GenPolicy::estimateLoopDynOps(size_t dim, size_t dims_num) {
+    uint64_t ret = DYN_OPS_PER_ITER_SPACE_POINT;
+    for (size_t i = 0; i < dims_num; ++i) {
+        // Saturate instead of overflowing
+        if (ret > std::numeric_limits<uint64_t>::max() /
+                      std::max(dim, static_cast<size_t>(1)))
+            return std::numeric_limits<uint64_t>::max();
+        ret *= dim;
+    }
+    return ret;
+}
+
+void GenPolicy::fitIntoDynOps(uint64_t max_dyn_ops) {
+    // The depth is the exponent of the cost, so we cut it first, but leave
+    // enough room for the smallest iteration space. In ISPC the loops with
+    // nested foreach can't be smaller than ispc_iter_end_limit_max.
+    size_t min_dim = iters_end_limit_min;
+    if (Options::getInstance().isISPC())
+        min_dim = std::max(min_dim, ispc_iter_end_limit_max);
+    size_t dims_num = std::max(array_dims_num_limit, loop_depth_limit);
+    while (dims_num > 1 && estimateLoopDynOps(min_dim, dims_num) > max_dyn_ops)
+        dims_num--;
+    array_dims_num_limit = std::min(array_dims_num_limit, dims_num);
+    loop_depth_limit = std::min(loop_depth_limit, dims_num);
+
+    while (iter_end_limit_max > 1 &&
+           estimateLoopDynOps(iter_end_limit_max, dims_num) > max_dyn_ops)
+        iter_end_limit_max--;
+    iters_end_limit_min = std::min(iters_end_limit_min, iter_end_limit_max);
+}
+
+GenPolicy::CopyCounter::CopyCounter(const CopyCounter &) {
+    Statistics &stats = Statistics::getInstance();
+    stats.addPolicyCopy();
+}
+
+GenPolicy::CopyCounter &GenPolicy::CopyCounter::operator=(const CopyCounter &) {
+    Statistics &stats = Statistics::getInstance();
+    stats.addPolicyCopy();
+    return *this;
 }
 
 void GenPolicy::makeVectorizable() {
@@ -528,15 +576,15 @@ void GenPolicy::chooseAndApplyConstUse() {
 }
 
 template <typename T>
-void GenPolicy::uniformProbFromMax(std::vector<Probability<T>> &distr,
-                                   size_t max_num, size_t min_num) {
+void GenPolicy::uniformProbFromMax(ProbDistr<T> &distr, size_t max_num,
+                                   size_t min_num) {
     distr.reserve(max_num - min_num);
     for (size_t i = min_num; i <= max_num; ++i)
         distr.emplace_back(i, (max_num - i + 1) * 10);
 }
 
 template <class T, class U>
-void GenPolicy::removeProbability(std::vector<Probability<T>> &orig, U id) {
+void GenPolicy::removeProbability(ProbDistr<T> &orig, U id) {
     (void)std::remove_if(
         orig.begin(), orig.end(),
         [&id](Probability<T> &elem) -> bool { return elem.getId() == id; });
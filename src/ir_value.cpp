@@ -20,38 +20,130 @@ limitations under the License.
 #include "ir_value.h"
 #include "type.h"
 
+#include <array>
+#include <functional>
+
 using namespace yarpgen;
 
 IRValue::IRValue()
-    : type_id(IntTypeID::MAX_INT_TYPE_ID), ub_code(UBKind::Uninit) {
+    : type_tag(static_cast<uint8_t>(IntTypeID::MAX_INT_TYPE_ID)),
+      ub_tag(static_cast<uint8_t>(UBKind::Uninit)) {
     value.ullong_val = 0;
 }
 
 IRValue::IRValue(IntTypeID _type_id)
-    : type_id(_type_id), ub_code(UBKind::Uninit) {
+    : type_tag(static_cast<uint8_t>(_type_id)),
+      ub_tag(static_cast<uint8_t>(UBKind::Uninit)) {
     value.ullong_val = 0;
 }
 
 IRValue::IRValue(IntTypeID _type_id, IRValue::AbsValue _val)
-    : type_id(_type_id), ub_code(UBKind::NoUB) {
+    : type_tag(static_cast<uint8_t>(_type_id)),
+      ub_tag(static_cast<uint8_t>(UBKind::NoUB)) {
+    value.ullong_val = 0;
     setValue(_val);
 }
 
-template <> bool &IRValue::getValueRef() { return value.bool_val; }
-template <> int8_t &IRValue::getValueRef() { return value.schar_val; }
-template <> uint8_t &IRValue::getValueRef() { return value.uchar_val; }
-template <> int16_t &IRValue::getValueRef() { return value.shrt_val; }
-template <> uint16_t &IRValue::getValueRef() { return value.ushrt_val; }
-template <> int32_t &IRValue::getValueRef() { return value.int_val; }
-template <> uint32_t &IRValue::getValueRef() { return value.uint_val; }
-template <> int64_t &IRValue::getValueRef() { return value.llong_val; }
-template <> uint64_t &IRValue::getValueRef() { return value.ullong_val; }
-
 //////////////////////////////////////////////////////////////////////////////
 
 // The idea here is to have a template functions to do all the real work and
-// overloaded operators as a proxy-functions. In order to improve code reuse
-// we usually implement them with define.
+// overloaded operators as a proxy-functions. The operators pick the right
+// instantiation from the dispatch tables, which are indexed by IntTypeID and
+// built at compile time.
+
+using UnaryOpFunc = IRValue (*)(IRValue &);
+using BinaryOpFunc = IRValue (*)(IRValue &, IRValue &);
+using CastOpFunc = IRValue (*)(IntTypeID, IRValue &);
+
+static size_t constexpr int_types_num =
+    static_cast<size_t>(IntTypeID::MAX_INT_TYPE_ID);
+// Arithmetic operations are performed only on the types after the integral
+// promotion: int, unsigned int, long long and unsigned long long
+static size_t constexpr promoted_types_num =
+    int_types_num - static_cast<size_t>(IntTypeID::INT);
+
+static size_t getTypeIdx(IntTypeID type_id) {
+    if (type_id >= IntTypeID::MAX_INT_TYPE_ID)
+        ERROR(std::string("Bad IntTypeID value: ") +
+              std::to_string(static_cast<int>(type_id)));
+    return static_cast<size_t>(type_id);
+}
+
+static size_t getPromotedTypeIdx(IntTypeID type_id) {
+    if (type_id < IntTypeID::INT || type_id >= IntTypeID::MAX_INT_TYPE_ID)
+        ERROR(std::string("Bad IntTypeID value: ") +
+              std::to_string(static_cast<int>(type_id)));
+    return static_cast<size_t>(type_id) - static_cast<size_t>(IntTypeID::INT);
+}
+
+// clang-format off
+#define PromotedTypesTable(__foo__)                                            \
+    {{__foo__<TypeSInt::value_type>, __foo__<TypeUInt::value_type>,            \
+      __foo__<TypeSLLong::value_type>, __foo__<TypeULLong::value_type>}}
+
+#define ShiftTableRow(__foo__, __lhs_value_type__)                             \
+    {{__foo__<__lhs_value_type__, TypeSInt::value_type>,                       \
+      __foo__<__lhs_value_type__, TypeUInt::value_type>,                       \
+      __foo__<__lhs_value_type__, TypeSLLong::value_type>,                     \
+      __foo__<__lhs_value_type__, TypeULLong::value_type>}}
+
+#define ShiftTable(__foo__)                                                    \
+    {{ShiftTableRow(__foo__, TypeSInt::value_type),                            \
+      ShiftTableRow(__foo__, TypeUInt::value_type),                            \
+      ShiftTableRow(__foo__, TypeSLLong::value_type),                          \
+      ShiftTableRow(__foo__, TypeULLong::value_type)}}
+
+#define CastTableRow(__foo__, __to_value_type__)                               \
+    {{__foo__<__to_value_type__, TypeBool::value_type>,                        \
+      __foo__<__to_value_type__, TypeSChar::value_type>,                       \
+      __foo__<__to_value_type__, TypeUChar::value_type>,                       \
+      __foo__<__to_value_type__, TypeSShort::value_type>,                      \
+      __foo__<__to_value_type__, TypeUShort::value_type>,                      \
+      __foo__<__to_value_type__, TypeSInt::value_type>,                        \
+      __foo__<__to_value_type__, TypeUInt::value_type>,                        \
+      __foo__<__to_value_type__, TypeSLLong::value_type>,                      \
+      __foo__<__to_value_type__, TypeULLong::value_type>}}
+
+#define CastTable(__foo__)                                                     \
+    {{CastTableRow(__foo__, TypeBool::value_type),                             \
+      CastTableRow(__foo__, TypeSChar::value_type),                            \
+      CastTableRow(__foo__, TypeUChar::value_type),                            \
+      CastTableRow(__foo__, TypeSShort::value_type),                           \
+      CastTableRow(__foo__, TypeUShort::value_type),                           \
+      CastTableRow(__foo__, TypeSInt::value_type),                             \
+      CastTableRow(__foo__, TypeUInt::value_type),                             \
+      CastTableRow(__foo__, TypeSLLong::value_type),                           \
+      CastTableRow(__foo__, TypeULLong::value_type)}}
+
+#define UnaryOperatorImpl(__foo__)                                             \
+    do {                                                                       \
+        static constexpr std::array<UnaryOpFunc, promoted_types_num> table =   \
+            PromotedTypesTable(__foo__);                                       \
+        return table[getPromotedTypeIdx(getIntTypeID())](*this);               \
+    } while (0)
+
+#define BinaryOperatorImpl(__foo__)                                            \
+    do {                                                                       \
+        static constexpr std::array<BinaryOpFunc, promoted_types_num> table =  \
+            PromotedTypesTable(__foo__);                                       \
+        return table[getPromotedTypeIdx(lhs.getIntTypeID())](lhs, rhs);        \
+    } while (0)
+
+#define ShiftOperatorImpl(__foo__)                                             \
+    do {                                                                       \
+        static constexpr std::array<std::array<BinaryOpFunc,                   \
+                                               promoted_types_num>,            \
+                                    promoted_types_num> table =                \
+            ShiftTable(__foo__);                                               \
+        return table[getPromotedTypeIdx(lhs.getIntTypeID())]                   \
+                    [getPromotedTypeIdx(rhs.getIntTypeID())](lhs, rhs);        \
+    } while (0)
+// clang-format on
+
+// GCC and Clang can check the overflow with a single instruction
+#if defined(__GNUC__) || defined(__clang__)
+#define YARPGEN_HAS_OVERFLOW_BUILTINS
+#endif
 
 IRValue IRValue::operator+() { return {*this}; }
 
@@ -125,6 +217,15 @@ addOperator(IRValue &lhs, IRValue &rhs) {
     IRValue ret(rhs.getIntTypeID());
     if (lhs.hasUB() || rhs.hasUB())
         return ret;
+#ifdef YARPGEN_HAS_OVERFLOW_BUILTINS
+    T res = 0;
+    if (__builtin_add_overflow(lhs.getValueRef<T>(), rhs.getValueRef<T>(),
+                               &res)) {
+        ret.setUBCode(UBKind::SignOvf);
+        return ret;
+    }
+    ret.getValueRef<T>() = res;
+#else
     using unsigned_T = typename std::make_unsigned<T>::type;
     auto ua = static_cast<unsigned_T>(lhs.getValueRef<T>());
     auto ub = static_cast<unsigned_T>(rhs.getValueRef<T>());
@@ -132,11 +233,11 @@ addOperator(IRValue &lhs, IRValue &rhs) {
     ua = (ua >> std::numeric_limits<T>::digits) + std::numeric_limits<T>::max();
     if (static_cast<T>((ua ^ ub) | ~(ub ^ u_tmp)) >= 0) {
         ret.setUBCode(UBKind::SignOvf);
+        return ret;
     }
-    else {
-        ret.getValueRef<T>() = lhs.getValueRef<T>() + rhs.getValueRef<T>();
-        ret.setUBCode(UBKind::NoUB);
-    }
+    ret.getValueRef<T>() = lhs.getValueRef<T>() + rhs.getValueRef<T>();
+#endif
+    ret.setUBCode(UBKind::NoUB);
     return ret;
 }
 
@@ -169,17 +270,27 @@ subOperator(IRValue &lhs, IRValue &rhs) {
     IRValue ret(rhs.getIntTypeID());
     if (lhs.hasUB() || rhs.hasUB())
         return ret;
+#ifdef YARPGEN_HAS_OVERFLOW_BUILTINS
+    T res = 0;
+    if (__builtin_sub_overflow(lhs.getValueRef<T>(), rhs.getValueRef<T>(),
+                               &res)) {
+        ret.setUBCode(UBKind::SignOvf);
+        return ret;
+    }
+    ret.getValueRef<T>() = res;
+#else
     using unsigned_T = typename std::make_unsigned<T>::type;
     auto ua = static_cast<unsigned_T>(lhs.getValueRef<T>());
     auto ub = static_cast<unsigned_T>(rhs.getValueRef<T>());
     unsigned_T u_tmp = ua - ub;
     ua = (ua >> std::numeric_limits<T>::digits) + std::numeric_limits<T>::max();
-    if (static_cast<T>((ua ^ ub) & (ua ^ u_tmp)) < 0)
+    if (static_cast<T>((ua ^ ub) & (ua ^ u_tmp)) < 0) {
         ret.setUBCode(UBKind::SignOvf);
-    else {
-        ret.getValueRef<T>() = static_cast<T>(u_tmp);
-        ret.setUBCode(UBKind::NoUB);
+        return ret;
     }
+    ret.getValueRef<T>() = static_cast<T>(u_tmp);
+#endif
+    ret.setUBCode(UBKind::NoUB);
     return ret;
 }
 
@@ -190,6 +301,13 @@ IRValue yarpgen::operator-(IRValue lhs, IRValue rhs) {
 //////////////////////////////////////////////////////////////////////////////
 
 template <typename T> static bool checkMulIsOk(T a, T b, IRValue &res) {
+#ifdef YARPGEN_HAS_OVERFLOW_BUILTINS
+    T ret = 0;
+    if (__builtin_mul_overflow(a, b, &ret))
+        return false;
+    res.getValueRef<T>() = ret;
+    return true;
+#else
     // Special thanks to http://www.fefe.de/intof.html
 
     using unsigned_T = typename std::make_unsigned<T>::type;
@@ -230,6 +348,7 @@ template <typename T> static bool checkMulIsOk(T a, T b, IRValue &res) {
         res.getValueRef<T>() = ret * static_cast<T>(sign);
 
     return true;
+#endif
 }
 
 template <typename T>
@@ -281,9 +400,9 @@ IRValue yarpgen::operator*(IRValue lhs, IRValue rhs) {
 
 //////////////////////////////////////////////////////////////////////////////
 
-template <typename T>
+template <typename T, typename Op>
 static typename std::enable_if<std::is_unsigned<T>::value, IRValue>::type
-divModImpl(IRValue &lhs, IRValue &rhs, std::function<T(T &, T &)> op) {
+divModImpl(IRValue &lhs, IRValue &rhs, Op op) {
     if (rhs.getIntTypeID() != lhs.getIntTypeID())
         ERROR("Can perform operation only on IRValues with the same IntTypeID");
 
@@ -299,9 +418,9 @@ divModImpl(IRValue &lhs, IRValue &rhs, std::function<T(T &, T &)> op) {
     return ret;
 }
 
-template <typename T>
+template <typename T, typename Op>
 static typename std::enable_if<!std::is_unsigned<T>::value, IRValue>::type
-divModImpl(IRValue &lhs, IRValue &rhs, std::function<T(T &, T &)> op) {
+divModImpl(IRValue &lhs, IRValue &rhs, Op op) {
     if (rhs.getIntTypeID() != lhs.getIntTypeID())
         ERROR("Can perform operation only on IRValues with the same IntTypeID");
 
@@ -345,9 +464,8 @@ IRValue yarpgen::operator%(IRValue lhs, IRValue rhs) {
 
 //////////////////////////////////////////////////////////////////////////////
 
-template <typename T>
-static IRValue cmpEqImpl(IRValue &lhs, IRValue &rhs,
-                         std::function<T(T &, T &)> op) {
+template <typename T, typename Op>
+static IRValue cmpEqImpl(IRValue &lhs, IRValue &rhs, Op op) {
     if (rhs.getIntTypeID() != lhs.getIntTypeID())
         ERROR("Can perform operation only on IRValues with the same IntTypeID");
 
@@ -413,8 +531,8 @@ IRValue yarpgen::operator!=(IRValue lhs, IRValue rhs) {
 
 //////////////////////////////////////////////////////////////////////////////
 
-static IRValue logicalAndOrImpl(IRValue &lhs, IRValue &rhs,
-                                std::function<bool(bool &, bool &)> op) {
+template <typename Op>
+static IRValue logicalAndOrImpl(IRValue &lhs, IRValue &rhs, Op op) {
     if (rhs.getIntTypeID() != lhs.getIntTypeID())
         ERROR("Can perform operation only on IRValues with the same IntTypeID");
     if (lhs.getIntTypeID() != IntTypeID::BOOL)
@@ -447,9 +565,8 @@ IRValue yarpgen::operator||(IRValue lhs, IRValue rhs) {
 
 //////////////////////////////////////////////////////////////////////////////
 
-template <typename T>
-static IRValue bitwiseAndOrXorImpl(IRValue &lhs, IRValue &rhs,
-                                   std::function<T(T &, T &)> op) {
+template <typename T, typename Op>
+static IRValue bitwiseAndOrXorImpl(IRValue &lhs, IRValue &rhs, Op op) {
     if (rhs.getIntTypeID() != lhs.getIntTypeID())
         ERROR("Can perform operation only on IRValues with the same IntTypeID");
 
@@ -587,9 +704,11 @@ static IRValue castOperatorImpl(IntTypeID to_type_id, IRValue &from) {
 }
 
 IRValue IRValue::castToType(IntTypeID to_type_id) {
-    std::function<IRValue(IntTypeID, IRValue &)> func;
-    CastOperatorWrapper(castOperatorImpl);
-    return {func(to_type_id, *this)};
+    static constexpr std::array<std::array<CastOpFunc, int_types_num>,
+                                int_types_num>
+        table = CastTable(castOperatorImpl);
+    return table[getTypeIdx(to_type_id)][getTypeIdx(getIntTypeID())](to_type_id,
+                                                                     *this);
 }
 
 std::ostream &yarpgen::operator<<(std::ostream &out, yarpgen::IRValue &val) {
@@ -613,7 +732,7 @@ IRValue::AbsValue IRValue::getAbsValue() {
     AbsValue ret{false, 0};
     // TODO: function can be called on value which is undefined and we need
     // somehow to pass this information
-    switch (type_id) {
+    switch (getIntTypeID()) {
         // TODO: use defines to make it shorter
         case IntTypeID::BOOL:
             ret.value = value.bool_val;
@@ -654,7 +773,7 @@ IRValue::AbsValue IRValue::getAbsValue() {
 }
 
 void IRValue::setValue(IRValue::AbsValue val) {
-    switch (type_id) {
+    switch (getIntTypeID()) {
         case IntTypeID::BOOL:
             value.bool_val = val.value;
             break;
@@ -694,7 +813,7 @@ void IRValue::setValue(IRValue::AbsValue val) {
             ERROR("Bad IntTypeID");
             break;
     }
-    ub_code = UBKind::NoUB;
+    setUBCode(UBKind::NoUB);
 }
 
 // Find the most significant bit
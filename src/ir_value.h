@@ -24,6 +24,8 @@ limitations under the License.
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 #include "enums.h"
 #include "utils.h"
@@ -60,10 +62,10 @@ class IRValue {
 
     template <typename T> T &getValueRef();
 
-    IntTypeID getIntTypeID() { return type_id; }
-    UBKind getUBCode() { return ub_code; }
-    void setUBCode(UBKind _ub_code) { ub_code = _ub_code; }
-    bool hasUB() { return ub_code != UBKind::NoUB; }
+    IntTypeID getIntTypeID() { return static_cast<IntTypeID>(type_tag); }
+    UBKind getUBCode() { return static_cast<UBKind>(ub_tag); }
+    void setUBCode(UBKind _ub_code) { ub_tag = static_cast<uint8_t>(_ub_code); }
+    bool hasUB() { return getUBCode() != UBKind::NoUB; }
 
     // TODO: we need to add prefix and postfix operators
     IRValue operator+();
@@ -100,152 +102,100 @@ class IRValue {
     void setValue(AbsValue val);
 
   private:
-    IntTypeID type_id;
-    Value value;
-    UBKind ub_code;
+    friend class IRValueVector;
+
+    // Values are copied and passed by value all the time, so they are packed
+    // into 16 bytes: the payload goes first and the tags share the second
+    // half. This way the value fits into a pair of registers.
+    // Explicit alignment keeps the same layout on 32-bit targets, where
+    // 64-bit integers are aligned to 4 bytes
+    alignas(8) Value value;
+    uint8_t type_tag;
+    uint8_t ub_tag;
 };
 
-template <> bool &IRValue::getValueRef();
-template <> int8_t &IRValue::getValueRef();
-template <> uint8_t &IRValue::getValueRef();
-template <> int16_t &IRValue::getValueRef();
-template <> uint16_t &IRValue::getValueRef();
-template <> int32_t &IRValue::getValueRef();
-template <> uint32_t &IRValue::getValueRef();
-template <> int64_t &IRValue::getValueRef();
-template <> uint64_t &IRValue::getValueRef();
-
-//////////////////////////////////////////////////////////////////////////////
-// These are defines that dispatch the appropriate template instantiation
-
-// clang-format off
-#define OperatorWrapperCase(__type_id__, __foo__)                              \
-    case (__type_id__): func = __foo__; break;
-
-#define OperatorWrapper(__foo__, __type_id__)                                  \
-    do {                                                                       \
-        switch (__type_id__) {                                                 \
-            OperatorWrapperCase(IntTypeID::INT,  __foo__<TypeSInt::value_type>)\
-            OperatorWrapperCase(IntTypeID::UINT,                               \
-                                __foo__<TypeUInt::value_type>)                 \
-            OperatorWrapperCase(IntTypeID::LLONG,                              \
-                                __foo__<TypeSLLong::value_type>)               \
-            OperatorWrapperCase(IntTypeID::ULLONG,                             \
-                                __foo__<TypeULLong::value_type>)               \
-            default: ERROR(std::string("Bad IntTypeID value: ") +              \
-                           std::to_string(static_cast<int>(__type_id__)));     \
-        }                                                                      \
-    } while (0)
-
-#define ShiftOperatorWrapperCaseCase(__type_id__, __foo__, __lhs_value_type__, \
-                                     __rhs_value_type__)                       \
-    case (__type_id__):                                                        \
-        func = __foo__<__lhs_value_type__, __rhs_value_type__>;                \
-        break;
-
-#define ShiftOperatorWrapperCase(__type_id__, __foo__, __lhs_value_type__)     \
-    case __type_id__:                                                          \
-        switch (rhs.getIntTypeID()) {                                          \
-            ShiftOperatorWrapperCaseCase(IntTypeID::INT, __foo__,              \
-                                         __lhs_value_type__,                   \
-                                         TypeSInt::value_type)                 \
-            ShiftOperatorWrapperCaseCase(IntTypeID::UINT, __foo__,             \
-                                         __lhs_value_type__,                   \
-                                         TypeUInt::value_type)                 \
-            ShiftOperatorWrapperCaseCase(IntTypeID::LLONG, __foo__,            \
-                                         __lhs_value_type__,                   \
-                                         TypeSLLong::value_type)               \
-            ShiftOperatorWrapperCaseCase(IntTypeID::ULLONG, __foo__,           \
-                                         __lhs_value_type__,                   \
-                                         TypeULLong::value_type)               \
-            default: ERROR(std::string("Bad IntTypeID value: ") +              \
-                           std::to_string(static_cast<int>(rhs.getIntTypeID())));\
-        }                                                                      \
-        break;
+static_assert(static_cast<size_t>(IntTypeID::MAX_INT_TYPE_ID) <= UINT8_MAX &&
+                  static_cast<size_t>(UBKind::MaxUB) <= UINT8_MAX,
+              "Tags of IRValue don't fit into a byte");
+static_assert(sizeof(IRValue) == 16, "IRValue is expected to take 16 bytes");
+static_assert(std::is_trivially_copyable<IRValue>::value,
+              "IRValue is expected to be trivially copyable");
+
+// Vector of IRValues that keeps the payloads and the tags in separate arrays
+// (structure of arrays). The payloads are dense, so the loops over them don't
+// waste the memory bandwidth on the tags.
+class IRValueVector {
+  public:
+    IRValueVector() = default;
+    explicit IRValueVector(size_t size, IRValue val = IRValue())
+        : payloads(size, val.value.ullong_val), type_tags(size, val.type_tag),
+          ub_tags(size, val.ub_tag) {}
+
+    size_t size() const { return payloads.size(); }
+    bool empty() const { return payloads.empty(); }
+    void reserve(size_t size) {
+        payloads.reserve(size);
+        type_tags.reserve(size);
+        ub_tags.reserve(size);
+    }
+    void clear() {
+        payloads.clear();
+        type_tags.clear();
+        ub_tags.clear();
+    }
+
+    void push_back(IRValue val) {
+        payloads.push_back(val.value.ullong_val);
+        type_tags.push_back(val.type_tag);
+        ub_tags.push_back(val.ub_tag);
+    }
+    IRValue get(size_t idx) const {
+        IRValue ret;
+        ret.value.ullong_val = payloads.at(idx);
+        ret.type_tag = type_tags.at(idx);
+        ret.ub_tag = ub_tags.at(idx);
+        return ret;
+    }
+    void set(size_t idx, IRValue val) {
+        payloads.at(idx) = val.value.ullong_val;
+        type_tags.at(idx) = val.type_tag;
+        ub_tags.at(idx) = val.ub_tag;
+    }
+
+    IntTypeID getIntTypeID(size_t idx) const {
+        return static_cast<IntTypeID>(type_tags.at(idx));
+    }
+    bool hasUB(size_t idx) const {
+        return static_cast<UBKind>(ub_tags.at(idx)) != UBKind::NoUB;
+    }
+
+    // Raw arrays for the batch processing. The payload holds the value in
+    // its low bytes, the same way as IRValue::Value does.
+    const std::vector<uint64_t> &getPayloads() const { return payloads; }
+    const std::vector<uint8_t> &getTypeTags() const { return type_tags; }
+    const std::vector<uint8_t> &getUBTags() const { return ub_tags; }
 
-#define ShiftOperatorWrapper(__foo__)                                          \
-    do {                                                                       \
-        switch (lhs.getIntTypeID()) {                                          \
-            ShiftOperatorWrapperCase(IntTypeID::INT, __foo__,                  \
-                                     TypeSInt::value_type)                     \
-            ShiftOperatorWrapperCase(IntTypeID::UINT, __foo__,                 \
-                                     TypeUInt::value_type)                     \
-            ShiftOperatorWrapperCase(IntTypeID::LLONG, __foo__,                \
-                                     TypeSLLong::value_type)                   \
-            ShiftOperatorWrapperCase(IntTypeID::ULLONG, __foo__,               \
-                                     TypeULLong::value_type)                   \
-            default: ERROR(std::string("Bad IntTypeID value: ") +              \
-                           std::to_string(static_cast<int>(lhs.getIntTypeID())));\
-        }                                                                      \
-    } while (0)
-
-#define CastOperatorWrapperCaseCase(__type_id__, __foo__, __to_value_type__,   \
-                                     __from_value_type__)                      \
-    case (__type_id__):                                                        \
-        func = __foo__<__to_value_type__, __from_value_type__>;                \
-        break;
+  private:
+    std::vector<uint64_t> payloads;
+    std::vector<uint8_t> type_tags;
+    std::vector<uint8_t> ub_tags;
+};
 
-#define CastOperatorWrapperCase(__type_id__, __foo__, __to_value_type__)       \
-    case __type_id__:                                                          \
-        switch (type_id) {                                                     \
-            CastOperatorWrapperCaseCase(IntTypeID::BOOL, __foo__,              \
-                                         __to_value_type__,                    \
-                                         TypeBool::value_type)                 \
-            CastOperatorWrapperCaseCase(IntTypeID::SCHAR, __foo__,             \
-                                         __to_value_type__,                    \
-                                         TypeSChar::value_type)                \
-            CastOperatorWrapperCaseCase(IntTypeID::UCHAR, __foo__,             \
-                                         __to_value_type__,                    \
-                                         TypeUChar::value_type)                \
-            CastOperatorWrapperCaseCase(IntTypeID::SHORT, __foo__,             \
-                                         __to_value_type__,                    \
-                                         TypeSShort::value_type)               \
-            CastOperatorWrapperCaseCase(IntTypeID::USHORT, __foo__,            \
-                                         __to_value_type__,                    \
-                                         TypeUShort::value_type)               \
-            CastOperatorWrapperCaseCase(IntTypeID::INT, __foo__,               \
-                                         __to_value_type__,                    \
-                                         TypeSInt::value_type)                 \
-            CastOperatorWrapperCaseCase(IntTypeID::UINT, __foo__,              \
-                                         __to_value_type__,                    \
-                                         TypeUInt::value_type)                 \
-            CastOperatorWrapperCaseCase(IntTypeID::LLONG, __foo__,             \
-                                         __to_value_type__,                    \
-                                         TypeSLLong::value_type)               \
-            CastOperatorWrapperCaseCase(IntTypeID::ULLONG, __foo__,            \
-                                         __to_value_type__,                    \
-                                         TypeULLong::value_type)               \
-            default: ERROR(std::string("Bad IntTypeID value: ") +              \
-                           std::to_string(static_cast<int>(type_id)));         \
-        }                                                                      \
-        break;
+// They are used by every operation, so they have to be inlined
+template <> inline bool &IRValue::getValueRef() { return value.bool_val; }
+template <> inline int8_t &IRValue::getValueRef() { return value.schar_val; }
+template <> inline uint8_t &IRValue::getValueRef() { return value.uchar_val; }
+template <> inline int16_t &IRValue::getValueRef() { return value.shrt_val; }
+template <> inline uint16_t &IRValue::getValueRef() { return value.ushrt_val; }
+template <> inline int32_t &IRValue::getValueRef() { return value.int_val; }
+template <> inline uint32_t &IRValue::getValueRef() { return value.uint_val; }
+template <> inline int64_t &IRValue::getValueRef() { return value.llong_val; }
+template <> inline uint64_t &IRValue::getValueRef() { return value.ullong_val; }
 
-#define CastOperatorWrapper(__foo__)                                           \
-    do {                                                                       \
-        switch (to_type_id) {                                                  \
-            CastOperatorWrapperCase(IntTypeID::BOOL, __foo__,                  \
-                                     TypeBool::value_type)                     \
-            CastOperatorWrapperCase(IntTypeID::SCHAR, __foo__,                 \
-                                     TypeSChar::value_type)                    \
-            CastOperatorWrapperCase(IntTypeID::UCHAR, __foo__,                 \
-                                     TypeUChar::value_type)                    \
-            CastOperatorWrapperCase(IntTypeID::SHORT, __foo__,                 \
-                                     TypeSShort::value_type)                   \
-            CastOperatorWrapperCase(IntTypeID::USHORT, __foo__,                \
-                                     TypeUShort::value_type)                   \
-            CastOperatorWrapperCase(IntTypeID::INT, __foo__,                   \
-                                     TypeSInt::value_type)                     \
-            CastOperatorWrapperCase(IntTypeID::UINT, __foo__,                  \
-                                     TypeUInt::value_type)                     \
-            CastOperatorWrapperCase(IntTypeID::LLONG, __foo__,                 \
-                                     TypeSLLong::value_type)                   \
-            CastOperatorWrapperCase(IntTypeID::ULLONG, __foo__,                \
-                                     TypeULLong::value_type)                   \
-            default: ERROR(std::string("Bad IntTypeID value: ") +              \
-                           std::to_string(static_cast<int>(type_id)));         \
-        }                                                                      \
-    } while (0)
+//////////////////////////////////////////////////////////////////////////////
+// These are defines that help to implement operations for each type
 
+// clang-format off
 #define OutOperatorCase(__type_id__, __type__)                                 \
     case (__type_id__):                                                        \
         out << std::to_string(val.getValueRef<__type__>());                    \
@@ -256,31 +206,6 @@ template <> uint64_t &IRValue::getValueRef();
 
 // clang-format on
 
-//////////////////////////////////////////////////////////////////////////////
-// The majority of operators can be implemented the same way.
-// The only exception if they work only for single type.
-
-#define UnaryOperatorImpl(__foo__)                                             \
-    do {                                                                       \
-        std::function<IRValue(IRValue &)> func;                                \
-        OperatorWrapper(__foo__, getIntTypeID());                              \
-        return {func(*this)};                                                  \
-    } while (0)
-
-#define BinaryOperatorImpl(__foo__)                                            \
-    do {                                                                       \
-        std::function<IRValue(IRValue &, IRValue &)> func;                     \
-        OperatorWrapper(__foo__, lhs.getIntTypeID());                          \
-        return {func(lhs, rhs)};                                               \
-    } while (0)
-
-#define ShiftOperatorImpl(__foo__)                                             \
-    do {                                                                       \
-        std::function<IRValue(IRValue &, IRValue &)> func;                     \
-        ShiftOperatorWrapper(__foo__);                                         \
-        return {func(lhs, rhs)};                                               \
-    } while (0)
-
 //////////////////////////////////////////////////////////////////////////////
 
 std::ostream &operator<<(std::ostream &out, yarpgen::IRValue &val);
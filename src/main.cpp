@@ -18,25 +18,195 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 #include "options.h"
 #include "program.h"
+#include "server.h"
+#include "session.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 using namespace yarpgen;
 
+// Seeds for batch mode: either the seeds from the seed file or a range of
+// consecutive seeds that starts from --seed
+static std::vector<uint64_t> getBatchSeeds(Options &options) {
+    std::vector<uint64_t> seeds;
+    if (!options.getSeedFile().empty()) {
+        std::ifstream seed_file(options.getSeedFile());
+        if (!seed_file)
+            ERROR("Can't open seed file " + options.getSeedFile());
+        uint64_t seed = 0;
+        while (seed_file >> seed)
+            seeds.push_back(seed);
+        if (!seed_file.eof())
+            ERROR("Can't parse seed file " + options.getSeedFile());
+        if (options.getBatchSize() != 0 &&
+            options.getBatchSize() < seeds.size())
+            seeds.resize(options.getBatchSize());
+    }
+    else {
+        uint64_t first_seed = options.getSeed();
+        if (first_seed == 0) {
+            std::random_device rd;
+            first_seed = rd();
+        }
+        for (size_t i = 0; i < options.getBatchSize(); ++i)
+            seeds.push_back(first_seed + i);
+    }
+
+    // Each seed has its own output directory, so we can't generate the same
+    // test twice at the same time
+    std::vector<uint64_t> unique_seeds;
+    std::unordered_set<uint64_t> used_seeds;
+    for (auto seed : seeds) {
+        if (seed == 0)
+            ERROR("Seed 0 is reserved for random seed and can't be batched");
+        if (used_seeds.insert(seed).second)
+            unique_seeds.push_back(seed);
+    }
+    return unique_seeds;
+}
+
+// Command line of a single run that generates exactly the same test as the
+// batch run does for the given seed. We save it in the test, so each test in
+// the batch can be reproduced on its own.
+static std::vector<std::string>
+getSingleRunInvocation(const std::vector<std::string> &raw_options,
+                       uint64_t seed, const std::string &out_dir) {
+    auto starts_with = [](const std::string &str, const std::string &prefix) {
+        return str.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    std::vector<std::string> ret;
+    bool has_seed = false;
+    bool has_out_dir = false;
+    for (size_t i = 0; i < raw_options.size(); ++i) {
+        const std::string &option = raw_options.at(i);
+        if (i == 0)
+            ret.push_back(option);
+        else if (starts_with(option, "--batch=") ||
+                 starts_with(option, "--jobs=") ||
+                 starts_with(option, "--seed-file="))
+            continue;
+        else if (option == "-j")
+            ++i;
+        else if (starts_with(option, "--seed=")) {
+            ret.push_back("--seed=" + std::to_string(seed));
+            has_seed = true;
+        }
+        else if (option == "-s") {
+            ret.insert(ret.end(), {option, std::to_string(seed)});
+            has_seed = true;
+            ++i;
+        }
+        else if (starts_with(option, "--out-dir=")) {
+            ret.push_back("--out-dir=" + out_dir);
+            has_out_dir = true;
+        }
+        else if (option == "-o") {
+            ret.insert(ret.end(), {option, out_dir});
+            has_out_dir = true;
+            ++i;
+        }
+        else
+            ret.push_back(option);
+    }
+    if (!has_seed)
+        ret.push_back("--seed=" + std::to_string(seed));
+    if (!has_out_dir)
+        ret.push_back("--out-dir=" + out_dir);
+    return ret;
+}
+
+// Generates a single test of the batch and returns everything that a
+// standalone run would print
+static std::string generateBatchTest(Options &options, uint64_t seed) {
+    std::string out_dir = options.getOutDir() + "/" + std::to_string(seed);
+    std::error_code err_code;
+    std::filesystem::create_directories(out_dir, err_code);
+    if (err_code)
+        ERROR("Can't create output directory " + out_dir);
+
+    Options test_options(options);
+    test_options.setSeed(seed);
+    test_options.setOutDir(out_dir);
+    test_options.setRawOptions(
+        getSingleRunInvocation(options.getRawOptions(), seed, out_dir));
+
+    std::stringstream log;
+    if (test_options.getBundleSize() > 1) {
+        BundleGenerator bundle(test_options, log);
+        bundle.emit(out_dir);
+        return log.str();
+    }
+    auto session = std::make_shared<GenerationSession>(test_options, log);
+    ProgramGenerator new_program(session);
+    new_program.emit();
+    return log.str();
+}
+
+static void runBatch(Options &options) {
+    std::vector<uint64_t> seeds = getBatchSeeds(options);
+    if (seeds.empty())
+        return;
+
+    size_t jobs_num = options.getJobsNum();
+    if (jobs_num == 0)
+        jobs_num = std::max(std::thread::hardware_concurrency(), 1U);
+    jobs_num = std::min(jobs_num, seeds.size());
+
+    // Tests are generated in arbitrary order, but the log is printed in the
+    // order of seeds to keep it reproducible
+    std::vector<std::string> logs(seeds.size());
+    std::atomic<size_t> next_idx(0);
+    auto worker = [&seeds, &logs, &next_idx, &options]() {
+        for (size_t idx = next_idx++; idx < seeds.size(); idx = next_idx++)
+            logs.at(idx) = generateBatchTest(options, seeds.at(idx));
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(jobs_num);
+    for (size_t i = 0; i < jobs_num; ++i)
+        workers.emplace_back(worker);
+    for (auto &thread : workers)
+        thread.join();
+
+    for (const auto &log : logs)
+        std::cout << log;
+}
+
 int main(int argc, char *argv[]) {
     OptionParser::initOptions();
     OptionParser::parse(argc, argv);
 
     Options &options = Options::getInstance();
-    rand_val_gen = std::make_shared<RandValGen>(options.getSeed());
-    options.setSeed(rand_val_gen->getSeed());
+    if (options.isServeMode()) {
+        GenServer server(options);
+        if (options.getServeEndpoint() == "stdin")
+            server.serve(std::cin, std::cout);
+        else
+            server.serveUnixSocket(options.getServeEndpoint());
+        return 0;
+    }
+
+    if (options.isBatchMode()) {
+        runBatch(options);
+        return 0;
+    }
 
-    if (options.getMutationKind() == MutationKind::EXPRS ||
-        options.getMutationKind() == MutationKind::ALL) {
-        rand_val_gen->setMutationSeed(options.getMutationSeed());
+    if (options.getBundleSize() > 1) {
+        BundleGenerator bundle(options);
+        bundle.emit(options.getOutDir());
+        return 0;
     }
 
     ProgramGenerator new_program;
@@ -18,7 +18,9 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 
 #include "options.h"
+#include "session.h"
 #include "utils.h"
+#include <algorithm>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -94,7 +96,7 @@ std::vector<OptionDescr> yarpgen::OptionParser::options_set{
      "Can't parse check algo",
      OptionParser::parseCheckAlgo,
      "hash",
-     {"hash", "asserts"}},
+     {"hash", "asserts", "precompute", "tree-hash"}},
     {OptionKind::INP_AS_ARGS,
      "",
      "--inp-as-args",
@@ -204,6 +206,147 @@ std::vector<OptionDescr> yarpgen::OptionParser::options_set{
      OptionParser::parseAllowUBInDC,
      "none",
      {"none", "some", "all"}},
+    {OptionKind::BATCH,
+     "",
+     "--batch",
+     true,
+     "Generate a batch of tests with consecutive seeds starting from --seed "
+     "(each test goes to <out-dir>/<seed>)",
+     "Unreachable Error",
+     OptionParser::parseBatch,
+     "0",
+     {}},
+    {OptionKind::JOBS,
+     "-j",
+     "--jobs",
+     true,
+     "Number of worker threads for batch mode (0 is reserved for all "
+     "hardware threads)",
+     "Unreachable Error",
+     OptionParser::parseJobs,
+     "0",
+     {}},
+    {OptionKind::SEED_FILE,
+     "",
+     "--seed-file",
+     true,
+     "Generate a batch of tests with seeds from the file (one per line)",
+     "Unreachable Error",
+     OptionParser::parseSeedFile,
+     "",
+     {}},
+    {OptionKind::SERVE,
+     "",
+     "--serve",
+     true,
+     "Run as a generation server that reads line-delimited JSON requests "
+     "from stdin or from a Unix domain socket with the given path",
+     "Unreachable Error",
+     OptionParser::parseServe,
+     "",
+     {}},
+    {OptionKind::POPULATE_JOBS,
+     "",
+     "--populate-jobs",
+     true,
+     "Number of threads that populate independent statements in parallel "
+     "(0 is reserved for sequential population; the test is the same for any "
+     "other number)",
+     "Unreachable Error",
+     OptionParser::parsePopulateJobs,
+     "0",
+     {}},
+    {OptionKind::STREAM_EMIT,
+     "",
+     "--stream-emit",
+     true,
+     "Emit top-level statements of the test right after they are generated "
+     "and release them to limit the memory usage (can't be used with "
+     "--populate-jobs)",
+     "Can't parse stream emit",
+     OptionParser::parseStreamEmit,
+     "false",
+     {"true", "false"}},
+    {OptionKind::TU_COUNT,
+     "",
+     "--tu-count",
+     true,
+     "Split the test function into the given number of functions that are "
+     "emitted to separate translation units (func_1, func_2, ...) and called "
+     "in order from test() (C, C++ and ISPC only)",
+     "Unreachable Error",
+     OptionParser::parseTUCount,
+     "1",
+     {}},
+    {OptionKind::BUNDLE,
+     "",
+     "--bundle",
+     true,
+     "Generate the given number of independent tests with consecutive seeds "
+     "and emit them into one set of files. The driver prints a checksum for "
+     "each of them",
+     "Unreachable Error",
+     OptionParser::parseBundle,
+     "1",
+     {}},
+    {OptionKind::MAX_DYN_OPS,
+     "",
+     "--max-dynamic-ops",
+     true,
+     "Limit the estimated number of operations that the test performs at run "
+     "time (including init() and checksum()). Smaller iteration spaces, "
+     "loop nests and arrays are generated to stay under the limit "
+     "(0 means no limit)",
+     "Unreachable Error",
+     OptionParser::parseMaxDynOps,
+     "0",
+     {}},
+    {OptionKind::MAX_COMPILE_COST,
+     "",
+     "--max-compile-cost",
+     true,
+     "Limit the estimated cost of the compilation of the test (see the "
+     "header of func.*). The statements are pruned once the test exceeds "
+     "the limit (0 means no limit)",
+     "Unreachable Error",
+     OptionParser::parseMaxCompileCost,
+     "0",
+     {}},
+    {OptionKind::STATS_JSON,
+     "",
+     "--stats-json",
+     true,
+     "Write stats.json next to the generated files. It contains the time of "
+     "each phase of the generation and the counters of the IR nodes, "
+     "eliminated UB, policy copies and evaluated reductions. It can't be "
+     "used in serve mode",
+     "Can't parse stats json",
+     OptionParser::parseStatsJSON,
+     "false",
+     {"true", "false"}},
+    {OptionKind::TRACE,
+     "",
+     "--trace",
+     true,
+     "Write a trace of the generation in Chrome trace-event format to the "
+     "given file (relative to the output folder). It can be opened with "
+     "chrome://tracing or Perfetto. It can't be used in serve mode",
+     "Can't parse trace file name",
+     OptionParser::parseTrace,
+     "",
+     {}},
+    {OptionKind::TRACK_ALLOCS,
+     "",
+     "--track-allocs",
+     true,
+     "Account the memory of the generation: bytes and counts of the IR "
+     "nodes of each kind, folding-set types and copies of the contexts, "
+     "policies and symbol tables, with their high-water marks. The report "
+     "is written to stats.json, so it can't be used in serve mode",
+     "Can't parse track allocs",
+     OptionParser::parseTrackAllocs,
+     "false",
+     {"true", "false"}},
 };
 
 static void dumpVersion(std::ostream &stream) {
@@ -262,6 +405,17 @@ void OptionParser::printHelpAndExit(std::string error_msg) {
     printVersion(error_msg);
 }
 
+// Set while the overrides are applied, so a bad value is reported to the
+// caller instead of terminating the process
+static thread_local std::string *bad_value_err = nullptr;
+
+void OptionParser::reportBadValue(std::string error_msg) {
+    if (!bad_value_err)
+        printHelpAndExit(error_msg);
+    if (bad_value_err->empty())
+        *bad_value_err = std::move(error_msg);
+}
+
 bool OptionParser::optionStartsWith(char *option, const char *test) {
     return !strncmp(option, test, strlen(test));
 }
@@ -339,6 +493,10 @@ void OptionParser::parse(size_t argc, char *argv[]) {
         if (!parsed)
             printHelpAndExit("Unknown option: " + std::string(argv[i]));
     }
+
+    std::string err_msg;
+    if (!validate(err_msg))
+        printHelpAndExit(err_msg);
 }
 
 void OptionParser::initOptions() {
@@ -353,6 +511,91 @@ void OptionParser::initOptions() {
     }
 }
 
+bool OptionParser::parseOverrides(const std::vector<std::string> &args,
+                                  std::string &err_msg) {
+    for (const auto &arg : args) {
+        auto search_func = [&arg](OptionDescr &item) -> bool {
+            if (!item.hasValue())
+                return arg == item.getLongArg();
+            std::string long_arg = item.getLongArg() + "=";
+            return arg.compare(0, long_arg.size(), long_arg) == 0;
+        };
+        auto item =
+            std::find_if(options_set.begin(), options_set.end(), search_func);
+        if (item == options_set.end()) {
+            err_msg = "Unknown option: " + arg;
+            return false;
+        }
+
+        OptionKind kind = item->getKind();
+        if (kind == OptionKind::HELP || kind == OptionKind::VERSION ||
+            kind == OptionKind::BATCH || kind == OptionKind::JOBS ||
+            kind == OptionKind::SEED_FILE || kind == OptionKind::SERVE ||
+            kind == OptionKind::BUNDLE || kind == OptionKind::STATS_JSON ||
+            kind == OptionKind::TRACK_ALLOCS || kind == OptionKind::TRACE) {
+            err_msg = "Option can't be overridden: " + arg;
+            return false;
+        }
+
+        std::string val;
+        if (item->hasValue())
+            val = arg.substr(item->getLongArg().size() + 1);
+        auto avail_vals = item->getAvailVals();
+        if (item->hasValue() && !avail_vals.empty() &&
+            val != item->getDefaultVal() &&
+            std::find(avail_vals.begin(), avail_vals.end(), val) ==
+                avail_vals.end()) {
+            err_msg = item->getErrMsg() + ": " + arg;
+            return false;
+        }
+
+        std::string bad_value_msg;
+        bad_value_err = &bad_value_msg;
+        item->getAction()(val);
+        bad_value_err = nullptr;
+        if (!bad_value_msg.empty()) {
+            err_msg = bad_value_msg + ": " + arg;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OptionParser::validate(std::string &err_msg) {
+    Options &options = Options::getInstance();
+    if (options.getTUCount() > 1) {
+        if (options.isSYCL()) {
+            err_msg = "SYCL test can't be split into several translation units";
+            return false;
+        }
+        if (options.getStreamEmit()) {
+            err_msg = "Streaming emission can't be used with several "
+                      "translation units";
+            return false;
+        }
+        if (options.getBundleSize() > 1) {
+            err_msg =
+                "Bundle of tests can't be split into several translation units";
+            return false;
+        }
+    }
+    if (options.getStreamEmit() && options.getPopulateJobsNum() != 0) {
+        err_msg = "Streaming emission can't be used with parallel population";
+        return false;
+    }
+    // The server replies only with the test files
+    if (options.isServeMode() &&
+        (options.getStatsJSON() || options.getTrackAllocs())) {
+        err_msg = "Statistics can't be written in serve mode";
+        return false;
+    }
+    if (options.isServeMode() && !options.getTraceFile().empty()) {
+        err_msg = "Trace can't be written in serve mode";
+        return false;
+    }
+    return true;
+}
+
 void OptionParser::parseSeed(std::string seed_str) {
     std::stringstream arg_ss(seed_str);
     Options &options = Options::getInstance();
@@ -372,7 +615,7 @@ void OptionParser::parseStandard(std::string std) {
     else if (std == "sycl")
         options.setLangStd(LangStd::SYCL);
     else
-        printHelpAndExit("Bad language standard");
+        reportBadValue("Bad language standard");
 }
 
 void OptionParser::parseCheckAlgo(std::string val) {
@@ -381,8 +624,12 @@ void OptionParser::parseCheckAlgo(std::string val) {
         options.setCheckAlgo(CheckAlgo::HASH);
     else if (val == "asserts")
         options.setCheckAlgo(CheckAlgo::ASSERTS);
+    else if (val == "precompute")
+        options.setCheckAlgo(CheckAlgo::PRECOMPUTE);
+    else if (val == "tree-hash")
+        options.setCheckAlgo(CheckAlgo::TREE_HASH);
     else
-        printHelpAndExit("Can't recognize checking algorithm");
+        reportBadValue("Can't recognize checking algorithm");
 }
 
 void OptionParser::parseInpAsArgs(std::string val) {
@@ -394,7 +641,7 @@ void OptionParser::parseInpAsArgs(std::string val) {
     else if (val == "all")
         options.setInpAsArgs(OptionLevel::ALL);
     else
-        printHelpAndExit("Can't recognize input as arguments use level");
+        reportBadValue("Can't recognize input as arguments use level");
 }
 
 void OptionParser::parseEmitAlignAttr(std::string val) {
@@ -406,7 +653,7 @@ void OptionParser::parseEmitAlignAttr(std::string val) {
     else if (val == "all")
         options.setEmitAlignAttr(OptionLevel::ALL);
     else
-        printHelpAndExit("Can't recognize emit-align-attr use level");
+        reportBadValue("Can't recognize emit-align-attr use level");
 }
 
 void OptionParser::parseUniqueAlignSize(std::string val) {
@@ -416,7 +663,7 @@ void OptionParser::parseUniqueAlignSize(std::string val) {
     else if (val == "false")
         options.setUniqueAlignSize(false);
     else
-        printHelpAndExit("Can't recognize unique align size");
+        reportBadValue("Can't recognize unique align size");
 }
 
 void OptionParser::parseAlignSize(std::string val) {
@@ -429,8 +676,10 @@ void OptionParser::parseAlignSize(std::string val) {
         options.setAlignSize(AlignmentSize::A32);
     else if (val == "64")
         options.setAlignSize(AlignmentSize::A64);
-    else
-        printHelpAndExit("Can't recognize alignment size");
+    else {
+        reportBadValue("Can't recognize alignment size");
+        return;
+    }
     options.setUniqueAlignSize(true);
 }
 
@@ -441,7 +690,7 @@ void OptionParser::parseAllowDeadData(std::string val) {
     else if (val == "false")
         options.setAllowDeadData(false);
     else
-        printHelpAndExit("Can't recognize allow dead data");
+        reportBadValue("Can't recognize allow dead data");
 }
 
 void OptionParser::parseEmitPragmas(std::string val) {
@@ -453,7 +702,7 @@ void OptionParser::parseEmitPragmas(std::string val) {
     else if (val == "all")
         options.setEmitPragmas(OptionLevel::ALL);
     else
-        printHelpAndExit("Can't recognize emit-pragmas use level");
+        reportBadValue("Can't recognize emit-pragmas use level");
 }
 
 void OptionParser::parseOutDir(std::string val) {
@@ -468,7 +717,7 @@ void OptionParser::parseUseParamShuffle(std::string val) {
     else if (val == "false")
         options.setUseParamShuffle(false);
     else
-        printHelpAndExit("Can't recognize allow dead data");
+        reportBadValue("Can't recognize allow dead data");
 }
 
 void OptionParser::parseExplLoopParams(std::string val) {
@@ -478,7 +727,7 @@ void OptionParser::parseExplLoopParams(std::string val) {
     else if (val == "false")
         options.setExplLoopParams(false);
     else
-        printHelpAndExit("Can't recognize explicit loop parameters");
+        reportBadValue("Can't recognize explicit loop parameters");
 }
 
 void OptionParser::parseMutationSeed(std::string mutation_seed_str) {
@@ -498,7 +747,7 @@ void OptionParser::parseMutationKind(std::string mutate_str) {
     else if (mutate_str == "all")
         options.setMutationKind(MutationKind::ALL);
     else
-        printHelpAndExit("Can't recognize mutation parameters");
+        reportBadValue("Can't recognize mutation parameters");
 }
 
 void OptionParser::parseAllowUBInDC(std::string allow_ub_in_dc_str) {
@@ -510,7 +759,136 @@ void OptionParser::parseAllowUBInDC(std::string allow_ub_in_dc_str) {
     else if (allow_ub_in_dc_str == "all")
         options.setAllowUBInDC(OptionLevel::ALL);
     else
-        printHelpAndExit("Can't recognize input as arguments use level");
+        reportBadValue("Can't recognize input as arguments use level");
+}
+
+void OptionParser::parseBatch(std::string batch_str) {
+    std::stringstream arg_ss(batch_str);
+    Options &options = Options::getInstance();
+    size_t batch_size = 0;
+    arg_ss >> batch_size;
+    if (arg_ss.fail()) {
+        reportBadValue("Can't recognize the size of the batch");
+        return;
+    }
+    options.setBatchSize(batch_size);
+}
+
+void OptionParser::parseJobs(std::string jobs_str) {
+    std::stringstream arg_ss(jobs_str);
+    Options &options = Options::getInstance();
+    size_t jobs_num = 0;
+    arg_ss >> jobs_num;
+    if (arg_ss.fail()) {
+        reportBadValue("Can't recognize the number of jobs");
+        return;
+    }
+    options.setJobsNum(jobs_num);
+}
+
+void OptionParser::parseSeedFile(std::string seed_file) {
+    Options &options = Options::getInstance();
+    options.setSeedFile(std::move(seed_file));
+}
+
+void OptionParser::parseServe(std::string endpoint) {
+    Options &options = Options::getInstance();
+    options.setServeEndpoint(std::move(endpoint));
+}
+
+void OptionParser::parsePopulateJobs(std::string jobs_str) {
+    std::stringstream arg_ss(jobs_str);
+    Options &options = Options::getInstance();
+    size_t jobs_num = 0;
+    arg_ss >> jobs_num;
+    options.setPopulateJobsNum(jobs_num);
+}
+
+void OptionParser::parseStreamEmit(std::string val) {
+    Options &options = Options::getInstance();
+    if (val == "true")
+        options.setStreamEmit(true);
+    else if (val == "false")
+        options.setStreamEmit(false);
+    else
+        reportBadValue("Can't recognize stream emit");
+}
+
+void OptionParser::parseTUCount(std::string tu_count_str) {
+    std::stringstream arg_ss(tu_count_str);
+    Options &options = Options::getInstance();
+    size_t tu_count = 0;
+    arg_ss >> tu_count;
+    if (tu_count == 0) {
+        reportBadValue("Can't recognize the number of translation units");
+        return;
+    }
+    options.setTUCount(tu_count);
+}
+
+void OptionParser::parseBundle(std::string bundle_str) {
+    std::stringstream arg_ss(bundle_str);
+    Options &options = Options::getInstance();
+    size_t bundle_size = 0;
+    arg_ss >> bundle_size;
+    if (bundle_size == 0) {
+        reportBadValue("Can't recognize the size of the bundle");
+        return;
+    }
+    options.setBundleSize(bundle_size);
+}
+
+void OptionParser::parseMaxDynOps(std::string max_dyn_ops_str) {
+    std::stringstream arg_ss(max_dyn_ops_str);
+    Options &options = Options::getInstance();
+    uint64_t max_dyn_ops = 0;
+    arg_ss >> max_dyn_ops;
+    if (arg_ss.fail()) {
+        reportBadValue("Can't recognize the limit of dynamic operations");
+        return;
+    }
+    options.setMaxDynOps(max_dyn_ops);
+}
+
+void OptionParser::parseMaxCompileCost(std::string max_compile_cost_str) {
+    std::stringstream arg_ss(max_compile_cost_str);
+    Options &options = Options::getInstance();
+    uint64_t max_compile_cost = 0;
+    arg_ss >> max_compile_cost;
+    if (arg_ss.fail()) {
+        reportBadValue("Can't recognize the limit of the compilation cost");
+        return;
+    }
+    options.setMaxCompileCost(max_compile_cost);
+}
+
+void OptionParser::parseStatsJSON(std::string val) {
+    Options &options = Options::getInstance();
+    if (val == "true")
+        options.setStatsJSON(true);
+    else if (val == "false")
+        options.setStatsJSON(false);
+    else
+        reportBadValue("Can't recognize stats json");
+}
+
+void OptionParser::parseTrace(std::string val) {
+    Options &options = Options::getInstance();
+    options.setTraceFile(std::move(val));
+}
+
+void OptionParser::parseTrackAllocs(std::string val) {
+    Options &options = Options::getInstance();
+    if (val == "true")
+        options.setTrackAllocs(true);
+    else if (val == "false")
+        options.setTrackAllocs(false);
+    else
+        reportBadValue("Can't recognize track allocs");
+}
+
+Options &Options::getInstance() {
+    return GenerationSession::getCurrent().getOptions();
 }
 
 void Options::dump(std::ostream &stream) {
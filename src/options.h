@@ -70,12 +70,21 @@ class OptionParser {
     static void parse(size_t argc, char *argv[]);
     // Initialize options with default values
     static void initOptions();
+    // Applies options in the "--long_arg=<value>" form to the current options.
+    // Unlike parse(), it reports errors instead of terminating the process.
+    static bool parseOverrides(const std::vector<std::string> &args,
+                               std::string &err_msg);
+    // Checks that the current options can be used together. It has to be
+    // called after the options are parsed or overridden.
+    static bool validate(std::string &err_msg);
 
     static std::vector<OptionDescr> options_set;
 
   private:
     static void printVersion(std::string arg);
     static void printHelpAndExit(std::string error_msg = "");
+    // Terminates the process, unless it is called from parseOverrides()
+    static void reportBadValue(std::string error_msg);
     static bool optionStartsWith(char *option, const char *test);
     static bool parseShortArg(size_t argc, size_t &argv_iter, char **&argv,
                               OptionDescr &option);
@@ -99,6 +108,19 @@ class OptionParser {
     static void parseMutationKind(std::string mutate_str);
     static void parseMutationSeed(std::string mutation_seed_str);
     static void parseAllowUBInDC(std::string allow_ub_in_dc_str);
+    static void parseBatch(std::string batch_str);
+    static void parseJobs(std::string jobs_str);
+    static void parseSeedFile(std::string seed_file);
+    static void parseServe(std::string endpoint);
+    static void parsePopulateJobs(std::string jobs_str);
+    static void parseStreamEmit(std::string val);
+    static void parseTUCount(std::string tu_count_str);
+    static void parseBundle(std::string bundle_str);
+    static void parseMaxDynOps(std::string max_dyn_ops_str);
+    static void parseMaxCompileCost(std::string max_compile_cost_str);
+    static void parseStatsJSON(std::string val);
+    static void parseTrace(std::string val);
+    static void parseTrackAllocs(std::string val);
 };
 
 class Options {
@@ -110,14 +132,16 @@ class Options {
     static size_t constexpr main_val_idx = 0;
     static size_t constexpr alt_val_idx = 1;
 
-    static Options &getInstance() {
-        static Options instance;
-        return instance;
-    }
-    Options(const Options &options) = delete;
+    // Options of the generation session that is active on the current thread
+    static Options &getInstance();
+    Options(const Options &options) = default;
     Options &operator=(const Options &) = delete;
 
     void setRawOptions(size_t argc, char *argv[]);
+    void setRawOptions(std::vector<std::string> _raw_options) {
+        raw_options = std::move(_raw_options);
+    }
+    std::vector<std::string> getRawOptions() { return raw_options; }
 
     void setSeed(uint64_t _seed) { seed = _seed; }
     uint64_t getSeed() { return seed; }
@@ -168,9 +192,53 @@ class Options {
     void setAllowUBInDC(OptionLevel _val) { allow_ub_in_dc = _val; }
     OptionLevel getAllowUBInDC() { return allow_ub_in_dc; }
 
+    void setBatchSize(size_t _val) { batch_size = _val; }
+    size_t getBatchSize() { return batch_size; }
+
+    void setJobsNum(size_t _val) { jobs_num = _val; }
+    size_t getJobsNum() { return jobs_num; }
+
+    void setSeedFile(std::string _val) { seed_file = std::move(_val); }
+    std::string getSeedFile() { return seed_file; }
+    bool isBatchMode() { return batch_size != 0 || !seed_file.empty(); }
+
+    void setServeEndpoint(std::string _val) {
+        serve_endpoint = std::move(_val);
+    }
+    std::string getServeEndpoint() { return serve_endpoint; }
+    bool isServeMode() { return !serve_endpoint.empty(); }
+
+    void setPopulateJobsNum(size_t _val) { populate_jobs_num = _val; }
+    size_t getPopulateJobsNum() { return populate_jobs_num; }
+
+    void setStreamEmit(bool val) { stream_emit = val; }
+    bool getStreamEmit() { return stream_emit; }
+
+    void setTUCount(size_t _val) { tu_count = _val; }
+    size_t getTUCount() { return tu_count; }
+
+    void setBundleSize(size_t _val) { bundle_size = _val; }
+    size_t getBundleSize() { return bundle_size; }
+
+    void setMaxDynOps(uint64_t _val) { max_dyn_ops = _val; }
+    uint64_t getMaxDynOps() { return max_dyn_ops; }
+
+    void setMaxCompileCost(uint64_t _val) { max_compile_cost = _val; }
+    uint64_t getMaxCompileCost() { return max_compile_cost; }
+
+    void setStatsJSON(bool val) { stats_json = val; }
+    bool getStatsJSON() { return stats_json; }
+
+    void setTraceFile(std::string _trace_file) { trace_file = _trace_file; }
+    std::string getTraceFile() { return trace_file; }
+
+    void setTrackAllocs(bool val) { track_allocs = val; }
+    bool getTrackAllocs() { return track_allocs; }
+
     void dump(std::ostream &stream);
 
   private:
+    friend class GenerationSession;
     Options()
         : seed(0), std(LangStd::CXX), check_algo(CheckAlgo::HASH),
           inp_as_args(OptionLevel::SOME), emit_align_attr(OptionLevel::SOME),
@@ -179,7 +247,10 @@ class Options {
           emit_pragmas(OptionLevel::SOME), out_dir("."),
           use_param_shuffle(false), expl_loop_params(false),
           mutation_kind(MutationKind::NONE), mutation_seed(0),
-          allow_ub_in_dc(OptionLevel::NONE) {}
+          allow_ub_in_dc(OptionLevel::NONE), batch_size(0), jobs_num(0),
+          populate_jobs_num(0), stream_emit(false), tu_count(1), bundle_size(1),
+          max_dyn_ops(0), max_compile_cost(0), stats_json(false),
+          track_allocs(false) {}
 
     std::vector<std::string> raw_options;
 
@@ -210,5 +281,48 @@ class Options {
 
     // If we want to allow Undefined Behavior in Dead Code
     OptionLevel allow_ub_in_dc;
+
+    // Batch mode: the number of tests to generate in one run and the number
+    // of worker threads (0 means "use all hardware threads")
+    size_t batch_size;
+    size_t jobs_num;
+    // File with the seeds for batch mode (one per line)
+    std::string seed_file;
+
+    // Server mode: "stdin" or a path of a Unix domain socket
+    std::string serve_endpoint;
+
+    // The number of threads that populate independent statements in parallel
+    // (0 means sequential population). The test doesn't depend on the exact
+    // number of threads, but it differs from the one that is populated
+    // sequentially.
+    size_t populate_jobs_num;
+
+    // Emit top-level statements of the test function as soon as they are
+    // populated and release them, so the memory doesn't grow with the size of
+    // the test
+    bool stream_emit;
+
+    // The number of translation units that the test function is split into.
+    // Each of them is compiled separately, so the build can be parallel.
+    size_t tu_count;
+
+    // The number of independent tests that are emitted into one set of files
+    size_t bundle_size;
+
+    // Upper bound for the estimated number of operations that the test
+    // performs at run time (0 means no limit)
+    uint64_t max_dyn_ops;
+    // Upper bound for the estimated cost of the compilation of the test
+    // (0 means no limit). The statements that don't fit are pruned.
+    uint64_t max_compile_cost;
+
+    // Dump the statistics of the generation to stats.json
+    bool stats_json;
+    // Trace of the generation in Chrome trace-event format (empty means that
+    // tracing is disabled)
+    std::string trace_file;
+    // Account the memory of the generation and add it to stats.json
+    bool track_allocs;
 };
 } // namespace yarpgen
@@ -19,16 +19,30 @@ limitations under the License.
 #include "data.h"
 #include "emit_policy.h"
 #include "stmt.h"
+#include <array>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <numeric>
 #include <sstream>
 
 using namespace yarpgen;
 
-ProgramGenerator::ProgramGenerator() : hash_seed(0) {
+ProgramGenerator::ProgramGenerator()
+    : ProgramGenerator(
+          std::make_shared<GenerationSession>(Options::getInstance())) {}
+
+ProgramGenerator::ProgramGenerator(std::shared_ptr<GenerationSession> _session)
+    : session(std::move(_session)), hash_seed(0) {
+    GenerationSession::Scope session_scope(*session);
+    prefix = NameHandler::getInstance().getPrefix();
+
     // Generate the general structure of the test
     auto gen_ctx = std::make_shared<GenCtx>();
-    new_test = ScopeStmt::generateStructure(gen_ctx);
+    {
+        Statistics::PhaseTimer timer(GenPhase::STRUCTURE);
+        new_test = ScopeStmt::generateStructure(gen_ctx);
+    }
 
     // Prepare to generate some math inside the structure
     ext_inp_sym_tbl = std::make_shared<SymbolTable>();
@@ -43,24 +57,95 @@ ProgramGenerator::ProgramGenerator() : hash_seed(0) {
     for (size_t i = 0; i < inp_vars_num; ++i) {
         auto new_var = ScalarVar::create(pop_ctx);
         ext_inp_sym_tbl->addVar(new_var);
-        ext_inp_sym_tbl->addVarExpr(
-            std::make_shared<ScalarVarUseExpr>(new_var));
+        ext_inp_sym_tbl->addVarExpr(makeIRNode<ScalarVarUseExpr>(new_var));
     }
 
     pop_ctx->setExtInpSymTable(ext_inp_sym_tbl);
     pop_ctx->setExtOutSymTable(ext_out_sym_tbl);
 
-    new_test->populate(pop_ctx);
+    Options &options = Options::getInstance();
+    std::shared_ptr<PopulateTaskGroup> task_group;
+    if (options.getPopulateJobsNum() != 0) {
+        task_group = std::make_shared<PopulateTaskGroup>(
+            std::make_shared<TaskPool>(options.getPopulateJobsNum()));
+        pop_ctx->setTaskGroup(task_group);
+    }
+
+    // The combinations of the options are checked by OptionParser::validate
+    assert(!(options.getTUCount() > 1 && options.isSYCL()) &&
+           "SYCL test can't be split into several translation units");
+    assert(!(options.getTUCount() > 1 && options.getStreamEmit()) &&
+           "Streaming emission can't be used with several translation units");
+
+    {
+        Statistics::PhaseTimer timer(GenPhase::POPULATE);
+        if (options.getStreamEmit())
+            populateAndStreamTest(pop_ctx);
+        else
+            new_test->populate(pop_ctx);
+        if (task_group)
+            task_group->join(ext_inp_sym_tbl, ext_out_sym_tbl);
+    }
+
+    if (task_group) {
+        // Names of the data are unique only within a task
+        NameHandler &nh = NameHandler::getInstance();
+        nh.restartDataNames(
+            static_cast<uint32_t>(ext_inp_sym_tbl->getVars().size()), 0);
+        for (auto &array : ext_inp_sym_tbl->getArrays())
+            array->setName(nh.getArrayName());
+        for (auto &var : ext_out_sym_tbl->getVars())
+            var->setName(nh.getVarName());
+        for (auto &array : ext_out_sym_tbl->getArrays())
+            array->setName(nh.getArrayName());
+    }
 
     // Create a special variable that we use to hide the information from
     // compiler
-    auto zero_var = std::make_shared<ScalarVar>(
-        "zero", IntegralType::init(IntTypeID::INT),
+    auto zero_var = makeIRNode<ScalarVar>(
+        prefix + "zero", IntegralType::init(IntTypeID::INT),
         IRValue(IntTypeID::INT, IRValue::AbsValue{false, 0}));
     zero_var->setIsDead(false);
     ext_inp_sym_tbl->addVar(zero_var);
 }
 
+void ProgramGenerator::populateAndStreamTest(std::shared_ptr<PopulateCtx> ctx) {
+    Options &options = Options::getInstance();
+    assert(options.getPopulateJobsNum() == 0 &&
+           "Streaming emission can't be used with parallel population");
+
+    streamed_body.reset(std::tmpfile(), std::fclose);
+    if (!streamed_body)
+        ERROR("Can't create a temporary file for the test function");
+
+    auto emit_ctx = std::make_shared<EmitCtx>();
+    emit_ctx->setIspcTypes(options.isISPC());
+    emit_ctx->setSYCLAccess(options.isSYCL());
+    std::string offset = getTestOffset() + "    ";
+
+    // Emission makes random decisions too. They are taken from a separate
+    // stream, so the population goes the same way as without the streaming.
+    auto emit_rand_gen = rand_val_gen->split(0);
+    auto emit_stmt = [&](const std::shared_ptr<Stmt> &stmt) {
+        std::ostringstream stmt_stream;
+        auto pop_rand_gen = rand_val_gen;
+        rand_val_gen = emit_rand_gen;
+        StmtBlock::emitStmt(emit_ctx, stmt_stream, stmt, offset);
+        rand_val_gen = pop_rand_gen;
+
+        std::string text = stmt_stream.str();
+        if (std::fwrite(text.data(), 1, text.size(), streamed_body.get()) !=
+            text.size())
+            ERROR("Can't write the body of the test function");
+    };
+    new_test->populateAndRelease(ctx, emit_stmt);
+}
+
+std::string ProgramGenerator::getTestOffset() {
+    Options &options = Options::getInstance();
+    return !options.isSYCL() ? "" : "            ";
+}
+
 void ProgramGenerator::emitCheckFunc(std::ostream &stream) {
     std::ostream &out_file = stream;
     out_file << "#include <stdio.h>\n\n";
@@ -79,6 +164,73 @@ void ProgramGenerator::emitCheckFunc(std::ostream &stream) {
                 "int const v) {\n";
     out_file << "    *seed ^= v + 0x9e3779b9 + ((*seed)<<6) + ((*seed)>>2);\n";
     out_file << "}\n\n";
+
+    if (options.getCheckAlgo() == CheckAlgo::TREE_HASH) {
+        out_file << "void hash_tree(unsigned long long int *seed, unsigned "
+                    "long long int *lanes) {\n";
+        out_file << "    for (size_t width = " << tree_hash_lanes_num / 2
+                 << "; width > 0; width /= 2)\n";
+        out_file << "        for (size_t i = 0; i < width; ++i)\n";
+        out_file << "            hash(&lanes[i], lanes[i + width]);\n";
+        out_file << "    hash(seed, lanes[0]);\n";
+        out_file << "}\n\n";
+    }
+}
+
+void ProgramGenerator::emitArrayTreeHash(std::shared_ptr<EmitCtx> ctx,
+                                         std::ostream &stream,
+                                         const std::shared_ptr<Array> &array) {
+    auto array_type = std::static_pointer_cast<ArrayType>(array->getType());
+    std::string base_type_name = array_type->getBaseType()->getName(ctx);
+    size_t elems_num = getArrayElemsNum(array);
+    size_t full_num = elems_num - elems_num % tree_hash_lanes_num;
+    // The same as hash(), but it is easier for the compilers to vectorize
+    auto emit_lane_update = [&stream](const std::string &elem) {
+        stream << "lanes[j] ^= (unsigned long long int) data[" << elem
+               << "] + 0x9e3779b9 + (lanes[j] << 6) + (lanes[j] >> 2);\n";
+    };
+
+    // Each lane hashes every tree_hash_lanes_num-th element, so the lanes are
+    // independent and the loop can be vectorized
+    stream << "    {\n";
+    stream << "        const " << base_type_name << " *data = (const "
+           << base_type_name << " *) " << array->getName(ctx) << ";\n";
+    stream << "        unsigned long long int lanes[" << tree_hash_lanes_num
+           << "] = {0};\n";
+    stream << "        for (size_t i = 0; i < " << full_num
+           << "; i += " << tree_hash_lanes_num << ")\n";
+    stream << "            for (size_t j = 0; j < " << tree_hash_lanes_num
+           << "; ++j)\n";
+    stream << "                ";
+    emit_lane_update("i + j");
+    if (full_num != elems_num) {
+        stream << "        for (size_t j = 0; j < " << elems_num - full_num
+               << "; ++j)\n";
+        stream << "            ";
+        emit_lane_update(std::to_string(full_num) + " + j");
+    }
+    stream << "        hash_tree(&seed, lanes);\n";
+    stream << "    }\n";
+}
+
+void ProgramGenerator::emitArrayWeightedSum(
+    std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
+    const std::shared_ptr<Array> &array) {
+    auto array_type = std::static_pointer_cast<ArrayType>(array->getType());
+    std::string base_type_name = array_type->getBaseType()->getName(ctx);
+
+    // Unlike hash(), the sum doesn't depend on the order of the elements, so
+    // it can be precomputed without visiting each of them (see hashArray)
+    stream << "    {\n";
+    stream << "        const " << base_type_name << " *data = (const "
+           << base_type_name << " *) " << array->getName(ctx) << ";\n";
+    stream << "        unsigned long long int sum = 0;\n";
+    stream << "        for (size_t i = 0; i < " << getArrayElemsNum(array)
+           << "; ++i)\n";
+    stream << "            sum += ((unsigned long long int) data[i] + "
+              "0x9e3779b9) * (i + 1);\n";
+    stream << "        hash(&seed, sum);\n";
+    stream << "    }\n";
 }
 
 static void emitVarsDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
@@ -89,8 +241,8 @@ static void emitVarsDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
     for (auto &var : vars) {
         if (!options.getAllowDeadData() && var->getIsDead())
             continue;
-        auto init_val = std::make_shared<ConstantExpr>(var->getInitValue());
-        auto decl_stmt = std::make_shared<DeclStmt>(var, init_val);
+        auto init_val = makeIRNode<ConstantExpr>(var->getInitValue());
+        auto decl_stmt = makeIRNode<DeclStmt>(var, init_val);
         decl_stmt->emit(ctx, stream);
         stream << "\n";
     }
@@ -120,6 +272,7 @@ static void emitArrayDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 
 void ProgramGenerator::emitDecl(std::shared_ptr<EmitCtx> ctx,
                                 std::ostream &stream) {
+    Statistics::PhaseTimer timer(GenPhase::EMIT_DECL);
     emitVarsDecl(ctx, stream, ext_inp_sym_tbl->getVars());
     emitVarsDecl(ctx, stream, ext_out_sym_tbl->getVars());
 
@@ -150,7 +303,7 @@ static void emitArrayInit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
         stream << "= ";
         auto emit_const_expr = [&array, &ctx, &stream](bool use_main_vals) {
             auto init_val = array->getInitValues(use_main_vals);
-            auto init_const = std::make_shared<ConstantExpr>(init_val);
+            auto init_const = makeIRNode<ConstantExpr>(init_val);
             init_const->emit(ctx, stream);
         };
         if (array->getMulValsAxisIdx() != -1) {
@@ -169,7 +322,8 @@ static void emitArrayInit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 
 void ProgramGenerator::emitInit(std::shared_ptr<EmitCtx> ctx,
                                 std::ostream &stream) {
-    stream << "void init() {\n";
+    Statistics::PhaseTimer timer(GenPhase::EMIT_INIT);
+    stream << "void " << prefix << "init() {\n";
     emitArrayInit(ctx, stream, ext_inp_sym_tbl->getArrays());
     emitArrayInit(ctx, stream, ext_out_sym_tbl->getArrays());
     stream << "}\n\n";
@@ -177,7 +331,8 @@ void ProgramGenerator::emitInit(std::shared_ptr<EmitCtx> ctx,
 
 void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
                                  std::ostream &stream) {
-    stream << "void checksum() {\n";
+    Statistics::PhaseTimer timer(GenPhase::EMIT_CHECK);
+    stream << "void " << prefix << "checksum() {\n";
 
     Options &options = Options::getInstance();
 
@@ -190,14 +345,11 @@ void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
         std::string var_name = var->getName(ctx);
 
         if (options.getCheckAlgo() == CheckAlgo::HASH ||
-            options.getCheckAlgo() == CheckAlgo::PRECOMPUTE) {
+            options.getCheckAlgo() == CheckAlgo::PRECOMPUTE ||
+            options.getCheckAlgo() == CheckAlgo::TREE_HASH)
             stream << "    hash(&seed, " << var_name << ");\n";
-            if (options.getCheckAlgo() == CheckAlgo::PRECOMPUTE)
-                hash(var->getCurrentValue().getAbsValue().value);
-        }
         else if (options.getCheckAlgo() == CheckAlgo::ASSERTS) {
-            auto const_val =
-                std::make_shared<ConstantExpr>(var->getCurrentValue());
+            auto const_val = makeIRNode<ConstantExpr>(var->getCurrentValue());
             stream << "    value_mismatch |= " << var_name << " != ";
             const_val->emit(ctx, stream);
             stream << ";\n";
@@ -210,6 +362,15 @@ void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
     ctx->setSYCLPrefix("");
 
     for (const auto &array : ext_out_sym_tbl->getArrays()) {
+        if (options.getCheckAlgo() == CheckAlgo::TREE_HASH) {
+            emitArrayTreeHash(ctx, stream, array);
+            continue;
+        }
+        if (options.getCheckAlgo() == CheckAlgo::PRECOMPUTE) {
+            emitArrayWeightedSum(ctx, stream, array);
+            continue;
+        }
+
         std::string offset = "    ";
         auto type = array->getType();
         assert(type->isArrayType() && "Array should have an Array type");
@@ -225,12 +386,8 @@ void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
             idx++;
         }
 
-        if (options.getCheckAlgo() == CheckAlgo::HASH ||
-            options.getCheckAlgo() == CheckAlgo::PRECOMPUTE) {
+        if (options.getCheckAlgo() == CheckAlgo::HASH)
             stream << offset << "hash(&seed, ";
-            if (options.getCheckAlgo() == CheckAlgo::PRECOMPUTE)
-                hashArray(array);
-        }
         else if (options.getCheckAlgo() == CheckAlgo::ASSERTS)
             stream << offset << "value_mismatch |= ";
         else
@@ -241,12 +398,12 @@ void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
 
         if (options.getCheckAlgo() == CheckAlgo::ASSERTS) {
             auto const_val =
-                std::make_shared<ConstantExpr>((array->getCurrentValues(true)));
+                makeIRNode<ConstantExpr>((array->getCurrentValues(true)));
             stream << "!= ";
             const_val->emit(ctx, stream);
             auto emit_cmp = [&arr_name, &ctx, &stream](IRValue val) {
                 stream << " && " << arr_name << "!= ";
-                auto const_val = std::make_shared<ConstantExpr>(val);
+                auto const_val = makeIRNode<ConstantExpr>(val);
                 const_val->emit(ctx, stream);
             };
             emit_cmp(array->getInitValues(true));
@@ -262,11 +419,6 @@ void ProgramGenerator::emitCheck(std::shared_ptr<EmitCtx> ctx,
     stream << "}\n";
 }
 
-// This buffer tracks what input data we pass as a parameters to test functions
-static std::vector<std::string> pass_as_param_buffer;
-static bool any_vars_as_params = false;
-static bool any_arrays_as_params = false;
-
 static void emitVarExtDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
                            std::vector<std::shared_ptr<ScalarVar>> vars,
                            bool inp_category) {
@@ -287,8 +439,7 @@ static void emitVarExtDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
         }
 
         if (pass_as_param) {
-            pass_as_param_buffer.push_back(var->getName(ctx));
-            any_vars_as_params = true;
+            ctx->addParamName(var->getName(ctx));
             continue;
         }
         stream << "extern ";
@@ -317,8 +468,7 @@ static void emitArrayExtDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
         }
 
         if (pass_as_param) {
-            pass_as_param_buffer.push_back(array->getName(ctx));
-            any_arrays_as_params = true;
+            ctx->addParamName(array->getName(ctx));
             continue;
         }
 
@@ -369,6 +519,7 @@ static void emitArrayExtDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 
 void ProgramGenerator::emitExtDecl(std::shared_ptr<EmitCtx> ctx,
                                    std::ostream &stream) {
+    Statistics::PhaseTimer timer(GenPhase::EMIT_EXT_DECL);
     Options &options = Options::getInstance();
     if (options.isISPC())
         ctx->setIspcTypes(true);
@@ -391,8 +542,7 @@ static bool emitVarFuncParam(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
     for (auto &var : vars) {
         if (!options.getAllowDeadData() && var->getIsDead())
             continue;
-        if (std::find(pass_as_param_buffer.begin(), pass_as_param_buffer.end(),
-                      var->getName(ctx)) == pass_as_param_buffer.end())
+        if (!ctx->isPassedAsParam(var->getName(ctx)))
             continue;
 
         stream << placeSep(emit_any);
@@ -414,8 +564,7 @@ static void emitArrayFuncParam(std::shared_ptr<EmitCtx> ctx,
     for (auto &array : arrays) {
         if (!options.getAllowDeadData() && array->getIsDead())
             continue;
-        if (std::find(pass_as_param_buffer.begin(), pass_as_param_buffer.end(),
-                      array->getName(ctx)) == pass_as_param_buffer.end())
+        if (!ctx->isPassedAsParam(array->getName(ctx)))
             continue;
 
         auto type = array->getType();
@@ -461,8 +610,8 @@ void emitSYCLAccessors(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
     }
 }
 
-void ProgramGenerator::emitTest(std::shared_ptr<EmitCtx> ctx,
-                                std::ostream &stream) {
+void ProgramGenerator::emitFuncPrologue(std::shared_ptr<EmitCtx> ctx,
+                                        std::ostream &stream) {
     Options &options = Options::getInstance();
     stream << "#include \"init.h\"\n";
     if (options.isC()) {
@@ -474,19 +623,87 @@ void ProgramGenerator::emitTest(std::shared_ptr<EmitCtx> ctx,
     else if (options.isSYCL()) {
         stream << "#include <CL/sycl.hpp>\n";
     }
+}
 
-    if (options.isISPC()) {
+void ProgramGenerator::emitTestParams(std::shared_ptr<EmitCtx> ctx,
+                                      std::ostream &stream, bool emit_type) {
+    Options &options = Options::getInstance();
+    bool emit_any = emitVarFuncParam(ctx, stream, ext_inp_sym_tbl->getVars(),
+                                     emit_type, options.isISPC());
+    emitArrayFuncParam(ctx, stream, emit_any, ext_inp_sym_tbl->getArrays(),
+                       emit_type, options.isISPC(), emit_type);
+}
+
+std::string ProgramGenerator::getTestPartName(size_t idx) {
+    return prefix + "test_" + std::to_string(idx);
+}
+
+void ProgramGenerator::emitTestPartDecl(std::shared_ptr<EmitCtx> ctx,
+                                        std::ostream &stream) {
+    Options &options = Options::getInstance();
+    if (options.getTUCount() == 1)
+        return;
+    if (options.isISPC())
         ctx->setIspcTypes(true);
-        stream << "export ";
+    for (size_t i = 1; i <= options.getTUCount(); ++i) {
+        stream << "void " << getTestPartName(i) << "(";
+        emitTestParams(ctx, stream, true);
+        stream << ");\n";
     }
-    stream << "void test(";
+    ctx->setIspcTypes(false);
+}
 
-    bool emit_any = emitVarFuncParam(ctx, stream, ext_inp_sym_tbl->getVars(),
-                                     true, options.isISPC());
+void ProgramGenerator::emitTestParts(
+    std::shared_ptr<EmitCtx> ctx,
+    const std::vector<std::ostream *> &part_streams) {
+    Statistics::PhaseTimer timer(GenPhase::EMIT_TEST);
+    Options &options = Options::getInstance();
+    if (options.isISPC())
+        ctx->setIspcTypes(true);
+    std::string offset = getTestOffset() + "    ";
+
+    std::vector<std::string> stmt_texts;
+    size_t total_size = 0;
+    for (auto &stmt : new_test->getStmts()) {
+        std::ostringstream stmt_stream;
+        StmtBlock::emitStmt(ctx, stmt_stream, stmt, offset);
+        stmt_texts.push_back(stmt_stream.str());
+        total_size += stmt_texts.back().size();
+    }
 
-    emitArrayFuncParam(ctx, stream, emit_any, ext_inp_sym_tbl->getArrays(),
-                       true, options.isISPC(), true);
+    // Statements are distributed between the parts in order, so that the
+    // parts have roughly the same size
+    auto stmt_iter = stmt_texts.begin();
+    size_t emitted_size = 0;
+    size_t parts_num = part_streams.size();
+    for (size_t i = 1; i <= parts_num; ++i) {
+        std::ostream &stream = *part_streams.at(i - 1);
+        emitFuncPrologue(ctx, stream);
+        stream << "void " << getTestPartName(i) << "(";
+        emitTestParams(ctx, stream, true);
+        stream << ") {\n";
+        size_t part_end = total_size * i / parts_num;
+        while (stmt_iter != stmt_texts.end() &&
+               (i == parts_num || emitted_size < part_end)) {
+            stream << *stmt_iter;
+            emitted_size += stmt_iter->size();
+            ++stmt_iter;
+        }
+        stream << "}\n";
+    }
+    ctx->setIspcTypes(false);
+}
 
+void ProgramGenerator::emitTest(std::shared_ptr<EmitCtx> ctx,
+                                std::ostream &stream) {
+    Statistics::PhaseTimer timer(GenPhase::EMIT_TEST);
+    Options &options = Options::getInstance();
+    if (options.isISPC()) {
+        ctx->setIspcTypes(true);
+        stream << "export ";
+    }
+    stream << "void " << prefix << "test(";
+    emitTestParams(ctx, stream, true);
     stream << ") ";
 
     if (options.isSYCL()) {
@@ -510,12 +727,33 @@ void ProgramGenerator::emitTest(std::shared_ptr<EmitCtx> ctx,
                           ext_inp_sym_tbl->getVars(), true);
         emitSYCLAccessors(ctx, stream, "            ",
                           ext_out_sym_tbl->getVars(), false);
-        stream << "            cgh.single_task<class test_func>([=] ()\n";
+        stream << "            cgh.single_task<class " << prefix
+               << "test_func>([=] ()\n";
     }
 
     if (options.isSYCL())
         ctx->setSYCLAccess(true);
-    new_test->emit(ctx, stream, !options.isSYCL() ? "" : "            ");
+    if (options.getTUCount() > 1) {
+        stream << "{\n";
+        for (size_t i = 1; i <= options.getTUCount(); ++i) {
+            stream << "    " << getTestPartName(i) << "(";
+            emitTestParams(ctx, stream, false);
+            stream << ");\n";
+        }
+        stream << "}\n";
+    }
+    else if (streamed_body) {
+        stream << getTestOffset() << "{\n";
+        std::rewind(streamed_body.get());
+        char buf[4096];
+        size_t read_num = 0;
+        while ((read_num =
+                    std::fread(buf, 1, sizeof(buf), streamed_body.get())) != 0)
+            stream.write(buf, static_cast<std::streamsize>(read_num));
+        stream << getTestOffset() << "}\n";
+    }
+    else
+        new_test->emit(ctx, stream, getTestOffset());
 
     if (options.isSYCL()) {
         stream << "            );\n";
@@ -527,49 +765,77 @@ void ProgramGenerator::emitTest(std::shared_ptr<EmitCtx> ctx,
     ctx->setIspcTypes(false);
 }
 
-void ProgramGenerator::emitMain(std::shared_ptr<EmitCtx> ctx,
-                                std::ostream &stream) {
+void ProgramGenerator::emitTestDecl(std::shared_ptr<EmitCtx> ctx,
+                                    std::ostream &stream) {
     Options &options = Options::getInstance();
     if (options.isISPC())
         stream << "extern \"C\" { ";
 
-    stream << "void test(";
-
-    bool emit_any =
-        emitVarFuncParam(ctx, stream, ext_inp_sym_tbl->getVars(), true, false);
-    emitArrayFuncParam(ctx, stream, emit_any, ext_inp_sym_tbl->getArrays(),
-                       true, false, true);
-
+    stream << "void " << prefix << "test(";
+    emitTestParams(ctx, stream, true);
     stream << ");";
     if (options.isISPC())
         stream << " }\n";
-    stream << "\n\n";
-    stream << "int main() {\n";
-    stream << "    init();\n";
-    stream << "    test(";
-
-    emit_any =
-        emitVarFuncParam(ctx, stream, ext_inp_sym_tbl->getVars(), false, false);
-
-    emitArrayFuncParam(ctx, stream, emit_any, ext_inp_sym_tbl->getArrays(),
-                       false, false, false);
+}
 
+void ProgramGenerator::emitTestRun(std::shared_ptr<EmitCtx> ctx,
+                                   std::ostream &stream) {
+    Options &options = Options::getInstance();
+    stream << "    " << prefix << "init();\n";
+    stream << "    " << prefix << "test(";
+    emitTestParams(ctx, stream, false);
     stream << ");\n";
-    stream << "    checksum();\n";
+    stream << "    " << prefix << "checksum();\n";
     stream << "    printf(\"%llu\\n\", seed);\n";
-    if (options.getCheckAlgo() == CheckAlgo::PRECOMPUTE) {
-        stream << "    if (seed != " << hash_seed << "ULL) \n";
+    uint64_t precomputed_hash = 0;
+    if (options.getCheckAlgo() == CheckAlgo::PRECOMPUTE &&
+        getPrecomputedHash(precomputed_hash)) {
+        stream << "    if (seed != " << precomputed_hash << "ULL) \n";
         stream << "        printf(\"ERROR: hash mismatch\\n\");\n";
     }
     if (options.getCheckAlgo() == CheckAlgo::ASSERTS) {
         stream << "    if (value_mismatch) \n";
         stream << "        printf(\"ERROR: value mismatch\\n\");\n";
     }
+}
+
+void ProgramGenerator::emitMain(std::shared_ptr<EmitCtx> ctx,
+                                std::ostream &stream) {
+    Statistics::PhaseTimer timer(GenPhase::EMIT_MAIN);
+    emitTestDecl(ctx, stream);
+    stream << "\n\n";
+    stream << "int main() {\n";
+    emitTestRun(ctx, stream);
     stream << "}\n";
 }
 
-void ProgramGenerator::emit() {
-    Options &options = Options::getInstance();
+std::string ProgramGenerator::getFuncFileName() {
+    Options &options = session->getOptions();
+    if (options.isC())
+        return "func.c";
+    if (options.isISPC())
+        return "func.ispc";
+    return "func.cpp";
+}
+
+std::vector<std::string> ProgramGenerator::getFuncPartFileNames() {
+    Options &options = session->getOptions();
+    std::string ext = getFuncFileName().substr(std::string("func").size());
+    std::vector<std::string> ret;
+    if (options.getTUCount() == 1)
+        return ret;
+    for (size_t i = 1; i <= options.getTUCount(); ++i)
+        ret.push_back("func_" + std::to_string(i) + ext);
+    return ret;
+}
+
+std::string ProgramGenerator::getDriverFileName() {
+    Options &options = session->getOptions();
+    return options.isC() ? "driver.c" : "driver.cpp";
+}
+
+std::shared_ptr<EmitCtx> ProgramGenerator::createEmitCtx() {
+    Options &options = session->getOptions();
     auto emit_ctx = std::make_shared<EmitCtx>();
     // We need to narrow options if we were asked to do so
     if (options.getUniqueAlignSize() &&
@@ -578,49 +844,211 @@ void ProgramGenerator::emit() {
             emit_ctx->getEmitPolicy()->align_size_distr);
         options.setAlignSize(align_size);
     }
+    return emit_ctx;
+}
+
+void ProgramGenerator::emitFuncHeader(std::shared_ptr<EmitCtx> ctx,
+                                      std::ostream &stream) {
+    stream << "/*\n";
+    session->getOptions().dump(stream);
+    Statistics &stats = session->getStatistics();
+    stream << "Estimated dynamic operations: " << stats.getDynOpsNum() << "\n";
+    stream << "Estimated compile cost: " << stats.getCompileCost() << "\n";
+    stream << "*/\n";
+    emitFuncPrologue(ctx, stream);
+}
 
-    std::ofstream out_file;
+void ProgramGenerator::emit(std::ostream &init_stream,
+                            std::ostream &func_stream,
+                            std::ostream &driver_stream) {
+    emit(init_stream, func_stream, {}, driver_stream);
+}
+
+void ProgramGenerator::emit(std::ostream &init_stream,
+                            std::ostream &func_stream,
+                            const std::vector<std::ostream *> &part_streams,
+                            std::ostream &driver_stream) {
+    GenerationSession::Scope session_scope(*session);
+    auto emit_ctx = createEmitCtx();
+
+    if (part_streams.size() != getFuncPartFileNames().size())
+        ERROR("Wrong number of translation units of the test function");
+
+    emitExtDecl(emit_ctx, init_stream);
+    emitTestPartDecl(emit_ctx, init_stream);
+
+    emitFuncHeader(emit_ctx, func_stream);
+    emitTest(emit_ctx, func_stream);
+    if (!part_streams.empty())
+        emitTestParts(emit_ctx, part_streams);
+
+    emitCheckFunc(driver_stream);
+    emitDecl(emit_ctx, driver_stream);
+    emitInit(emit_ctx, driver_stream);
+    emitCheck(emit_ctx, driver_stream);
+    emitMain(emit_ctx, driver_stream);
+}
+
+void ProgramGenerator::emit() {
+    Options &options = session->getOptions();
 
     // TODO: probably won't work on Windows
     std::string out_dir = options.getOutDir() + "/";
 
-    auto open_file = [&out_file, &out_dir](std::string file_name) {
+    auto open_file = [&out_dir](std::ofstream &out_file,
+                                std::string file_name) {
         out_file.open(out_dir + file_name);
         if (!out_file)
             ERROR(std::string("Can't open file ") + file_name);
     };
 
-    open_file("init.h");
-    emitExtDecl(emit_ctx, out_file);
-    out_file.close();
+    std::ofstream init_file, func_file, driver_file;
+    open_file(init_file, "init.h");
+    open_file(func_file, getFuncFileName());
+    open_file(driver_file, getDriverFileName());
+
+    std::vector<std::string> part_file_names = getFuncPartFileNames();
+    std::vector<std::ofstream> part_files(part_file_names.size());
+    std::vector<std::ostream *> part_streams;
+    for (size_t i = 0; i < part_files.size(); ++i) {
+        open_file(part_files.at(i), part_file_names.at(i));
+        part_streams.push_back(&part_files.at(i));
+    }
+    emit(init_file, func_file, part_streams, driver_file);
 
-    std::string func_file_ext, driver_file_ext;
-    if (options.isC()) {
-        func_file_ext = "c";
-        driver_file_ext = "c";
+    if (options.getStatsJSON() || options.getTrackAllocs()) {
+        std::ofstream stats_file;
+        open_file(stats_file, "stats.json");
+        session->getStatistics().dumpJSON(stats_file);
+        stats_file << "\n";
+    }
+
+    if (!options.getTraceFile().empty()) {
+        std::ofstream trace_file;
+        open_file(trace_file, options.getTraceFile());
+        session->getTracer().dumpJSON(trace_file);
     }
-    else if (options.isCXX() || options.isSYCL()) {
-        func_file_ext = "cpp";
-        driver_file_ext = "cpp";
+}
+
+void ProgramGenerator::emitBundleMember(std::ostream &init_stream,
+                                        std::ostream &func_stream,
+                                        std::ostream &driver_stream,
+                                        std::ostream &main_decl_stream,
+                                        std::ostream &main_body_stream,
+                                        bool is_first) {
+    GenerationSession::Scope session_scope(*session);
+    Options &options = session->getOptions();
+    auto emit_ctx = createEmitCtx();
+
+    emitExtDecl(emit_ctx, init_stream);
+
+    // The header has only the seed of the first test, so each test records
+    // its own seed to be reproducible on its own
+    std::string seed_comment =
+        "/* Seed of the test: " + std::to_string(options.getSeed()) + " */\n";
+
+    if (is_first)
+        emitFuncHeader(emit_ctx, func_stream);
+    func_stream << seed_comment;
+    emitTest(emit_ctx, func_stream);
+
+    if (is_first)
+        emitCheckFunc(driver_stream);
+    driver_stream << seed_comment;
+    emitDecl(emit_ctx, driver_stream);
+    emitInit(emit_ctx, driver_stream);
+    emitCheck(emit_ctx, driver_stream);
+
+    emitTestDecl(emit_ctx, main_decl_stream);
+    main_decl_stream << "\n";
+
+    // The tests share the checksum
+    main_body_stream << "    seed = 0;\n";
+    if (options.getCheckAlgo() == CheckAlgo::ASSERTS)
+        main_body_stream << "    value_mismatch = "
+                         << (options.isC() ? "0" : "false") << ";\n";
+    emitTestRun(emit_ctx, main_body_stream);
+}
+
+BundleGenerator::BundleGenerator(const Options &options, std::ostream &log) {
+    Options bundle_options(options);
+    assert(bundle_options.getTUCount() == 1 &&
+           "Bundle of tests can't be split into several translation units");
+
+    bool stats_json =
+        bundle_options.getStatsJSON() || bundle_options.getTrackAllocs();
+    bool is_first_event = true;
+    // The tests use consecutive seeds. If the seed wasn't specified, the first
+    // test chooses it.
+    uint64_t first_seed = bundle_options.getSeed();
+    for (size_t i = 0; i < bundle_options.getBundleSize(); ++i) {
+        Options prog_options(bundle_options);
+        if (i != 0)
+            prog_options.setSeed(first_seed + i);
+        auto session = std::make_shared<GenerationSession>(prog_options, log);
+        if (i == 0)
+            first_seed = session->getOptions().getSeed();
+        // Each test of the bundle gets its own set of symbols
+        session->getNameHandler().setPrefix("t" + std::to_string(i + 1) + "_");
+
+        // Tests are emitted right away, so only one of them is alive at a time
+        ProgramGenerator program(session);
+        if (i == 0) {
+            func_file_name = program.getFuncFileName();
+            driver_file_name = program.getDriverFileName();
+        }
+        program.emitBundleMember(init_ss, func_ss, driver_ss, main_decl_ss,
+                                 main_body_ss, i == 0);
+        if (stats_json) {
+            stats_ss << (i == 0 ? "[\n" : ",\n");
+            session->getStatistics().dumpJSON(stats_ss);
+        }
+        is_first_event =
+            session->getTracer().dumpEvents(trace_ss, i + 1, is_first_event);
     }
-    else if (options.isISPC()) {
-        func_file_ext = "ispc";
-        driver_file_ext = "cpp";
+    if (stats_json)
+        stats_ss << "\n]\n";
+    if (!bundle_options.getTraceFile().empty())
+        trace_file_name = bundle_options.getTraceFile();
+}
+
+void BundleGenerator::emit(std::ostream &init_stream, std::ostream &func_stream,
+                           std::ostream &driver_stream) {
+    init_stream << init_ss.str();
+    func_stream << func_ss.str();
+    driver_stream << driver_ss.str();
+    driver_stream << main_decl_ss.str();
+    driver_stream << "\n";
+    driver_stream << "int main() {\n";
+    driver_stream << main_body_ss.str();
+    driver_stream << "}\n";
+}
+
+void BundleGenerator::emit(const std::string &out_dir) {
+    auto open_file = [&out_dir](std::ofstream &out_file,
+                                std::string file_name) {
+        out_file.open(out_dir + "/" + file_name);
+        if (!out_file)
+            ERROR(std::string("Can't open file ") + file_name);
+    };
+
+    std::ofstream init_file, func_file, driver_file;
+    open_file(init_file, "init.h");
+    open_file(func_file, func_file_name);
+    open_file(driver_file, driver_file_name);
+    emit(init_file, func_file, driver_file);
+
+    if (!stats_ss.str().empty()) {
+        std::ofstream stats_file;
+        open_file(stats_file, "stats.json");
+        stats_file << stats_ss.str();
     }
-    open_file("func." + func_file_ext);
-    out_file << "/*\n";
-    options.dump(out_file);
-    out_file << "*/\n";
-    emitTest(emit_ctx, out_file);
-    out_file.close();
 
-    open_file("driver." + driver_file_ext);
-    emitCheckFunc(out_file);
-    emitDecl(emit_ctx, out_file);
-    emitInit(emit_ctx, out_file);
-    emitCheck(emit_ctx, out_file);
-    emitMain(emit_ctx, out_file);
-    out_file.close();
+    if (!trace_file_name.empty()) {
+        std::ofstream trace_file;
+        open_file(trace_file, trace_file_name);
+        trace_file << "{\"traceEvents\": [\n" << trace_ss.str() << "\n]}\n";
+    }
 }
 
 void ProgramGenerator::hash(unsigned long long int const v) {
@@ -629,43 +1057,346 @@ void ProgramGenerator::hash(unsigned long long int const v) {
     hash_seed ^= v + 0x9e3779b9 + (hash_seed << 6) + (hash_seed >> 2);
 }
 
-void ProgramGenerator::hashArray(std::shared_ptr<Array> const &arr) {
-    assert(arr->getType()->isArrayType() && "Array should have array type");
+size_t ProgramGenerator::getArrayElemsNum(const std::shared_ptr<Array> &arr) {
     auto arr_type = std::static_pointer_cast<ArrayType>(arr->getType());
-    std::vector<size_t> idx_vec(arr_type->getDimensions().size(), 0);
     auto &dims = arr_type->getDimensions();
-    // TODO: this is broken now
-    uint64_t init_val =
-        arr->getInitValues(Options::main_val_idx).getAbsValue().value;
-    uint64_t cur_val =
-        arr->getCurrentValues(Options::main_val_idx).getAbsValue().value;
-    std::vector<size_t> steps = {};
-    hashArrayStep(arr, dims, idx_vec, 0, false, init_val, cur_val, steps);
-}
-
-void ProgramGenerator::hashArrayStep(std::shared_ptr<Array> const &arr,
-                                     std::vector<size_t> &dims,
-                                     std::vector<size_t> &idx_vec,
-                                     size_t cur_idx, bool has_to_use_init_val,
-                                     uint64_t &init_val, uint64_t &cur_val,
-                                     std::vector<size_t> &steps) {
-    size_t vec_last_idx = idx_vec.size() - 1;
-    // TODO: this is also broken
-    size_t cur_val_size = 0;
-    size_t cur_dim = dims[cur_idx];
-    size_t cur_step = steps[cur_idx];
-
-    for (size_t i = 0; i < cur_dim; ++i) {
-        has_to_use_init_val |= (i >= cur_val_size);
-        if (cur_idx != vec_last_idx) {
-            idx_vec[cur_idx] = i;
-            hashArrayStep(arr, dims, idx_vec, cur_idx + 1,
-                          has_to_use_init_val || (i % cur_step != 0), init_val,
-                          cur_val, steps);
+    return std::accumulate(dims.begin(), dims.end(), static_cast<size_t>(1),
+                           std::multiplies<size_t>());
+}
+
+bool ProgramGenerator::getPrecomputedHash(uint64_t &precomputed_hash) {
+    Options &options = session->getOptions();
+    if (options.getCheckAlgo() != CheckAlgo::PRECOMPUTE &&
+        options.getCheckAlgo() != CheckAlgo::TREE_HASH)
+        return false;
+
+    // The arrays can be huge, so it is computed only on demand
+    GenerationSession::Scope session_scope(*session);
+    hash_seed = 0;
+    for (auto &var : ext_out_sym_tbl->getVars())
+        hash(var->getCurrentValue().getAbsValue().value);
+    for (auto &array : ext_out_sym_tbl->getArrays()) {
+        uint64_t array_hash = 0;
+        bool is_known = options.getCheckAlgo() == CheckAlgo::TREE_HASH
+                            ? hashArrayTree(array, array_hash)
+                            : hashArray(array, array_hash);
+        if (!is_known)
+            return false;
+        hash(array_hash);
+    }
+    precomputed_hash = hash_seed;
+    return true;
+}
+
+static int64_t evalIntExpr(const std::shared_ptr<Expr> &expr) {
+    EvalCtx eval_ctx;
+    auto eval_res = expr->evaluate(eval_ctx);
+    assert(eval_res->isScalarVar() && "Expression should have a scalar value");
+    auto abs_val = std::static_pointer_cast<ScalarVar>(eval_res)
+                       ->getCurrentValue()
+                       .getAbsValue();
+    return static_cast<int64_t>(abs_val.value) * (abs_val.isNegative ? -1 : 1);
+}
+
+// Finds the iterator that the index expression of a subscript depends on
+// (nullptr if the index is a constant). Returns false if the index can't be
+// precomputed.
+static bool getSubsIdxIter(const std::shared_ptr<Expr> &expr,
+                           std::shared_ptr<Iterator> &iter) {
+    if (expr->getKind() == IRNodeKind::CONST) {
+        iter = nullptr;
+        return true;
+    }
+    if (expr->getKind() == IRNodeKind::ITER_USE) {
+        iter = std::static_pointer_cast<Iterator>(expr->getValue());
+        return true;
+    }
+    if (expr->getKind() == IRNodeKind::BINARY) {
+        auto bin_expr = std::static_pointer_cast<BinaryExpr>(expr);
+        if (bin_expr->getOp() == BinaryOp::MOD &&
+            bin_expr->getRHS()->getKind() == IRNodeKind::CONST)
+            return getSubsIdxIter(bin_expr->getLHS(), iter);
+    }
+    return false;
+}
+
+// Value of the index expression of a subscript (see getSubsIdxIter) for the
+// given value of the iterator
+static int64_t evalSubsIdx(const std::shared_ptr<Expr> &expr,
+                           int64_t iter_val) {
+    if (expr->getKind() == IRNodeKind::CONST)
+        return evalIntExpr(expr);
+    if (expr->getKind() == IRNodeKind::ITER_USE)
+        return iter_val;
+    auto bin_expr = std::static_pointer_cast<BinaryExpr>(expr);
+    return evalSubsIdx(bin_expr->getLHS(), iter_val) %
+           evalIntExpr(bin_expr->getRHS());
+}
+
+std::vector<ProgramGenerator::ElemsFactor>
+ProgramGenerator::getAllElems(const std::shared_ptr<Array> &arr) {
+    auto arr_type = std::static_pointer_cast<ArrayType>(arr->getType());
+    auto &dims = arr_type->getDimensions();
+    std::vector<ElemsFactor> factors;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        ElemsFactor factor;
+        factor.dims.push_back(i);
+        for (size_t idx = 0; idx < dims.at(i); ++idx)
+            factor.elems.push_back({idx * getArrayStride(arr, i), idx});
+        factors.push_back(std::move(factor));
+    }
+    return factors;
+}
+
+bool ProgramGenerator::getWrittenElems(const std::shared_ptr<Array> &arr,
+                                       std::vector<ElemsFactor> &factors) {
+    auto arr_type = std::static_pointer_cast<ArrayType>(arr->getType());
+    auto &dims = arr_type->getDimensions();
+    auto subs = arr->getWriteSubs();
+    factors.clear();
+    // Nothing is written, so the product is empty
+    if (!subs) {
+        factors.push_back(ElemsFactor());
+        return true;
+    }
+
+    // The subscripts with the same iterator change together, so they form a
+    // single factor. Each of the subscripts with a constant index is a factor
+    // on its own.
+    std::vector<std::pair<std::shared_ptr<Iterator>,
+                          std::vector<std::shared_ptr<SubscriptExpr>>>>
+        iter_subs;
+    std::shared_ptr<Expr> cur_expr = subs;
+    while (cur_expr->getKind() == IRNodeKind::SUBSCRIPT) {
+        auto cur_subs = std::static_pointer_cast<SubscriptExpr>(cur_expr);
+        cur_expr = cur_subs->getArray();
+        std::shared_ptr<Iterator> iter;
+        if (!getSubsIdxIter(cur_subs->getIdx(), iter))
+            return false;
+        auto find_res = std::find_if(
+            iter_subs.begin(), iter_subs.end(), [&iter](const auto &elem) {
+                return iter != nullptr && elem.first == iter;
+            });
+        if (find_res == iter_subs.end())
+            iter_subs.push_back({iter, {cur_subs}});
+        else
+            find_res->second.push_back(cur_subs);
+    }
+
+    for (auto &[iter, iter_subs_exprs] : iter_subs) {
+        std::vector<int64_t> iter_vals = {0};
+        if (iter) {
+            iter_vals.clear();
+            int64_t start = evalIntExpr(iter->getStart());
+            int64_t end = evalIntExpr(iter->getEnd());
+            int64_t step = evalIntExpr(iter->getStep());
+            if (step <= 0)
+                return false;
+            for (int64_t iter_val = start; iter_val < end; iter_val += step)
+                iter_vals.push_back(iter_val);
         }
-        else {
-            hash(has_to_use_init_val || (i % cur_step != 0) ? init_val
-                                                            : cur_val);
+
+        ElemsFactor factor;
+        for (auto &subs_expr : iter_subs_exprs)
+            factor.dims.push_back(subs_expr->getActiveDim());
+        for (auto iter_val : iter_vals) {
+            ElemsFactor::Elem elem{0, 0};
+            for (auto &subs_expr : iter_subs_exprs) {
+                size_t dim = subs_expr->getActiveDim();
+                int64_t idx = evalSubsIdx(subs_expr->getIdx(), iter_val) +
+                              subs_expr->getOffset();
+                if (idx < 0 || idx >= static_cast<int64_t>(dims.at(dim)))
+                    return false;
+                elem.offset += idx * getArrayStride(arr, dim);
+                if (static_cast<int64_t>(dim) == arr->getMulValsAxisIdx())
+                    elem.axis_idx = idx;
+            }
+            factor.elems.push_back(elem);
         }
+        // Different values of the iterator can access the same element
+        std::sort(
+            factor.elems.begin(), factor.elems.end(),
+            [](const auto &a, const auto &b) { return a.offset < b.offset; });
+        factor.elems.erase(std::unique(factor.elems.begin(), factor.elems.end(),
+                                       [](const auto &a, const auto &b) {
+                                           return a.offset == b.offset;
+                                       }),
+                           factor.elems.end());
+        factors.push_back(std::move(factor));
     }
+    return true;
+}
+
+size_t ProgramGenerator::getArrayStride(const std::shared_ptr<Array> &arr,
+                                        size_t dim) {
+    auto arr_type = std::static_pointer_cast<ArrayType>(arr->getType());
+    auto &dims = arr_type->getDimensions();
+    return std::accumulate(dims.begin() + dim + 1, dims.end(),
+                           static_cast<size_t>(1), std::multiplies<size_t>());
+}
+
+static size_t getValsIdx(size_t axis_idx) {
+    return axis_idx % Options::vals_number == Options::main_val_idx
+               ? Options::main_val_idx
+               : Options::alt_val_idx;
+}
+
+void ProgramGenerator::sumElems(
+    const std::shared_ptr<Array> &arr, const std::vector<ElemsFactor> &factors,
+    std::array<uint64_t, Options::vals_number> &elems_num,
+    std::array<uint64_t, Options::vals_number> &offsets_sum) {
+    // The factors are folded one by one. The elements are split by the
+    // value that they hold, which is defined by the factor with the axis with
+    // multiple values (or it is always the main value).
+    elems_num.fill(0);
+    offsets_sum.fill(0);
+    elems_num.at(Options::main_val_idx) = 1;
+    int64_t axis_idx = arr->getMulValsAxisIdx();
+    for (auto &factor : factors) {
+        bool has_axis = std::find(factor.dims.begin(), factor.dims.end(),
+                                  axis_idx) != factor.dims.end();
+        std::array<uint64_t, Options::vals_number> factor_elems_num{};
+        std::array<uint64_t, Options::vals_number> factor_offsets_sum{};
+        for (auto &elem : factor.elems) {
+            size_t vals_idx =
+                has_axis ? getValsIdx(elem.axis_idx) : Options::main_val_idx;
+            factor_elems_num.at(vals_idx)++;
+            factor_offsets_sum.at(vals_idx) += elem.offset;
+        }
+
+        if (!has_axis) {
+            for (size_t i = 0; i < Options::vals_number; ++i) {
+                offsets_sum.at(i) =
+                    offsets_sum.at(i) *
+                        factor_elems_num.at(Options::main_val_idx) +
+                    elems_num.at(i) *
+                        factor_offsets_sum.at(Options::main_val_idx);
+                elems_num.at(i) *= factor_elems_num.at(Options::main_val_idx);
+            }
+            continue;
+        }
+
+        uint64_t total_elems_num =
+            std::accumulate(elems_num.begin(), elems_num.end(), uint64_t(0));
+        uint64_t total_offsets_sum = std::accumulate(
+            offsets_sum.begin(), offsets_sum.end(), uint64_t(0));
+        for (size_t i = 0; i < Options::vals_number; ++i) {
+            offsets_sum.at(i) = total_offsets_sum * factor_elems_num.at(i) +
+                                total_elems_num * factor_offsets_sum.at(i);
+            elems_num.at(i) = total_elems_num * factor_elems_num.at(i);
+        }
+    }
+}
+
+bool ProgramGenerator::hashArray(const std::shared_ptr<Array> &arr,
+                                 uint64_t &res) {
+    // This function has to mirror emitArrayWeightedSum. The array holds at
+    // most four distinct values, so the sum is computed from the number of
+    // the elements that hold each of them and the sum of their offsets.
+    std::vector<ElemsFactor> written_factors;
+    if (!getWrittenElems(arr, written_factors))
+        return false;
+    std::array<uint64_t, Options::vals_number> all_num, all_sum;
+    std::array<uint64_t, Options::vals_number> written_num, written_sum;
+    sumElems(arr, getAllElems(arr), all_num, all_sum);
+    sumElems(arr, written_factors, written_num, written_sum);
+
+    auto elem_hash = [](IRValue val) -> uint64_t {
+        return val.getAbsValue().value + 0x9e3779b9;
+    };
+    res = 0;
+    for (auto vals_idx : {Options::main_val_idx, Options::alt_val_idx}) {
+        bool use_main_vals = vals_idx == Options::main_val_idx;
+        // The weight of the element is its offset plus one
+        uint64_t written_weight =
+            written_sum.at(vals_idx) + written_num.at(vals_idx);
+        uint64_t all_weight = all_sum.at(vals_idx) + all_num.at(vals_idx);
+        res += elem_hash(arr->getCurrentValues(use_main_vals)) * written_weight;
+        res += elem_hash(arr->getInitValues(use_main_vals)) *
+               (all_weight - written_weight);
+    }
+    return true;
+}
+
+bool ProgramGenerator::hashArrayTree(const std::shared_ptr<Array> &arr,
+                                     uint64_t &res) {
+    // This function has to mirror emitArrayTreeHash and hash_tree from the
+    // driver
+    auto hash_step = [](uint64_t &seed, uint64_t v) {
+        seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
+
+    auto arr_type = std::static_pointer_cast<ArrayType>(arr->getType());
+    auto &dims = arr_type->getDimensions();
+    std::vector<ElemsFactor> factors;
+    if (!getWrittenElems(arr, factors))
+        return false;
+    std::vector<size_t> strides(dims.size());
+    for (size_t i = 0; i < dims.size(); ++i)
+        strides.at(i) = getArrayStride(arr, i);
+    std::vector<size_t> dim_factor(dims.size(), 0);
+    for (size_t i = 0; i < factors.size(); ++i)
+        for (auto dim : factors.at(i).dims)
+            dim_factor.at(dim) = i;
+
+    std::array<uint64_t, Options::vals_number> init_vals;
+    std::array<uint64_t, Options::vals_number> cur_vals;
+    for (auto vals_idx : {Options::main_val_idx, Options::alt_val_idx}) {
+        bool use_main_vals = vals_idx == Options::main_val_idx;
+        init_vals.at(vals_idx) =
+            arr->getInitValues(use_main_vals).getAbsValue().value;
+        cur_vals.at(vals_idx) =
+            arr->getCurrentValues(use_main_vals).getAbsValue().value;
+    }
+
+    // The elements are visited in the row-major order. The element is written
+    // if its offset within each of the factors is a part of the factor.
+    std::vector<size_t> idxs(dims.size(), 0);
+    std::vector<size_t> factor_offsets(factors.size(), 0);
+    auto is_in_factor = [&factors, &factor_offsets](size_t i) {
+        auto &elems = factors.at(i).elems;
+        return std::binary_search(
+            elems.begin(), elems.end(),
+            ElemsFactor::Elem{factor_offsets.at(i), 0},
+            [](const auto &a, const auto &b) { return a.offset < b.offset; });
+    };
+    std::vector<bool> in_factor(factors.size());
+    size_t out_factors_num = 0;
+    for (size_t i = 0; i < factors.size(); ++i) {
+        in_factor.at(i) = is_in_factor(i);
+        out_factors_num += !in_factor.at(i);
+    }
+
+    int64_t axis_idx = arr->getMulValsAxisIdx();
+    std::array<uint64_t, tree_hash_lanes_num> lanes{};
+    size_t lane_idx = 0;
+    size_t elems_num = getArrayElemsNum(arr);
+    for (size_t elem = 0; elem < elems_num; ++elem) {
+        size_t vals_idx = axis_idx == -1 ? Options::main_val_idx
+                                         : getValsIdx(idxs.at(axis_idx));
+        hash_step(lanes[lane_idx], out_factors_num == 0 ? cur_vals[vals_idx]
+                                                        : init_vals[vals_idx]);
+        lane_idx = lane_idx + 1 == tree_hash_lanes_num ? 0 : lane_idx + 1;
+
+        // Move to the next element and update the factors that it changes
+        for (size_t dim = dims.size(); dim > 0; --dim) {
+            size_t factor_idx = dim_factor.at(dim - 1);
+            size_t stride = strides.at(dim - 1);
+            factor_offsets.at(factor_idx) -= idxs.at(dim - 1) * stride;
+            idxs.at(dim - 1) = (idxs.at(dim - 1) + 1) % dims.at(dim - 1);
+            factor_offsets.at(factor_idx) += idxs.at(dim - 1) * stride;
+            bool new_in_factor = is_in_factor(factor_idx);
+            out_factors_num += in_factor.at(factor_idx) && !new_in_factor;
+            out_factors_num -= !in_factor.at(factor_idx) && new_in_factor;
+            in_factor.at(factor_idx) = new_in_factor;
+            if (idxs.at(dim - 1) != 0)
+                break;
+        }
+    }
+
+    for (size_t width = tree_hash_lanes_num / 2; width > 0; width /= 2)
+        for (size_t i = 0; i < width; ++i)
+            hash_step(lanes[i], lanes[i + width]);
+    res = lanes[0];
+    return true;
 }
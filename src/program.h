@@ -16,38 +16,169 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include "session.h"
 #include "stmt.h"
 
+#include <array>
+#include <cstdio>
+#include <iostream>
 #include <memory>
+#include <sstream>
+#include <vector>
 
 namespace yarpgen {
 
 class ProgramGenerator {
   public:
+    // Creates a new generation session with a copy of the current options
     ProgramGenerator();
+    explicit ProgramGenerator(std::shared_ptr<GenerationSession> _session);
+    // Emits init.h, func.* and driver.* to the output directory
     void emit();
+    // Emits the same files to the given streams. It can be used only if the
+    // test function is emitted as a single translation unit.
+    void emit(std::ostream &init_stream, std::ostream &func_stream,
+              std::ostream &driver_stream);
+    // The same, but the test function is split into the translation units
+    // that are named by getFuncPartFileNames()
+    void emit(std::ostream &init_stream, std::ostream &func_stream,
+              const std::vector<std::ostream *> &part_streams,
+              std::ostream &driver_stream);
+    std::string getFuncFileName();
+    // Files with the parts of the test function if it is split into
+    // several translation units (the function itself stays in func.*)
+    std::vector<std::string> getFuncPartFileNames();
+    std::string getDriverFileName();
+
+    std::shared_ptr<GenerationSession> getSession() { return session; }
+    // The checksum that the test is expected to print if CheckAlgo::PRECOMPUTE
+    // or CheckAlgo::TREE_HASH is used. It is computed on demand. Returns false
+    // if the checksum is unknown, i.e. the writes to some of the output arrays
+    // don't fit the model of the precomputation.
+    bool getPrecomputedHash(uint64_t &precomputed_hash);
+
+    // The tree-structured checksum of an array distributes its elements
+    // between the lanes round-robin, hashes each lane separately and then
+    // combines the lanes pairwise
+    static constexpr size_t tree_hash_lanes_num = 8;
+    // The values that the checksums of the output array pass to hash() (see
+    // emitArrayWeightedSum and emitArrayTreeHash). They return false if the
+    // elements that the test writes can't be determined.
+    static bool hashArray(const std::shared_ptr<Array> &arr, uint64_t &res);
+    static bool hashArrayTree(const std::shared_ptr<Array> &arr, uint64_t &res);
 
   private:
+    friend class BundleGenerator;
+
+    // Populates the test and emits the body of the test function statement by
+    // statement into a temporary file
+    void populateAndStreamTest(std::shared_ptr<PopulateCtx> ctx);
+    std::string getTestOffset();
+
+    std::shared_ptr<EmitCtx> createEmitCtx();
+    void emitFuncHeader(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    // Emits the test as a member of a bundle. The first member also emits
+    // the parts of the files that are shared by the whole bundle.
+    void emitBundleMember(std::ostream &init_stream, std::ostream &func_stream,
+                          std::ostream &driver_stream,
+                          std::ostream &main_decl_stream,
+                          std::ostream &main_body_stream, bool is_first);
+
     void emitCheckFunc(std::ostream &stream);
     void emitDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
     void emitInit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
     void emitCheck(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitArrayTreeHash(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
+                           const std::shared_ptr<Array> &array);
+    void emitArrayWeightedSum(std::shared_ptr<EmitCtx> ctx,
+                              std::ostream &stream,
+                              const std::shared_ptr<Array> &array);
     void emitExtDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitFuncPrologue(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitTestParams(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
+                        bool emit_type);
+    std::string getTestPartName(size_t idx);
+    void emitTestPartDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitTestParts(std::shared_ptr<EmitCtx> ctx,
+                       const std::vector<std::ostream *> &part_streams);
     void emitTest(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitTestDecl(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
+    void emitTestRun(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
     void emitMain(std::shared_ptr<EmitCtx> ctx, std::ostream &stream);
 
+    // All of the generation state lives here, so different programs can be
+    // generated concurrently
+    std::shared_ptr<GenerationSession> session;
+    // Prefix of the global symbols of the test (see BundleGenerator)
+    std::string prefix;
+
     std::shared_ptr<SymbolTable> ext_inp_sym_tbl;
     std::shared_ptr<SymbolTable> ext_out_sym_tbl;
     std::shared_ptr<ScopeStmt> new_test;
+    // Body of the test function if it was emitted during the population
+    std::shared_ptr<std::FILE> streamed_body;
 
     unsigned long long int hash_seed;
+
     void hash(unsigned long long int const v);
-    void hashArray(std::shared_ptr<Array> const &arr);
-    void hashArrayStep(std::shared_ptr<Array> const &arr,
-                       std::vector<size_t> &dims, std::vector<size_t> &idx_vec,
-                       size_t cur_idx, bool has_to_use_init_val,
-                       uint64_t &init_val, uint64_t &cur_val,
-                       std::vector<size_t> &steps);
+    static size_t getArrayElemsNum(const std::shared_ptr<Array> &arr);
+    static size_t getArrayStride(const std::shared_ptr<Array> &arr, size_t dim);
+
+    // Set of the elements of an array, which is described as a product of the
+    // sets of the offsets (factors). Each factor covers the dimensions whose
+    // indices change together.
+    struct ElemsFactor {
+        struct Elem {
+            size_t offset;
+            // Index along the axis with multiple values (if it is covered)
+            size_t axis_idx;
+        };
+        std::vector<size_t> dims;
+        // Sorted by the offset
+        std::vector<Elem> elems;
+    };
+    static std::vector<ElemsFactor>
+    getAllElems(const std::shared_ptr<Array> &arr);
+    // The elements of the output array that are written by the test. Returns
+    // false if the subscripts of the write don't fit the model.
+    static bool getWrittenElems(const std::shared_ptr<Array> &arr,
+                                std::vector<ElemsFactor> &factors);
+    // Number of the elements in the set and the sum of their offsets, split
+    // by the value (main or alternative) that they hold
+    static void
+    sumElems(const std::shared_ptr<Array> &arr,
+             const std::vector<ElemsFactor> &factors,
+             std::array<uint64_t, Options::vals_number> &elems_num,
+             std::array<uint64_t, Options::vals_number> &offsets_sum);
+};
+
+// Generates several independent tests and emits them to the same set of
+// files. The symbols of each test get a distinct prefix (t1_, t2_, ...), and
+// the driver runs the tests one by one and prints a checksum for each of
+// them. The tests use the consecutive seeds, starting from the given one.
+class BundleGenerator {
+  public:
+    explicit BundleGenerator(const Options &options,
+                             std::ostream &log = std::cout);
+    // Emits init.h, func.* and driver.* to the given directory
+    void emit(const std::string &out_dir);
+    void emit(std::ostream &init_stream, std::ostream &func_stream,
+              std::ostream &driver_stream);
+
+  private:
+    std::string func_file_name;
+    std::string driver_file_name;
+    std::string trace_file_name;
+
+    std::stringstream init_ss;
+    std::stringstream func_ss;
+    std::stringstream driver_ss;
+    std::stringstream main_decl_ss;
+    std::stringstream main_body_ss;
+    // JSON array with the statistics of the tests (if it was requested)
+    std::stringstream stats_ss;
+    // Events of the traces of the tests (each test is a separate process)
+    std::stringstream trace_ss;
 };
 
 } // namespace yarpgen
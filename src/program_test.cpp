@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2020, Intel Corporation
+Copyright (c) 2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "data.h"
+#include "expr.h"
+#include "program.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace yarpgen;
+
+// Index of a subscript of the array that is written by the test
+struct SubsDescr {
+    // Index of the iterator or -1 if the index is a constant
+    int64_t iter_idx;
+    // Value of the constant index
+    int64_t const_val;
+    // The index is taken modulo this value (zero means no modulo)
+    int64_t mod;
+    int64_t offset;
+};
+
+struct IterDescr {
+    int64_t start;
+    int64_t end;
+    int64_t step;
+};
+
+struct ArrayDescr {
+    std::string name;
+    IntTypeID type_id;
+    std::vector<size_t> dims;
+    int64_t mul_vals_axis_idx;
+    std::vector<IterDescr> iters;
+    // The array is not written if it is empty
+    std::vector<SubsDescr> subs;
+};
+
+static std::vector<ArrayDescr> getArrayDescrs() {
+    auto iter = [](int64_t iter_idx, int64_t offset = 0) {
+        return SubsDescr{iter_idx, 0, 0, offset};
+    };
+    auto const_idx = [](int64_t val, int64_t mod = 0) {
+        return SubsDescr{-1, val, mod, 0};
+    };
+
+    return {
+        {"single", IntTypeID::INT, {1}, -1, {}, {const_idx(0)}},
+        {"not_written", IntTypeID::INT, {13}, -1, {}, {}},
+        {"partial", IntTypeID::UCHAR, {13}, -1, {{2, 11, 3}}, {iter(0)}},
+        {"offset", IntTypeID::LLONG, {21}, -1, {{1, 20, 1}}, {iter(0, -1)}},
+        {"full_mul_vals",
+         IntTypeID::INT,
+         {4, 8},
+         0,
+         {{0, 4, 1}, {0, 8, 1}},
+         {iter(0), iter(1)}},
+        {"partial_mul_vals",
+         IntTypeID::SHORT,
+         {5, 7},
+         1,
+         {{1, 4, 1}, {0, 7, 2}},
+         {iter(0), iter(1)}},
+        {"const_mul_vals",
+         IntTypeID::ULLONG,
+         {3, 5},
+         1,
+         {{0, 3, 1}},
+         {iter(0), const_idx(3)}},
+        {"diagonal",
+         IntTypeID::INT,
+         {6, 3, 6},
+         0,
+         {{0, 6, 1}, {1, 3, 1}},
+         {iter(0), iter(1), iter(0)}},
+        {"modulo",
+         IntTypeID::UINT,
+         {5, 9},
+         1,
+         {{0, 5, 2}},
+         {iter(0), const_idx(12, 9)}},
+    };
+}
+
+static IRValue createValue(IntTypeID type_id, uint64_t val) {
+    IRValue ret(type_id);
+    ret.setValue(IRValue::AbsValue{false, val});
+    return ret;
+}
+
+static std::shared_ptr<ConstantExpr> createConst(int64_t val) {
+    return std::make_shared<ConstantExpr>(
+        createValue(IntTypeID::INT, static_cast<uint64_t>(val)));
+}
+
+// Output array with distinct initial and final values. If the array has the
+// axis with multiple values, the values alternate along it.
+static std::shared_ptr<Array> createArray(const ArrayDescr &descr) {
+    auto type = IntegralType::init(descr.type_id);
+    auto array_type = ArrayType::init(type, descr.dims);
+    auto array =
+        std::make_shared<Array>(descr.name, array_type, type->getMin());
+    array->setInitValue(type->getMin(), true, descr.mul_vals_axis_idx);
+    array->setInitValue(type->getMax(), false, descr.mul_vals_axis_idx);
+    array->setCurrentValue(createValue(descr.type_id, 7), true);
+    array->setCurrentValue(createValue(descr.type_id, 3), false);
+    if (descr.subs.empty())
+        return array;
+
+    std::vector<std::shared_ptr<Iterator>> iters;
+    for (size_t i = 0; i < descr.iters.size(); ++i) {
+        auto &iter = descr.iters.at(i);
+        iters.push_back(std::make_shared<Iterator>(
+            "i_" + std::to_string(i), IntegralType::init(IntTypeID::INT),
+            createConst(iter.start), 0, createConst(iter.end), 0,
+            createConst(iter.step), false, 0));
+    }
+    std::vector<std::pair<std::shared_ptr<Expr>, int64_t>> subs_exprs;
+    for (auto &subs : descr.subs) {
+        std::shared_ptr<Expr> idx_expr = createConst(subs.const_val);
+        if (subs.iter_idx != -1)
+            idx_expr = std::make_shared<IterUseExpr>(iters.at(subs.iter_idx));
+        if (subs.mod != 0)
+            idx_expr = std::make_shared<BinaryExpr>(BinaryOp::MOD, idx_expr,
+                                                    createConst(subs.mod));
+        subs_exprs.emplace_back(idx_expr, subs.offset);
+    }
+    array->setWriteSubs(SubscriptExpr::init(array, subs_exprs));
+    return array;
+}
+
+// Final values of the elements in the row-major order. The written elements
+// are found by trying every combination of the values of the iterators.
+static std::vector<uint64_t> getFinalVals(const ArrayDescr &descr,
+                                          const std::shared_ptr<Array> &array) {
+    size_t elems_num = std::accumulate(descr.dims.begin(), descr.dims.end(),
+                                       size_t(1), std::multiplies<size_t>());
+    std::set<size_t> written;
+    std::vector<int64_t> iter_vals;
+    for (auto &iter : descr.iters)
+        iter_vals.push_back(iter.start);
+    bool done = descr.subs.empty();
+    while (!done) {
+        size_t offset = 0;
+        for (size_t dim = 0; dim < descr.dims.size(); ++dim) {
+            auto &subs = descr.subs.at(dim);
+            int64_t idx = subs.iter_idx == -1 ? subs.const_val
+                                              : iter_vals.at(subs.iter_idx);
+            if (subs.mod != 0)
+                idx %= subs.mod;
+            offset = offset * descr.dims.at(dim) + idx + subs.offset;
+        }
+        written.insert(offset);
+
+        done = true;
+        for (size_t i = 0; i < iter_vals.size() && done; ++i) {
+            iter_vals.at(i) += descr.iters.at(i).step;
+            done = iter_vals.at(i) >= descr.iters.at(i).end;
+            if (done)
+                iter_vals.at(i) = descr.iters.at(i).start;
+        }
+    }
+
+    std::vector<uint64_t> ret;
+    for (size_t elem = 0; elem < elems_num; ++elem) {
+        bool use_main_vals = true;
+        if (descr.mul_vals_axis_idx != -1) {
+            size_t axis_idx = elem;
+            for (size_t dim = descr.dims.size() - 1;
+                 dim > static_cast<size_t>(descr.mul_vals_axis_idx); --dim)
+                axis_idx /= descr.dims.at(dim);
+            axis_idx %= descr.dims.at(descr.mul_vals_axis_idx);
+            use_main_vals =
+                axis_idx % Options::vals_number == Options::main_val_idx;
+        }
+        IRValue val = written.count(elem)
+                          ? array->getCurrentValues(use_main_vals)
+                          : array->getInitValues(use_main_vals);
+        ret.push_back(val.getAbsValue().value);
+    }
+    return ret;
+}
+
+// The same as emitArrayTreeHash and hash_tree from the driver
+static uint64_t hashTree(const std::vector<uint64_t> &vals) {
+    auto hash_step = [](uint64_t &seed, uint64_t v) {
+        seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
+    std::vector<uint64_t> lanes(ProgramGenerator::tree_hash_lanes_num, 0);
+    for (size_t i = 0; i < vals.size(); ++i)
+        hash_step(lanes.at(i % lanes.size()), vals.at(i));
+    for (size_t width = lanes.size() / 2; width > 0; width /= 2)
+        for (size_t i = 0; i < width; ++i)
+            hash_step(lanes.at(i), lanes.at(i + width));
+    return lanes.at(0);
+}
+
+// The same as emitArrayWeightedSum
+static uint64_t weightedSum(const std::vector<uint64_t> &vals) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < vals.size(); ++i)
+        sum += (vals.at(i) + 0x9e3779b9) * (i + 1);
+    return sum;
+}
+
+static void weightedSumTest() {
+    for (auto &descr : getArrayDescrs()) {
+        auto array = createArray(descr);
+        uint64_t expected = weightedSum(getFinalVals(descr, array));
+        uint64_t result = 0;
+        if (!ProgramGenerator::hashArray(array, result))
+            std::cout << "ERROR: weighted sum of " << descr.name
+                      << " is unknown" << std::endl;
+        else if (expected != result)
+            std::cout << "ERROR: weighted sum of " << descr.name
+                      << ": expected " << expected << ", got " << result
+                      << std::endl;
+    }
+}
+
+static void treeHashTest() {
+    bool has_partial_lanes = false;
+    for (auto &descr : getArrayDescrs()) {
+        auto array = createArray(descr);
+        auto vals = getFinalVals(descr, array);
+        has_partial_lanes |=
+            vals.size() % ProgramGenerator::tree_hash_lanes_num != 0;
+        uint64_t expected = hashTree(vals);
+        uint64_t result = 0;
+        if (!ProgramGenerator::hashArrayTree(array, result))
+            std::cout << "ERROR: tree hash of " << descr.name << " is unknown"
+                      << std::endl;
+        else if (expected != result)
+            std::cout << "ERROR: tree hash of " << descr.name << ": expected "
+                      << expected << ", got " << result << std::endl;
+    }
+    if (!has_partial_lanes)
+        std::cout << "ERROR: no arrays with partially filled lanes"
+                  << std::endl;
+}
+
+// The writes that don't fit the model make the checksum unknown
+static void unknownHashTest() {
+    std::vector<std::shared_ptr<Array>> arrays;
+    arrays.push_back(createArray({"zero_step",
+                                  IntTypeID::INT,
+                                  {13},
+                                  -1,
+                                  {{0, 13, 0}},
+                                  {SubsDescr{0, 0, 0, 0}}}));
+    arrays.push_back(createArray({"out_of_bounds",
+                                  IntTypeID::INT,
+                                  {13},
+                                  -1,
+                                  {{0, 13, 1}},
+                                  {SubsDescr{0, 0, 0, 1}}}));
+
+    // Only the constants and the iterators (possibly modulo a constant) are
+    // supported as the indices
+    auto array = createArray({"add_idx", IntTypeID::INT, {13}, -1, {}, {}});
+    auto idx_expr = std::make_shared<BinaryExpr>(BinaryOp::ADD, createConst(2),
+                                                 createConst(3));
+    array->setWriteSubs(SubscriptExpr::init(array, {{idx_expr, 0}}));
+    arrays.push_back(array);
+
+    for (auto &array : arrays) {
+        std::string name = array->getName(nullptr);
+        uint64_t result = 0;
+        if (ProgramGenerator::hashArray(array, result))
+            std::cout << "ERROR: weighted sum of " << name << " is known"
+                      << std::endl;
+        if (ProgramGenerator::hashArrayTree(array, result))
+            std::cout << "ERROR: tree hash of " << name << " is known"
+                      << std::endl;
+    }
+}
+
+int main() {
+    weightedSumTest();
+    treeHashTest();
+    unknownHashTest();
+}
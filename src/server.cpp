@@ -0,0 +1,498 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "server.h"
+#include "program.h"
+#include "session.h"
+#include "utils.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace yarpgen;
+
+// Minimal JSON value. It is just enough to parse generation requests.
+// We also keep the raw text of each value, so it can be echoed back.
+class JSONValue {
+  public:
+    enum class Kind { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    JSONValue() : kind(Kind::NUL), bool_val(false) {}
+
+    Kind kind;
+    bool bool_val;
+    // Value of a string or text of a number
+    std::string str_val;
+    std::vector<JSONValue> arr_val;
+    std::map<std::string, JSONValue> obj_val;
+    std::string raw;
+};
+
+class JSONParser {
+  public:
+    explicit JSONParser(const std::string &_text) : text(_text), pos(0) {}
+
+    bool parse(JSONValue &val, std::string &err_msg) {
+        if (!parseValue(val) || (skipSpaces(), pos != text.size())) {
+            err_msg = "Malformed JSON at position " + std::to_string(pos);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    void skipSpaces() {
+        while (pos < text.size() && std::isspace(text.at(pos)))
+            ++pos;
+    }
+
+    bool consume(char c) {
+        skipSpaces();
+        if (pos < text.size() && text.at(pos) == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeWord(const std::string &word) {
+        if (text.compare(pos, word.size(), word) != 0)
+            return false;
+        pos += word.size();
+        return true;
+    }
+
+    bool parseValue(JSONValue &val) {
+        skipSpaces();
+        if (pos == text.size())
+            return false;
+        size_t start = pos;
+        bool ok = false;
+        char c = text.at(pos);
+        if (c == '{')
+            ok = parseObject(val);
+        else if (c == '[')
+            ok = parseArray(val);
+        else if (c == '"') {
+            val.kind = JSONValue::Kind::STRING;
+            ok = parseString(val.str_val);
+        }
+        else if (c == 't' || c == 'f') {
+            val.kind = JSONValue::Kind::BOOL;
+            val.bool_val = c == 't';
+            ok = consumeWord(val.bool_val ? "true" : "false");
+        }
+        else if (c == 'n')
+            ok = consumeWord("null");
+        else
+            ok = parseNumber(val);
+        val.raw = text.substr(start, pos - start);
+        return ok;
+    }
+
+    bool parseNumber(JSONValue &val) {
+        size_t start = pos;
+        while (pos < text.size() &&
+               (std::isdigit(text.at(pos)) ||
+                std::strchr("+-.eE", text.at(pos)) != nullptr))
+            ++pos;
+        val.kind = JSONValue::Kind::NUMBER;
+        val.str_val = text.substr(start, pos - start);
+        return pos != start;
+    }
+
+    bool parseString(std::string &str) {
+        if (!consume('"'))
+            return false;
+        while (pos < text.size() && text.at(pos) != '"') {
+            char c = text.at(pos++);
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+            if (pos == text.size())
+                return false;
+            c = text.at(pos++);
+            switch (c) {
+                case 'n':
+                    str += '\n';
+                    break;
+                case 't':
+                    str += '\t';
+                    break;
+                case 'r':
+                    str += '\r';
+                    break;
+                case 'b':
+                    str += '\b';
+                    break;
+                case 'f':
+                    str += '\f';
+                    break;
+                case 'u': {
+                    // We don't expect anything besides ASCII in requests
+                    if (pos + 4 > text.size())
+                        return false;
+                    for (size_t i = pos; i < pos + 4; ++i)
+                        if (!std::isxdigit(
+                                static_cast<unsigned char>(text.at(i))))
+                            return false;
+                    unsigned long code =
+                        std::stoul(text.substr(pos, 4), nullptr, 16);
+                    if (code > 0x7f)
+                        return false;
+                    str += static_cast<char>(code);
+                    pos += 4;
+                    break;
+                }
+                default:
+                    str += c;
+            }
+        }
+        return consume('"');
+    }
+
+    bool parseArray(JSONValue &val) {
+        val.kind = JSONValue::Kind::ARRAY;
+        consume('[');
+        if (consume(']'))
+            return true;
+        do {
+            JSONValue elem;
+            if (!parseValue(elem))
+                return false;
+            val.arr_val.push_back(std::move(elem));
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool parseObject(JSONValue &val) {
+        val.kind = JSONValue::Kind::OBJECT;
+        consume('{');
+        if (consume('}'))
+            return true;
+        do {
+            std::string key;
+            skipSpaces();
+            JSONValue elem;
+            if (!parseString(key) || !consume(':') || !parseValue(elem))
+                return false;
+            val.obj_val[key] = std::move(elem);
+        } while (consume(','));
+        return consume('}');
+    }
+
+    const std::string &text;
+    size_t pos;
+};
+
+static std::string escapeJSON(const std::string &str) {
+    std::stringstream ss;
+    ss << "\"";
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                ss << "\\\"";
+                break;
+            case '\\':
+                ss << "\\\\";
+                break;
+            case '\n':
+                ss << "\\n";
+                break;
+            case '\t':
+                ss << "\\t";
+                break;
+            case '\r':
+                ss << "\\r";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                       << static_cast<int>(c) << std::dec;
+                else
+                    ss << c;
+        }
+    }
+    ss << "\"";
+    return ss.str();
+}
+
+static std::string errorReply(const std::string &id, const std::string &msg) {
+    std::stringstream reply;
+    reply << "{";
+    if (!id.empty())
+        reply << "\"id\": " << id << ", ";
+    reply << "\"error\": " << escapeJSON(msg) << "}";
+    return reply.str();
+}
+
+std::string GenServer::handleRequest(const std::string &request) {
+    auto start_time = std::chrono::steady_clock::now();
+    auto ms_since = [](std::chrono::steady_clock::time_point since) {
+        std::chrono::duration<double, std::milli> duration =
+            std::chrono::steady_clock::now() - since;
+        return duration.count();
+    };
+
+    JSONValue req;
+    std::string err_msg;
+    JSONParser parser(request);
+    if (!parser.parse(req, err_msg))
+        return errorReply("", err_msg);
+    if (req.kind != JSONValue::Kind::OBJECT)
+        return errorReply("", "Request should be a JSON object");
+
+    auto &fields = req.obj_val;
+    std::string id = fields.count("id") ? fields.at("id").raw : "";
+
+    // Everything that changes the options is applied in the command-line form,
+    // so we reuse the checks and actions of OptionParser
+    std::vector<std::string> overrides;
+    if (fields.count("std")) {
+        if (fields.at("std").kind != JSONValue::Kind::STRING)
+            return errorReply(id, "\"std\" should be a string");
+        overrides.push_back("--std=" + fields.at("std").str_val);
+    }
+    if (fields.count("options")) {
+        auto &options_val = fields.at("options");
+        if (options_val.kind != JSONValue::Kind::ARRAY)
+            return errorReply(id, "\"options\" should be an array");
+        for (auto &option : options_val.arr_val) {
+            if (option.kind != JSONValue::Kind::STRING)
+                return errorReply(id, "\"options\" should contain strings");
+            overrides.push_back(option.str_val);
+        }
+    }
+
+    uint64_t seed = 0;
+    if (fields.count("seed")) {
+        auto &seed_val = fields.at("seed");
+        std::stringstream seed_ss(seed_val.str_val);
+        if (seed_val.kind != JSONValue::Kind::NUMBER ||
+            seed_val.raw[0] == '-' || !(seed_ss >> seed) || !seed_ss.eof())
+            return errorReply(id, "\"seed\" should be a non-negative integer");
+    }
+
+    std::string out_dir;
+    if (fields.count("out_dir")) {
+        if (fields.at("out_dir").kind != JSONValue::Kind::STRING)
+            return errorReply(id, "\"out_dir\" should be a string");
+        out_dir = fields.at("out_dir").str_val;
+    }
+    bool return_inline = out_dir.empty();
+    if (fields.count("inline")) {
+        if (fields.at("inline").kind != JSONValue::Kind::BOOL)
+            return errorReply(id, "\"inline\" should be a boolean");
+        return_inline |= fields.at("inline").bool_val;
+    }
+
+    auto options_holder = GenerationSession::createOptionsHolder(base_options);
+    {
+        GenerationSession::Scope options_scope(*options_holder);
+        if (!OptionParser::parseOverrides(overrides, err_msg) ||
+            !OptionParser::validate(err_msg))
+            return errorReply(id, err_msg);
+    }
+    Options &req_options = options_holder->getOptions();
+    req_options.setSeed(seed);
+    if (!out_dir.empty())
+        req_options.setOutDir(out_dir);
+
+    // Seed banners are reported in the reply
+    std::stringstream log;
+    auto session = std::make_shared<GenerationSession>(req_options, log);
+
+    // The invocation that we save in the test should reproduce it
+    std::vector<std::string> invocation = {
+        base_options.getRawOptions().empty()
+            ? "yarpgen"
+            : base_options.getRawOptions().front()};
+    invocation.insert(invocation.end(), overrides.begin(), overrides.end());
+    invocation.push_back("--seed=" +
+                         std::to_string(session->getOptions().getSeed()));
+    if (!out_dir.empty())
+        invocation.push_back("--out-dir=" + out_dir);
+    session->getOptions().setRawOptions(invocation);
+
+    auto gen_start_time = std::chrono::steady_clock::now();
+    ProgramGenerator new_program(session);
+    double gen_time = ms_since(gen_start_time);
+
+    auto emit_start_time = std::chrono::steady_clock::now();
+    std::stringstream init_ss, func_ss, driver_ss;
+    std::vector<std::string> part_file_names =
+        new_program.getFuncPartFileNames();
+    std::vector<std::stringstream> part_ss(part_file_names.size());
+    std::vector<std::ostream *> part_streams;
+    for (auto &ss : part_ss)
+        part_streams.push_back(&ss);
+    new_program.emit(init_ss, func_ss, part_streams, driver_ss);
+    std::vector<std::pair<std::string, std::string>> files = {
+        {"init.h", init_ss.str()},
+        {new_program.getFuncFileName(), func_ss.str()},
+        {new_program.getDriverFileName(), driver_ss.str()}};
+    for (size_t i = 0; i < part_ss.size(); ++i)
+        files.emplace_back(part_file_names.at(i), part_ss.at(i).str());
+
+    if (!out_dir.empty()) {
+        std::error_code err_code;
+        std::filesystem::create_directories(out_dir, err_code);
+        if (err_code)
+            return errorReply(id, "Can't create output directory " + out_dir);
+        for (auto &file : files) {
+            std::ofstream out_file(out_dir + "/" + file.first);
+            out_file << file.second;
+            if (!out_file)
+                return errorReply(id, "Can't write file " + file.first);
+        }
+    }
+    double emit_time = ms_since(emit_start_time);
+
+    std::stringstream reply;
+    reply << "{";
+    if (!id.empty())
+        reply << "\"id\": " << id << ", ";
+    reply << "\"seed\": " << session->getOptions().getSeed() << ", ";
+    reply << "\"log\": " << escapeJSON(log.str()) << ", ";
+    reply << "\"files\": {";
+    for (auto file = files.begin(); file != files.end(); ++file) {
+        reply << (file != files.begin() ? ", " : "");
+        reply << escapeJSON(file->first) << ": ";
+        reply << escapeJSON(return_inline ? file->second
+                                          : out_dir + "/" + file->first);
+    }
+    reply << "}, ";
+    reply << std::fixed << std::setprecision(3);
+    reply << "\"time_ms\": {\"generate\": " << gen_time
+          << ", \"emit\": " << emit_time
+          << ", \"total\": " << ms_since(start_time) << "}}";
+    return reply.str();
+}
+
+void GenServer::serve(std::istream &in, std::ostream &out) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        // Flush after each reply, so the client can pipeline requests
+        out << handleRequest(line) << std::endl;
+    }
+}
+
+#ifndef _WIN32
+static bool writeAll(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t res = write(fd, data.data() + written, data.size() - written);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+        written += static_cast<size_t>(res);
+    }
+    return true;
+}
+
+static void serveConnection(GenServer &server, int conn_fd) {
+    std::string buffer;
+    char chunk[4096];
+    while (true) {
+        ssize_t res = read(conn_fd, chunk, sizeof(chunk));
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            break;
+        buffer.append(chunk, static_cast<size_t>(res));
+
+        size_t line_end = 0;
+        bool conn_alive = true;
+        while (conn_alive &&
+               (line_end = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, line_end);
+            buffer.erase(0, line_end + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            conn_alive = writeAll(conn_fd, server.handleRequest(line) + "\n");
+        }
+        if (!conn_alive)
+            break;
+    }
+    close(conn_fd);
+}
+#endif
+
+void GenServer::serveUnixSocket(const std::string &path) {
+#ifdef _WIN32
+    ERROR("Unix domain sockets are not supported on this platform");
+#else
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        ERROR("Socket path is too long: " + path);
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // Remove a stale socket from the previous run, but nothing else
+    struct stat path_stat = {};
+    if (stat(path.c_str(), &path_stat) == 0) {
+        if (!S_ISSOCK(path_stat.st_mode))
+            ERROR("Path exists and it is not a socket: " + path);
+        unlink(path.c_str());
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0)
+        ERROR("Can't create socket");
+    if (bind(server_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+            0 ||
+        listen(server_fd, SOMAXCONN) < 0)
+        ERROR("Can't listen on socket " + path);
+
+    // Clients might close the connection before they get the reply
+    std::signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int conn_fd = accept(server_fd, nullptr, nullptr);
+        if (conn_fd < 0) {
+            if (errno == EINTR)
+                continue;
+            ERROR("Can't accept connection on socket " + path);
+        }
+        // Each connection is served with its own generation sessions
+        std::thread(serveConnection, std::ref(*this), conn_fd).detach();
+    }
+#endif
+}
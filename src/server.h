@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "options.h"
+
+#include <iostream>
+#include <string>
+
+namespace yarpgen {
+
+// Long-running generation server. It reads generation requests as
+// line-delimited JSON and replies with one JSON object per request.
+//
+// Request (all fields are optional):
+// {"id": <any>, "seed": 42, "std": "c++",
+//  "options": ["--inp-as-args=all", "--unique-align-size"],
+//  "out_dir": "path", "inline": true}
+// If "out_dir" is set, the test is written there (the directory is created
+// if it doesn't exist). Otherwise, or if "inline" is true, the content of the
+// files is returned in the reply.
+//
+// Reply:
+// {"id": <same>, "seed": 42, "log": "/*SEED 42*/\n",
+//  "files": {"init.h": "<path or content>", ...},
+//  "time_ms": {"generate": 1.5, "emit": 0.3, "total": 1.9}}
+// or {"id": <same>, "error": "<message>"} if the request is malformed.
+class GenServer {
+  public:
+    // Requests are applied on top of the base options
+    explicit GenServer(const Options &_base_options)
+        : base_options(_base_options) {}
+
+    // Serves the requests until the end of the input stream
+    void serve(std::istream &in, std::ostream &out);
+    // Listens on a Unix domain socket and serves each connection in a
+    // separate thread. It never returns unless there is an error.
+    void serveUnixSocket(const std::string &path);
+
+    std::string handleRequest(const std::string &request);
+
+  private:
+    Options base_options;
+};
+
+} // namespace yarpgen
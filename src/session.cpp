@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "session.h"
+#include "context.h"
+
+using namespace yarpgen;
+
+thread_local GenerationSession *GenerationSession::current = nullptr;
+
+GenerationSession::GenerationSession(const Options &_options, std::ostream &log)
+    : GenerationSession(_options, true, log) {}
+
+GenerationSession::GenerationSession(const Options &_options,
+                                     bool init_rand_gen, std::ostream &log)
+    : arena(), task_streams_num(0), options(_options),
+      tracer(!options.getTraceFile().empty()), rand_gen(nullptr),
+      default_emit_ctx(std::make_shared<EmitCtx>()), array_type_uid_counter(0) {
+    if (options.getTrackAllocs()) {
+        stats.alloc_stats.enabled = true;
+        arena.setAllocStats(&stats.alloc_stats);
+    }
+
+    if (!init_rand_gen)
+        return;
+
+    rand_gen = std::make_shared<RandValGen>(options.getSeed());
+    options.setSeed(rand_gen->getSeed());
+    log << "/*SEED " << rand_gen->getSeed() << "*/" << std::endl;
+
+    if (options.getMutationKind() == MutationKind::EXPRS ||
+        options.getMutationKind() == MutationKind::ALL) {
+        rand_gen->setMutationSeed(options.getMutationSeed());
+        log << "/*MUTATION_SEED " << rand_gen->getMutationSeed() << "*/"
+            << std::endl;
+    }
+}
+
+GenerationSession &GenerationSession::getDefault() {
+    // Default session doesn't own a random generator
+    static GenerationSession instance(Options(), false, std::cout);
+    return instance;
+}
+
+std::shared_ptr<GenerationSession>
+GenerationSession::createOptionsHolder(const Options &_options) {
+    // std::make_shared can't access the private constructor
+    return std::shared_ptr<GenerationSession>(
+        new GenerationSession(_options, false, std::cout));
+}
+
+std::shared_ptr<GenerationSession> GenerationSession::createTaskSession() {
+    auto ret = std::shared_ptr<GenerationSession>(
+        new GenerationSession(options, false, std::cout));
+    // Random streams are assigned in the order of spawning, so the result
+    // doesn't depend on the scheduling of the tasks
+    ret->rand_gen = rand_gen->split(task_streams_num++);
+
+    // Names are unique only within the task. They are reassigned after all of
+    // the tasks are merged back.
+    ret->name_handler.var_idx = name_handler.var_idx;
+    ret->name_handler.arr_idx = name_handler.arr_idx;
+    ret->name_handler.iter_idx = name_handler.iter_idx;
+    ret->name_handler.stub_stmt_idx = name_handler.stub_stmt_idx;
+    ret->name_handler.prefix = name_handler.prefix;
+
+    // The task has to see the same type objects, because some of them are
+    // compared by pointers
+    ret->int_type_set = int_type_set;
+    ret->array_type_set = array_type_set;
+    ret->array_type_uid_counter = array_type_uid_counter;
+    ret->used_consts = used_consts;
+
+    task_sessions.push_back(ret);
+    return ret;
+}
+
+void GenerationSession::mergeTaskSession(
+    const GenerationSession &task_session) {
+    stats.merge(task_session.stats);
+    tracer.merge(task_session.tracer);
+}
+
+GenerationSession &GenerationSession::getCurrent() {
+    if (current != nullptr)
+        return *current;
+    return getDefault();
+}
+
+GenerationSession::Scope::Scope(GenerationSession &session)
+    : prev_session(current), prev_rand_gen(rand_val_gen) {
+    current = &session;
+    rand_val_gen = session.getRandValGen();
+}
+
+GenerationSession::Scope::~Scope() {
+    current = prev_session;
+    rand_val_gen = prev_rand_gen;
+}
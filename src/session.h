@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "arena.h"
+#include "hash.h"
+#include "options.h"
+#include "statistics.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yarpgen {
+
+class Data;
+class IntegralType;
+class ArrayType;
+class ConstantExpr;
+class ScalarVarUseExpr;
+class ArrayUseExpr;
+class IterUseExpr;
+class EmitCtx;
+
+// GenerationSession owns all of the mutable state that is required to generate
+// a single test program: options, random generator, statistics, name
+// generator, folding sets and caches of the IR.
+// Each session is bound to (at most) one thread at a time, so different
+// programs can be generated concurrently in the same address space.
+class GenerationSession {
+  public:
+    // Creates a new session with a copy of the options. The random generator
+    // is seeded according to them (zero seed means "choose any"). The seeds
+    // that were actually used are reported to the log stream.
+    explicit GenerationSession(const Options &_options,
+                               std::ostream &log = std::cout);
+    GenerationSession(const GenerationSession &) = delete;
+    GenerationSession &operator=(const GenerationSession &) = delete;
+
+    Options &getOptions() { return options; }
+    Statistics &getStatistics() { return stats; }
+    Tracer &getTracer() { return tracer; }
+    NameHandler &getNameHandler() { return name_handler; }
+    std::shared_ptr<RandValGen> getRandValGen() { return rand_gen; }
+    Arena &getArena() { return arena; }
+
+    // This is a hack. EmitPolicy is required to get a name of a variable.
+    // Because we use a name of a variable as a unique ID, we end up creating
+    // a lot of objects that are useless.
+    // TODO: replace UID type of vars to something better
+    std::shared_ptr<EmitCtx> getDefaultEmitCtx() { return default_emit_ctx; }
+
+    using IntTypeSet =
+        std::unordered_map<IntTypeKey, std::shared_ptr<IntegralType>,
+                           IntTypeKeyHasher>;
+    using ArrayTypeSet =
+        std::unordered_map<ArrayTypeKey, std::shared_ptr<ArrayType>,
+                           ArrayTypeKeyHasher>;
+    IntTypeSet &getIntTypeSet() { return int_type_set; }
+    ArrayTypeSet &getArrayTypeSet() { return array_type_set; }
+    size_t getNextArrayTypeUID() { return array_type_uid_counter++; }
+
+    std::vector<std::shared_ptr<ConstantExpr>> &getUsedConsts() {
+        return used_consts;
+    }
+
+    template <typename T>
+    using UseExprSet =
+        std::unordered_map<std::shared_ptr<Data>, std::shared_ptr<T>>;
+    UseExprSet<ScalarVarUseExpr> &getScalarVarUseSet() {
+        return scalar_var_use_set;
+    }
+    UseExprSet<ArrayUseExpr> &getArrayUseSet() { return array_use_set; }
+    UseExprSet<IterUseExpr> &getIterUseSet() { return iter_use_set; }
+
+    // Session that is active on the current thread. If nothing was bound to
+    // the thread, it falls back to the process-wide default session that
+    // keeps command-line options.
+    static GenerationSession &getCurrent();
+    static GenerationSession &getDefault();
+
+    // Session that only holds a copy of the options and doesn't own a random
+    // generator. It can be bound to a thread to modify the options (e.g., with
+    // OptionParser) without touching any other session.
+    static std::shared_ptr<GenerationSession>
+    createOptionsHolder(const Options &_options);
+
+    // Session for a parallel population task (see PopulateTaskGroup). It
+    // starts with a copy of the current state of this session and gets its own
+    // stream of random numbers. This session keeps the task session alive,
+    // because the IR nodes of the task live in its arena.
+    std::shared_ptr<GenerationSession> createTaskSession();
+    // Adds the statistics and the trace of the finished task to this session
+    void mergeTaskSession(const GenerationSession &task_session);
+
+    // RAII helper that binds the session (and its random generator) to the
+    // current thread and restores the previous binding on exit
+    class Scope {
+      public:
+        explicit Scope(GenerationSession &session);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        GenerationSession *prev_session;
+        std::shared_ptr<RandValGen> prev_rand_gen;
+    };
+
+  private:
+    GenerationSession(const Options &_options, bool init_rand_gen,
+                      std::ostream &log);
+
+    static thread_local GenerationSession *current;
+
+    // All of the IR nodes live in the arena, so it has to be destroyed last
+    Arena arena;
+    // IR nodes of this session can reference the nodes of the task sessions
+    // and vice versa, so they have to be destroyed right before the arena
+    std::vector<std::shared_ptr<GenerationSession>> task_sessions;
+    // Random streams that were given away to the task sessions
+    uint64_t task_streams_num;
+    Options options;
+    Statistics stats;
+    Tracer tracer;
+    NameHandler name_handler;
+    std::shared_ptr<RandValGen> rand_gen;
+    std::shared_ptr<EmitCtx> default_emit_ctx;
+
+    // There is a fixed small number of possible integral types,
+    // so we use a folding set in order to save memory
+    IntTypeSet int_type_set;
+    // Folding set for all of the array types.
+    ArrayTypeSet array_type_set;
+    // The easiest way to compare array types is to assign a unique identifier
+    // to each of them and then compare it.
+    size_t array_type_uid_counter;
+
+    std::vector<std::shared_ptr<ConstantExpr>> used_consts;
+    UseExprSet<ScalarVarUseExpr> scalar_var_use_set;
+    UseExprSet<ArrayUseExpr> array_use_set;
+    UseExprSet<IterUseExpr> iter_use_set;
+};
+
+} // namespace yarpgen
@@ -16,5 +16,398 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 
 #include "statistics.h"
+#include "session.h"
+#include "utils.h"
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
 
 using namespace yarpgen;
+
+Statistics &Statistics::getInstance() {
+    return GenerationSession::getCurrent().getStatistics();
+}
+
+static uint64_t getWallTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Each session is bound to a single thread at a time, so we measure the CPU
+// time of the thread instead of the whole process
+static uint64_t getCPUTimeNs() {
+#if defined(_WIN32)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time,
+                        &kernel_time, &user_time))
+        return 0;
+    // FILETIME counts in 100 ns intervals
+    auto to_ns = [](const FILETIME &time) -> uint64_t {
+        return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) |
+                time.dwLowDateTime) *
+               100;
+    };
+    return to_ns(kernel_time) + to_ns(user_time);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    // The CPU time of the whole process is the best that we have here
+    return static_cast<uint64_t>(std::clock()) * 1000000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+void Statistics::merge(const Statistics &other) {
+    stmt_num += other.stmt_num;
+    dyn_ops_num += other.dyn_ops_num;
+    populated_stmt_num += other.populated_stmt_num;
+    expr_nodes_num += other.expr_nodes_num;
+    max_expr_depth = std::max(max_expr_depth, other.max_expr_depth);
+    max_loop_depth = std::max(max_loop_depth, other.max_loop_depth);
+    stencil_num += other.stencil_num;
+    array_num += other.array_num;
+    pragma_num += other.pragma_num;
+    for (size_t i = 0; i < ub_num.size(); ++i)
+        ub_num.at(i) += other.ub_num.at(i);
+    for (size_t i = 0; i < ir_node_num.size(); ++i)
+        ir_node_num.at(i) += other.ir_node_num.at(i);
+    policy_copy_num += other.policy_copy_num;
+    reduction_eval_num += other.reduction_eval_num;
+    for (size_t i = 0; i < phases_num; ++i) {
+        phase_wall_ns.at(i) += other.phase_wall_ns.at(i);
+        phase_cpu_ns.at(i) += other.phase_cpu_ns.at(i);
+    }
+    alloc_stats.merge(other.alloc_stats);
+}
+
+void AllocStats::addObject(AllocKind kind, size_t bytes) {
+    if (!enabled)
+        return;
+    LiveCounter &counter = objects.at(static_cast<size_t>(kind));
+    add(counter.total, bytes);
+    add(counter.live, bytes);
+    counter.peak.num = std::max(counter.peak.num, counter.live.num);
+    counter.peak.bytes = std::max(counter.peak.bytes, counter.live.bytes);
+    updateLiveBytes(bytes, 0);
+}
+
+void AllocStats::removeObject(AllocKind kind, size_t bytes) {
+    if (!enabled)
+        return;
+    LiveCounter &counter = objects.at(static_cast<size_t>(kind));
+    counter.live.num--;
+    counter.live.bytes -= bytes;
+    updateLiveBytes(0, bytes);
+}
+
+void AllocStats::addArenaChunk(size_t bytes) {
+    if (!enabled)
+        return;
+    arena_used_bytes += bytes;
+    arena_peak_bytes = std::max(arena_peak_bytes, arena_used_bytes);
+    updateLiveBytes(bytes, 0);
+}
+
+void AllocStats::removeArenaChunk(size_t bytes) {
+    if (!enabled)
+        return;
+    arena_used_bytes -= bytes;
+    updateLiveBytes(0, bytes);
+}
+
+void AllocStats::merge(const AllocStats &other) {
+    enabled |= other.enabled;
+    auto merge_counter = [](Counter &to, const Counter &from) {
+        to.num += from.num;
+        to.bytes += from.bytes;
+    };
+    for (size_t i = 0; i < ir_nodes.size(); ++i)
+        merge_counter(ir_nodes.at(i), other.ir_nodes.at(i));
+    for (size_t i = 0; i < data.size(); ++i)
+        merge_counter(data.at(i), other.data.at(i));
+    // The peak of the task is reached on top of what is live in the parent
+    auto merge_peak = [](size_t &peak, size_t live, size_t other_peak) {
+        peak = std::max(peak, live + other_peak);
+    };
+    for (size_t i = 0; i < objects.size(); ++i) {
+        LiveCounter &to = objects.at(i);
+        const LiveCounter &from = other.objects.at(i);
+        merge_counter(to.total, from.total);
+        merge_peak(to.peak.num, to.live.num, from.peak.num);
+        merge_peak(to.peak.bytes, to.live.bytes, from.peak.bytes);
+        merge_counter(to.live, from.live);
+    }
+    merge_peak(arena_peak_bytes, arena_used_bytes, other.arena_peak_bytes);
+    arena_used_bytes += other.arena_used_bytes;
+    arena_reserved_bytes += other.arena_reserved_bytes;
+    merge_peak(peak_bytes, live_bytes, other.peak_bytes);
+    live_bytes += other.live_bytes;
+}
+
+static const char *getPhaseName(GenPhase phase) {
+    switch (phase) {
+        case GenPhase::STRUCTURE:
+            return "structure";
+        case GenPhase::POPULATE:
+            return "populate";
+        case GenPhase::REBUILD:
+            return "rebuild";
+        case GenPhase::EMIT_EXT_DECL:
+            return "emit_ext_decl";
+        case GenPhase::EMIT_TEST:
+            return "emit_test";
+        case GenPhase::EMIT_DECL:
+            return "emit_decl";
+        case GenPhase::EMIT_INIT:
+            return "emit_init";
+        case GenPhase::EMIT_CHECK:
+            return "emit_check";
+        case GenPhase::EMIT_MAIN:
+            return "emit_main";
+        case GenPhase::MAX_GEN_PHASE:
+            break;
+    }
+    ERROR("Bad generation phase");
+}
+
+Statistics::PhaseTimer::PhaseTimer(GenPhase _phase)
+    : stats(Statistics::getInstance()), phase(_phase),
+      span(getPhaseName(_phase), "phase"), wall_start(getWallTimeNs()),
+      cpu_start(getCPUTimeNs()) {}
+
+Statistics::PhaseTimer::~PhaseTimer() {
+    auto idx = static_cast<size_t>(phase);
+    stats.phase_wall_ns.at(idx) += getWallTimeNs() - wall_start;
+    stats.phase_cpu_ns.at(idx) += getCPUTimeNs() - cpu_start;
+}
+
+static const char *getIRNodeKindName(IRNodeKind kind) {
+    switch (kind) {
+        case IRNodeKind::CONST:
+            return "const";
+        case IRNodeKind::SCALAR_VAR_USE:
+            return "scalar_var_use";
+        case IRNodeKind::ITER_USE:
+            return "iter_use";
+        case IRNodeKind::ARRAY_USE:
+            return "array_use";
+        case IRNodeKind::SUBSCRIPT:
+            return "subscript";
+        case IRNodeKind::TYPE_CAST:
+            return "type_cast";
+        case IRNodeKind::ASSIGN:
+            return "assign";
+        case IRNodeKind::REDUCTION:
+            return "reduction";
+        case IRNodeKind::UNARY:
+            return "unary";
+        case IRNodeKind::BINARY:
+            return "binary";
+        case IRNodeKind::TERNARY:
+            return "ternary";
+        case IRNodeKind::CALL:
+            return "call";
+        case IRNodeKind::EXPR:
+            return "expr_stmt";
+        case IRNodeKind::DECL:
+            return "decl_stmt";
+        case IRNodeKind::BLOCK:
+            return "block";
+        case IRNodeKind::SCOPE:
+            return "scope";
+        case IRNodeKind::LOOP_SEQ:
+            return "loop_seq";
+        case IRNodeKind::LOOP_NEST:
+            return "loop_nest";
+        case IRNodeKind::IF_ELSE:
+            return "if_else";
+        case IRNodeKind::STUB:
+            return "stub";
+        case IRNodeKind::MAX_EXPR_KIND:
+        case IRNodeKind::MAX_STMT_KIND:
+        case IRNodeKind::STENCIL:
+            break;
+    }
+    return nullptr;
+}
+
+static const char *getDataKindName(DataKind kind) {
+    switch (kind) {
+        case DataKind::VAR:
+            return "scalar_var";
+        case DataKind::ARR:
+            return "array";
+        case DataKind::ITER:
+            return "iterator";
+        case DataKind::MAX_DATA_KIND:
+            // Data of the evaluation
+            return "typed_data";
+    }
+    ERROR("Bad data kind");
+}
+
+static const char *getAllocKindName(AllocKind kind) {
+    switch (kind) {
+        case AllocKind::INT_TYPE:
+            return "int_type";
+        case AllocKind::ARRAY_TYPE:
+            return "array_type";
+        case AllocKind::POPULATE_CTX:
+            return "populate_ctx";
+        case AllocKind::GEN_POLICY:
+            return "gen_policy";
+        case AllocKind::SYMBOL_TABLE:
+            return "symbol_table";
+        case AllocKind::MAX_ALLOC_KIND:
+            break;
+    }
+    ERROR("Bad alloc kind");
+}
+
+static const char *getUBKindName(UBKind kind) {
+    switch (kind) {
+        case UBKind::Uninit:
+            return "uninit";
+        case UBKind::SignOvf:
+            return "sign_ovf";
+        case UBKind::SignOvfMin:
+            return "sign_ovf_min";
+        case UBKind::ZeroDiv:
+            return "zero_div";
+        case UBKind::ShiftRhsNeg:
+            return "shift_rhs_neg";
+        case UBKind::ShiftRhsLarge:
+            return "shift_rhs_large";
+        case UBKind::NegShift:
+            return "neg_shift";
+        case UBKind::NoMemeber:
+            return "no_member";
+        case UBKind::OutOfBounds:
+            return "out_of_bounds";
+        case UBKind::NoUB:
+        case UBKind::MaxUB:
+            break;
+    }
+    ERROR("Bad UB kind");
+}
+
+static void dumpMs(std::ostream &stream, uint64_t ns) {
+    stream << ns / 1000000 << "." << std::setw(3) << std::setfill('0')
+           << ns / 1000 % 1000 << std::setfill(' ');
+}
+
+void Statistics::dumpJSON(std::ostream &stream) {
+    stream << "{\n";
+    stream << "    \"phases\": {";
+    for (size_t i = 0; i < phases_num; ++i) {
+        stream << (i == 0 ? "\n" : ",\n");
+        stream << "        \"" << getPhaseName(static_cast<GenPhase>(i))
+               << "\": {\"wall_ms\": ";
+        dumpMs(stream, phase_wall_ns.at(i));
+        stream << ", \"cpu_ms\": ";
+        dumpMs(stream, phase_cpu_ns.at(i));
+        stream << "}";
+    }
+    stream << "\n    },\n";
+
+    stream << "    \"ir_nodes\": {";
+    bool first = true;
+    for (size_t i = 0; i < ir_node_num.size(); ++i) {
+        const char *name = getIRNodeKindName(static_cast<IRNodeKind>(i));
+        if (name == nullptr)
+            continue;
+        stream << (first ? "\n" : ",\n");
+        stream << "        \"" << name << "\": " << ir_node_num.at(i);
+        first = false;
+    }
+    stream << "\n    },\n";
+
+    // Each fix of the UB is a retry of the rebuild
+    stream << "    \"ub_rebuilds\": {";
+    for (size_t i = 1; i < ub_num.size(); ++i) {
+        stream << (i == 1 ? "\n" : ",\n");
+        stream << "        \"" << getUBKindName(static_cast<UBKind>(i))
+               << "\": " << ub_num.at(i);
+    }
+    stream << "\n    },\n";
+
+    stream << "    \"policy_copies\": " << policy_copy_num << ",\n";
+    stream << "    \"reductions_evaluated\": " << reduction_eval_num << ",\n";
+    stream << "    \"stmt_num\": " << populated_stmt_num << ",\n";
+    stream << "    \"max_loop_depth\": " << max_loop_depth << ",\n";
+    stream << "    \"max_expr_depth\": " << max_expr_depth << ",\n";
+    stream << "    \"arrays\": " << array_num << ",\n";
+    stream << "    \"stencils\": " << stencil_num << ",\n";
+    stream << "    \"pragmas\": " << pragma_num << ",\n";
+    stream << "    \"dynamic_ops\": " << dyn_ops_num << ",\n";
+    stream << "    \"compile_cost\": " << getCompileCost();
+    if (alloc_stats.isEnabled()) {
+        stream << ",\n    \"allocations\": ";
+        alloc_stats.dumpJSON(stream);
+    }
+    stream << "\n}";
+}
+
+void AllocStats::dumpJSON(std::ostream &stream) {
+    auto dump_counter = [&stream](const char *name, const Counter &counter) {
+        stream << "\"" << name << "\": {\"num\": " << counter.num
+               << ", \"bytes\": " << counter.bytes << "}";
+    };
+    size_t total_bytes = 0;
+
+    stream << "{\n        \"ir_nodes\": {";
+    bool first = true;
+    for (size_t i = 0; i < ir_nodes.size(); ++i) {
+        const char *name = getIRNodeKindName(static_cast<IRNodeKind>(i));
+        if (name == nullptr)
+            continue;
+        stream << (first ? "\n" : ",\n") << "            ";
+        dump_counter(name, ir_nodes.at(i));
+        total_bytes += ir_nodes.at(i).bytes;
+        first = false;
+    }
+    stream << "\n        },\n";
+
+    stream << "        \"data\": {";
+    for (size_t i = 0; i < data.size(); ++i) {
+        stream << (i == 0 ? "\n" : ",\n") << "            ";
+        dump_counter(getDataKindName(static_cast<DataKind>(i)), data.at(i));
+        total_bytes += data.at(i).bytes;
+    }
+    stream << "\n        },\n";
+
+    stream << "        \"objects\": {";
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const LiveCounter &counter = objects.at(i);
+        stream << (i == 0 ? "\n" : ",\n") << "            \""
+               << getAllocKindName(static_cast<AllocKind>(i))
+               << "\": {\"num\": " << counter.total.num
+               << ", \"bytes\": " << counter.total.bytes
+               << ", \"peak_num\": " << counter.peak.num
+               << ", \"peak_bytes\": " << counter.peak.bytes << "}";
+        total_bytes += counter.total.bytes;
+    }
+    stream << "\n        },\n";
+
+    stream << "        \"arena\": {\"used_bytes\": " << arena_used_bytes
+           << ", \"peak_used_bytes\": " << arena_peak_bytes
+           << ", \"reserved_bytes\": " << arena_reserved_bytes << "},\n";
+    // Cumulative size of the accounted objects and the high-water mark of the
+    // memory in use (the arena plus the live objects)
+    stream << "        \"total_bytes\": " << total_bytes << ",\n";
+    stream << "        \"peak_bytes\": " << peak_bytes << "\n";
+    stream << "    }";
+}
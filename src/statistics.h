@@ -17,30 +17,242 @@ limitations under the License.
 #pragma once
 
 #include "enums.h"
+#include "trace.h"
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <cstdlib>
+#include <numeric>
+#include <ostream>
 
 namespace yarpgen {
-class Statistics {
+
+// Accounting of the memory of the generation. It is enabled with
+// --track-allocs; otherwise all of the methods return right away.
+// IR nodes are attributed to their kinds, while the arena keeps track of the
+// bytes that are actually in use (including the control blocks of the
+// pointers and the temporary data of the evaluation). Other objects are
+// accounted with their shallow size.
+class AllocStats {
   public:
-    static Statistics &getInstance() {
-        static Statistics instance;
-        return instance;
+    bool isEnabled() { return enabled; }
+
+    void addIRNode(IRNodeKind kind, size_t bytes) {
+        if (enabled)
+            add(ir_nodes.at(static_cast<size_t>(kind)), bytes);
+    }
+    // TypedData (temporary values of the evaluation) has no data kind
+    void addData(DataKind kind, size_t bytes) {
+        if (enabled)
+            add(data.at(static_cast<size_t>(kind)), bytes);
+    }
+
+    // Objects that can be released during the generation
+    void addObject(AllocKind kind, size_t bytes);
+    void removeObject(AllocKind kind, size_t bytes);
+
+    // Chunks of the arena
+    void addArenaChunk(size_t bytes);
+    void removeArenaChunk(size_t bytes);
+    void addArenaBlock(size_t bytes) {
+        if (enabled)
+            arena_reserved_bytes += bytes;
     }
+
+    // The peak of each task is counted on top of the objects that are live
+    // in the parent. The peaks of different tasks are not added up, so the
+    // overlap of the concurrent tasks is not accounted.
+    void merge(const AllocStats &other);
+    void dumpJSON(std::ostream &stream);
+
+  private:
+    friend class GenerationSession;
+    friend class Statistics;
+    AllocStats()
+        : enabled(false), ir_nodes({}), data({}), objects({}),
+          arena_used_bytes(0), arena_peak_bytes(0), arena_reserved_bytes(0),
+          live_bytes(0), peak_bytes(0) {}
+
+    struct Counter {
+        size_t num;
+        size_t bytes;
+    };
+    struct LiveCounter {
+        Counter total;
+        Counter live;
+        Counter peak;
+    };
+
+    static void add(Counter &counter, size_t bytes) {
+        counter.num++;
+        counter.bytes += bytes;
+    }
+    void updateLiveBytes(size_t added, size_t removed) {
+        live_bytes = live_bytes + added - removed;
+        peak_bytes = std::max(peak_bytes, live_bytes);
+    }
+
+    bool enabled;
+    std::array<Counter, static_cast<size_t>(IRNodeKind::MAX_STMT_KIND)>
+        ir_nodes;
+    std::array<Counter, static_cast<size_t>(DataKind::MAX_DATA_KIND) + 1> data;
+    std::array<LiveCounter, static_cast<size_t>(AllocKind::MAX_ALLOC_KIND)>
+        objects;
+    size_t arena_used_bytes;
+    size_t arena_peak_bytes;
+    size_t arena_reserved_bytes;
+    // The arena and the objects together
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+class Statistics {
+  public:
+    // Statistics of the generation session that is active on the current
+    // thread
+    static Statistics &getInstance();
     Statistics(const Statistics &options) = delete;
     Statistics &operator=(const Statistics &) = delete;
 
     void addStmt(size_t val = 1) { stmt_num += val; }
     size_t getStmtNum() { return stmt_num; }
 
+    // UB that was eliminated by rebuilding an expression
     void addUB(UBKind kind) { ub_num.at(static_cast<size_t>(kind))++; }
+    size_t getUBNum() {
+        // The first kind is NoUB
+        return std::accumulate(ub_num.begin() + 1, ub_num.end(),
+                               static_cast<size_t>(0));
+    }
+
+    void addIRNode(IRNodeKind kind) {
+        size_t idx = static_cast<size_t>(kind);
+        if (idx < ir_node_num.size())
+            ir_node_num.at(idx)++;
+    }
+    size_t getIRNodeNum() {
+        return std::accumulate(ir_node_num.begin(), ir_node_num.end(),
+                               static_cast<size_t>(0));
+    }
+    void addPolicyCopy() { policy_copy_num++; }
+    void addReductionEval() { reduction_eval_num++; }
+
+    // Measures the wall and CPU time of a phase of the generation. The phases
+    // can be nested (e.g., REBUILD is a part of POPULATE), so their times
+    // overlap.
+    class PhaseTimer {
+      public:
+        explicit PhaseTimer(GenPhase _phase);
+        ~PhaseTimer();
+        PhaseTimer(const PhaseTimer &) = delete;
+        PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+        // Span of the phase in the trace (if it is enabled)
+        TraceSpan &getSpan() { return span; }
+
+      private:
+        Statistics &stats;
+        GenPhase phase;
+        TraceSpan span;
+        uint64_t wall_start;
+        uint64_t cpu_start;
+    };
+
+    // Estimate of the number of operations that the test performs at run
+    // time: the expressions of test() multiplied by the trip counts of the
+    // enclosing loops, plus the initialization and the checksum of the arrays
+    void addDynOps(uint64_t val) { dyn_ops_num += val; }
+    uint64_t getDynOpsNum() { return dyn_ops_num; }
+
+    // Features of the populated test that make it expensive to compile
+    void addPopulatedStmt() { populated_stmt_num++; }
+    void addExprNodes(size_t val) { expr_nodes_num += val; }
+    void updateExprDepth(size_t val) {
+        max_expr_depth = std::max(max_expr_depth, val);
+    }
+    void updateLoopDepth(size_t val) {
+        max_loop_depth = std::max(max_loop_depth, val);
+    }
+    void addStencil() { stencil_num++; }
+    void addArray() { array_num++; }
+    void addPragmas(size_t val) { pragma_num += val; }
+
+    // Rough model of the compilation time. The size of the code is the base.
+    // Loops make each statement more expensive for the loop optimizations,
+    // while stencils and pragmas put extra work on the vectorizer and the
+    // unroller.
+    uint64_t getCompileCost() {
+        uint64_t code_size =
+            populated_stmt_num * 4 + expr_nodes_num + array_num * 2;
+        uint64_t loop_opt_work = stencil_num * 8 + pragma_num * 16;
+        return (code_size + loop_opt_work) * (max_loop_depth + 1) +
+               max_expr_depth * 16;
+    }
+
+    AllocStats &getAllocStats() { return alloc_stats; }
+
+    void merge(const Statistics &other);
+
+    // Dumps all of the counters and timers as a JSON object
+    void dumpJSON(std::ostream &stream);
 
   private:
-    Statistics() : stmt_num(0), ub_num({}) {}
+    friend class GenerationSession;
+    Statistics()
+        : stmt_num(0), dyn_ops_num(0), populated_stmt_num(0), expr_nodes_num(0),
+          max_expr_depth(0), max_loop_depth(0), stencil_num(0), array_num(0),
+          pragma_num(0), ub_num({}), ir_node_num({}), policy_copy_num(0),
+          reduction_eval_num(0), phase_wall_ns({}), phase_cpu_ns({}) {}
 
     size_t stmt_num;
-    // TODO: count undefined behavior stats
+    uint64_t dyn_ops_num;
+    size_t populated_stmt_num;
+    size_t expr_nodes_num;
+    size_t max_expr_depth;
+    size_t max_loop_depth;
+    size_t stencil_num;
+    size_t array_num;
+    size_t pragma_num;
     std::array<size_t, static_cast<size_t>(UBKind::MaxUB)> ub_num;
+    // Expressions and statements that were created (including the ones that
+    // were discarded later)
+    std::array<size_t, static_cast<size_t>(IRNodeKind::MAX_STMT_KIND)>
+        ir_node_num;
+    size_t policy_copy_num;
+    size_t reduction_eval_num;
+
+    static constexpr size_t phases_num =
+        static_cast<size_t>(GenPhase::MAX_GEN_PHASE);
+    std::array<uint64_t, phases_num> phase_wall_ns;
+    std::array<uint64_t, phases_num> phase_cpu_ns;
+
+    AllocStats alloc_stats;
+};
+
+// Member that accounts the lifetime of the enclosing object of type T with
+// --track-allocs. The statistics are not thread-safe, so the release is
+// accounted only if the object dies in the session that created it.
+template <typename T, AllocKind kind> class AllocCounter {
+  public:
+    AllocCounter() : alloc_stats(nullptr) { track(); }
+    AllocCounter(const AllocCounter &) : alloc_stats(nullptr) { track(); }
+    AllocCounter &operator=(const AllocCounter &) { return *this; }
+    ~AllocCounter() {
+        if (alloc_stats != nullptr &&
+            alloc_stats == &Statistics::getInstance().getAllocStats())
+            alloc_stats->removeObject(kind, sizeof(T));
+    }
+
+  private:
+    void track() {
+        AllocStats &cur_alloc_stats = Statistics::getInstance().getAllocStats();
+        if (!cur_alloc_stats.isEnabled())
+            return;
+        alloc_stats = &cur_alloc_stats;
+        alloc_stats->addObject(kind, sizeof(T));
+    }
+
+    AllocStats *alloc_stats;
 };
 
 } // namespace yarpgen
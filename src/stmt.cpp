@@ -26,6 +26,16 @@ limitations under the License.
 
 using namespace yarpgen;
 
+// The number of times that the code of the context is executed at run time
+static uint64_t getExecNum(std::shared_ptr<PopulateCtx> ctx) {
+    if (!ctx->isTaken())
+        return 0;
+    uint64_t ret = 1;
+    for (const auto &iter : ctx->getLocalSymTable()->getIters())
+        ret *= iter->getTotalItersNum();
+    return ret;
+}
+
 void ExprStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
                     std::string offset) {
     stream << offset;
@@ -34,6 +44,7 @@ void ExprStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 }
 
 std::shared_ptr<ExprStmt> ExprStmt::create(std::shared_ptr<PopulateCtx> ctx) {
+    TraceSpan span("ExprStmt::create", "populate");
     auto gen_pol = ctx->getGenPolicy();
 
     auto new_active_ctx = std::make_shared<PopulateCtx>(*ctx);
@@ -83,7 +94,12 @@ std::shared_ptr<ExprStmt> ExprStmt::create(std::shared_ptr<PopulateCtx> ctx) {
     if (new_active_ctx->getAllowMulVals())
         expr->propagateValue(eval_ctx);
 
-    return std::make_shared<ExprStmt>(expr);
+    Statistics &stats = Statistics::getInstance();
+    stats.addDynOps(getExecNum(ctx) * expr->getComplexity());
+    stats.addExprNodes(expr->getComplexity());
+    span.addArg("nodes", expr->getComplexity());
+
+    return makeIRNode<ExprStmt>(expr);
 }
 
 void DeclStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
@@ -101,13 +117,18 @@ void DeclStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 
 void StmtBlock::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
                      std::string offset) {
-    for (const auto &stmt : stmts) {
-        stmt->emit(ctx, stream, offset);
-        // TODO: will that work if we have suffix?
-        if (stmt->getKind() != IRNodeKind::LOOP_SEQ &&
-            stmt->getKind() != IRNodeKind::LOOP_NEST)
-            stream << "\n";
-    }
+    for (const auto &stmt : stmts)
+        emitStmt(ctx, stream, stmt, offset);
+}
+
+void StmtBlock::emitStmt(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
+                         const std::shared_ptr<Stmt> &stmt,
+                         std::string offset) {
+    stmt->emit(ctx, stream, std::move(offset));
+    // TODO: will that work if we have suffix?
+    if (stmt->getKind() != IRNodeKind::LOOP_SEQ &&
+        stmt->getKind() != IRNodeKind::LOOP_NEST)
+        stream << "\n";
 }
 
 std::shared_ptr<StmtBlock>
@@ -156,17 +177,58 @@ StmtBlock::generateStructure(std::shared_ptr<GenCtx> ctx) {
         stmts.push_back(new_stmt);
     }
 
-    return std::make_shared<StmtBlock>(stmts);
+    return makeIRNode<StmtBlock>(stmts);
+}
+
+// Once the test is too expensive to compile, the rest of the statements are
+// pruned instead of being populated
+static bool exceedsCompileCost() {
+    Options &options = Options::getInstance();
+    Statistics &stats = Statistics::getInstance();
+    return options.getMaxCompileCost() != 0 &&
+           stats.getCompileCost() > options.getMaxCompileCost();
+}
+
+void StmtBlock::populateStmt(std::shared_ptr<Stmt> &stmt,
+                             const std::shared_ptr<PopulateCtx> &ctx) {
+    Statistics &stats = Statistics::getInstance();
+    stats.addPopulatedStmt();
+    auto task_group = ctx->getTaskGroup();
+    if (stmt->getKind() == IRNodeKind::STUB)
+        stmt = ExprStmt::create(ctx);
+    // Compound statements are big enough to be worth a separate task
+    else if (task_group)
+        task_group->spawn(ctx, [stmt](std::shared_ptr<PopulateCtx> task_ctx) {
+            stmt->populate(std::move(task_ctx));
+        });
+    else
+        stmt->populate(ctx);
 }
 
 void StmtBlock::populate(std::shared_ptr<PopulateCtx> ctx) {
-    auto gen_pol = ctx->getGenPolicy();
+    TraceSpan span("StmtBlock::populate", "populate");
+    span.addArg("stmts", stmts.size());
+    for (auto iter = stmts.begin(); iter != stmts.end(); ++iter) {
+        if (exceedsCompileCost()) {
+            stmts.erase(iter, stmts.end());
+            break;
+        }
+        populateStmt(*iter, ctx);
+    }
+}
 
+void StmtBlock::populateAndRelease(std::shared_ptr<PopulateCtx> ctx,
+                                   const StmtConsumer &consumer) {
+    if (ctx->getTaskGroup())
+        ERROR("Statements of parallel tasks can't be released right away");
+    TraceSpan span("StmtBlock::populateAndRelease", "populate");
+    span.addArg("stmts", stmts.size());
     for (auto &stmt : stmts) {
-        if (stmt->getKind() != IRNodeKind::STUB)
-            stmt->populate(ctx);
-        else
-            stmt = ExprStmt::create(ctx);
+        if (!exceedsCompileCost()) {
+            populateStmt(stmt, ctx);
+            consumer(stmt);
+        }
+        stmt = nullptr;
     }
 }
 
@@ -180,7 +242,7 @@ void ScopeStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 std::shared_ptr<ScopeStmt>
 ScopeStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
     // TODO: will that work?
-    auto new_scope = std::make_shared<ScopeStmt>();
+    auto new_scope = makeIRNode<ScopeStmt>();
     auto stmt_block = StmtBlock::generateStructure(std::move(ctx));
     new_scope->stmts = stmt_block->getStmts();
     return new_scope;
@@ -301,6 +363,8 @@ void LoopHead::createPragmas(std::shared_ptr<PopulateCtx> ctx) {
     if (options.getEmitPragmas() == OptionLevel::ALL)
         pragmas_num = static_cast<size_t>(PragmaKind::MAX_PRAGMA_KIND) - 1;
     pragmas = Pragma::create(pragmas_num, ctx);
+    Statistics &stats = Statistics::getInstance();
+    stats.addPragmas(pragmas.size());
 }
 
 bool LoopHead::hasSIMDPragma() {
@@ -352,13 +416,13 @@ LoopSeqStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
 
     Options &options = Options::getInstance();
 
-    auto new_loop_seq = std::make_shared<LoopSeqStmt>();
+    auto new_loop_seq = makeIRNode<LoopSeqStmt>();
     auto new_ctx = std::make_shared<GenCtx>(*ctx);
     // TODO: is it the right place to do it?
     new_ctx->incLoopDepth(1);
     for (size_t i = 0; i < loop_num; ++i) {
         bool gen_foreach = false;
-        auto new_loop_head = std::make_shared<LoopHead>();
+        auto new_loop_head = makeIRNode<LoopHead>();
 
         if (options.isISPC())
             gen_foreach = !ctx->isInsideForeach() &&
@@ -399,8 +463,47 @@ static auto makeMutableRoll(std::shared_ptr<GenPolicy> gen_pol,
     return res;
 }
 
+// The size of the iteration space of a new top-level loop is chosen before its
+// body is populated, so we have to assume the worst case: all of the loops and
+// arrays inside use as many dimensions as the policy allows. The dimension is
+// reduced until this case fits into the rest of the dynamic operations budget.
+static size_t fitDimToDynOps(std::shared_ptr<GenPolicy> gen_pol, size_t dim) {
+    Options &options = Options::getInstance();
+    uint64_t max_dyn_ops = options.getMaxDynOps();
+    if (max_dyn_ops == 0)
+        return dim;
+
+    Statistics &stats = Statistics::getInstance();
+    uint64_t left_ops = max_dyn_ops > stats.getDynOpsNum()
+                            ? max_dyn_ops - stats.getDynOpsNum()
+                            : 0;
+    size_t dims_num =
+        std::max(gen_pol->array_dims_num_limit, gen_pol->loop_depth_limit);
+    while (dim > 1 && GenPolicy::estimateLoopDynOps(dim, dims_num) > left_ops)
+        dim--;
+    return dim;
+}
+
+// Nested foreach in ISPC needs the dimension in the form of a multiple of the
+// vector size plus the stencil span. It is rounded to this form and then it is
+// reduced by the vector size to fit into the dynamic operations budget, but
+// never below the smallest dimension of this form.
+static size_t fitDimToNestedForeach(std::shared_ptr<GenPolicy> gen_pol,
+                                    size_t dim) {
+    dim = std::max(gen_pol->ispc_iter_end_limit_max,
+                   (dim / ISPC_MAX_VECTOR_SIZE) * ISPC_MAX_VECTOR_SIZE +
+                       gen_pol->max_stencil_span);
+    while (dim > gen_pol->ispc_iter_end_limit_max &&
+           fitDimToDynOps(gen_pol, dim) < dim)
+        dim -= ISPC_MAX_VECTOR_SIZE;
+    return dim;
+}
+
 void LoopSeqStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
+    TraceSpan span("LoopSeqStmt::populate", "populate");
+    span.addArg("loops", loops.size());
     auto gen_pol = ctx->getGenPolicy();
+    Statistics &stats = Statistics::getInstance();
 
     size_t same_iter_space_counter = 0;
     size_t same_iter_space_dim = 0;
@@ -438,12 +541,10 @@ void LoopSeqStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
                         active_gen_pol->iters_end_limit_min,
                         active_gen_pol->iter_end_limit_max);
                 });
+                new_dim = fitDimToDynOps(active_gen_pol, new_dim);
                 Options &options = Options::getInstance();
                 if (options.isISPC() && detectNestedForeach())
-                    new_dim = std::max(gen_pol->ispc_iter_end_limit_max,
-                                       (new_dim / ISPC_MAX_VECTOR_SIZE) *
-                                               ISPC_MAX_VECTOR_SIZE +
-                                           gen_pol->max_stencil_span);
+                    new_dim = fitDimToNestedForeach(active_gen_pol, new_dim);
             }
             else
                 new_dim = new_ctx->getDimensions().front();
@@ -455,7 +556,7 @@ void LoopSeqStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
             auto prev_loop = loops.at(cur_idx - 1);
             auto prev_iter = prev_loop.first->getIterators().front();
             NameHandler &nh = NameHandler::getInstance();
-            new_iters = std::make_shared<Iterator>(
+            new_iters = makeIRNode<Iterator>(
                 nh.getIterName(), prev_iter->getType(), prev_iter->getStart(),
                 prev_iter->getMaxLeftOffset(), prev_iter->getEnd(),
                 prev_iter->getMaxRightOffset(), prev_iter->getStep(),
@@ -508,6 +609,9 @@ void LoopSeqStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
         // TODO: what if we have multiple iterators
         if (loop_head->getIterators().front()->isDegenerate())
             new_ctx->setTaken(false);
+        // Each iteration has to update and compare the iterator
+        stats.addDynOps(getExecNum(new_ctx));
+        stats.updateLoopDepth(new_ctx->getLoopDepth());
         new_ctx->setInsideForeach(loop_head->isForeach() ||
                                   ctx->isInsideForeach());
 
@@ -562,10 +666,10 @@ LoopNestStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
 
     Options &options = Options::getInstance();
 
-    auto new_loop_nest = std::make_shared<LoopNestStmt>();
+    auto new_loop_nest = makeIRNode<LoopNestStmt>();
     auto new_ctx = std::make_shared<GenCtx>(*ctx);
     for (size_t i = 0; i < nest_depth; ++i) {
-        auto new_loop = std::make_shared<LoopHead>();
+        auto new_loop = makeIRNode<LoopHead>();
 
         bool gen_foreach = false;
         if (options.isISPC())
@@ -589,7 +693,10 @@ LoopNestStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
 }
 
 void LoopNestStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
+    TraceSpan span("LoopNestStmt::populate", "populate");
+    span.addArg("loops", loops.size());
     auto gen_pol = ctx->getGenPolicy();
+    Statistics &stats = Statistics::getInstance();
     auto new_ctx = std::make_shared<PopulateCtx>(ctx);
     bool old_ctx_state = new_ctx->isTaken();
     auto taken_switch_id = loops.end();
@@ -613,12 +720,10 @@ void LoopNestStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
                 return rand_val_gen->getRandValue(gen_pol->iters_end_limit_min,
                                                   gen_pol->iter_end_limit_max);
             });
+            new_dim = fitDimToDynOps(gen_pol, new_dim);
             Options &options = Options::getInstance();
             if (options.isISPC() && detectNestedForeach())
-                new_dim = std::max(gen_pol->ispc_iter_end_limit_max,
-                                   (new_dim / ISPC_MAX_VECTOR_SIZE) *
-                                           ISPC_MAX_VECTOR_SIZE +
-                                       gen_pol->max_stencil_span);
+                new_dim = fitDimToNestedForeach(gen_pol, new_dim);
         }
         else
             new_dim = new_ctx->getDimensions().front();
@@ -645,6 +750,8 @@ void LoopNestStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
                                   new_ctx->isInsideForeach());
         if ((*i)->getIterators().front()->isDegenerate())
             new_ctx->setTaken(false);
+        stats.addDynOps(getExecNum(new_ctx));
+        stats.updateLoopDepth(new_ctx->getLoopDepth());
     }
 
     body->populate(new_ctx);
@@ -696,10 +803,11 @@ IfElseStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
     Statistics &stats = Statistics::getInstance();
     stats.addStmt();
 
-    return std::make_shared<IfElseStmt>(nullptr, then_br, else_br);
+    return makeIRNode<IfElseStmt>(nullptr, then_br, else_br);
 }
 
 void IfElseStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
+    TraceSpan span("IfElseStmt::populate", "populate");
     auto new_ctx = std::make_shared<PopulateCtx>(ctx);
     new_ctx->setAllowMulVals(false);
     // TODO: for now, we do not allow multiple if-else statements' conditions
@@ -714,13 +822,17 @@ void IfElseStmt::populate(std::shared_ptr<PopulateCtx> ctx) {
     std::shared_ptr<IntegralType> int_type =
         std::static_pointer_cast<IntegralType>(cond->getValue()->getType());
     if (int_type->getIntTypeId() != IntTypeID::BOOL) {
-        cond = std::make_shared<TypeCastExpr>(
+        cond = makeIRNode<TypeCastExpr>(
             cond,
             IntegralType::init(IntTypeID::BOOL, false, CVQualifier::NONE,
                                cond->getValue()->getType()->isUniform()),
             true);
     }
 
+    Statistics &stats = Statistics::getInstance();
+    stats.addDynOps(getExecNum(ctx) * cond->getComplexity());
+    stats.addExprNodes(cond->getComplexity());
+
     EvalCtx eval_ctx;
     std::shared_ptr<Data> cond_eval_res = cond->evaluate(eval_ctx);
     IRValue cond_val =
@@ -746,7 +858,7 @@ void StubStmt::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
 std::shared_ptr<StubStmt>
 StubStmt::generateStructure(std::shared_ptr<GenCtx> ctx) {
     NameHandler &nh = NameHandler::getInstance();
-    return std::make_shared<StubStmt>("Stub stmt #" + nh.getStubStmtIdx());
+    return makeIRNode<StubStmt>("Stub stmt #" + nh.getStubStmtIdx());
 }
 
 void Pragma::emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
@@ -783,7 +895,7 @@ std::shared_ptr<Pragma> Pragma::create(std::shared_ptr<PopulateCtx> ctx) {
         rand_val_gen->getRandId(gen_pol->pragma_kind_distr);
     if (pragma_kind == PragmaKind::MAX_PRAGMA_KIND)
         ERROR("Bad PragmaKind");
-    return std::make_shared<Pragma>(pragma_kind);
+    return makeIRNode<Pragma>(pragma_kind);
 }
 
 std::vector<std::shared_ptr<Pragma>>
@@ -24,6 +24,7 @@ limitations under the License.
 #include "expr.h"
 #include "ir_node.h"
 
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <numeric>
@@ -84,9 +85,17 @@ class StmtBlock : public Stmt {
 
     void emit(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
               std::string offset = "") override;
+    // Emits a single statement of the block
+    static void emitStmt(std::shared_ptr<EmitCtx> ctx, std::ostream &stream,
+                         const std::shared_ptr<Stmt> &stmt, std::string offset);
     static std::shared_ptr<StmtBlock>
     generateStructure(std::shared_ptr<GenCtx> ctx);
     void populate(std::shared_ptr<PopulateCtx> ctx) override;
+    // Each statement is passed to the consumer right after it is populated
+    // and then released, so the memory of the whole block is never needed
+    using StmtConsumer = std::function<void(const std::shared_ptr<Stmt> &)>;
+    void populateAndRelease(std::shared_ptr<PopulateCtx> ctx,
+                            const StmtConsumer &consumer);
 
     bool detectNestedForeach() override {
         return std::accumulate(stmts.begin(), stmts.end(), false,
@@ -97,6 +106,10 @@ class StmtBlock : public Stmt {
 
   protected:
     std::vector<std::shared_ptr<Stmt>> stmts;
+
+  private:
+    static void populateStmt(std::shared_ptr<Stmt> &stmt,
+                             const std::shared_ptr<PopulateCtx> &ctx);
 };
 
 class ScopeStmt : public StmtBlock {
@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "task_pool.h"
+
+#include <algorithm>
+
+using namespace yarpgen;
+
+// Pool and the index of the queue that belong to the current thread
+static thread_local TaskPool *cur_pool = nullptr;
+static thread_local size_t cur_worker_idx = 0;
+
+TaskPool::TaskPool(size_t threads_num) : pending_num(0), stop(false) {
+    threads_num = std::max(threads_num, static_cast<size_t>(1));
+    queues.reserve(threads_num);
+    for (size_t i = 0; i < threads_num; ++i)
+        queues.push_back(std::make_unique<Queue>());
+
+    workers.reserve(threads_num - 1);
+    for (size_t i = 1; i < threads_num; ++i)
+        workers.emplace_back(&TaskPool::workerLoop, this, i);
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stop = true;
+    }
+    sleep_cv.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+size_t TaskPool::getWorkerIdx() {
+    // Everybody except the workers shares the queue of the owner
+    return cur_pool == this ? cur_worker_idx : 0;
+}
+
+TaskPool::TaskPtr TaskPool::submit(std::function<void()> func) {
+    auto task = std::make_shared<Task>(std::move(func));
+    Queue &queue = *queues.at(getWorkerIdx());
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        pending_num++;
+    }
+    sleep_cv.notify_one();
+    return task;
+}
+
+TaskPool::TaskPtr TaskPool::pop(size_t worker_idx) {
+    for (size_t i = 0; i < queues.size(); ++i) {
+        Queue &queue = *queues.at((worker_idx + i) % queues.size());
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        TaskPtr ret;
+        // The most recent task of our own queue is likely to be hot in the
+        // cache, while the oldest tasks of the others are the biggest ones
+        if (i == 0) {
+            ret = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            ret = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        pending_num--;
+        return ret;
+    }
+    return nullptr;
+}
+
+void TaskPool::run(const TaskPtr &task) {
+    task->func();
+    // The captured state might own the pool, so it can't outlive the task
+    task->func = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        task->done = true;
+    }
+    sleep_cv.notify_all();
+}
+
+void TaskPool::wait(const TaskPtr &task) {
+    size_t worker_idx = getWorkerIdx();
+    while (!task->done) {
+        TaskPtr next = pop(worker_idx);
+        if (next) {
+            run(next);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(
+            lock, [this, &task]() { return task->done || pending_num > 0; });
+    }
+}
+
+void TaskPool::workerLoop(size_t worker_idx) {
+    cur_pool = this;
+    cur_worker_idx = worker_idx;
+    while (true) {
+        TaskPtr next = pop(worker_idx);
+        if (next) {
+            run(next);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(lock, [this]() { return stop || pending_num > 0; });
+        if (stop && pending_num == 0)
+            return;
+    }
+}
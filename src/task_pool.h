@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace yarpgen {
+
+// Work-stealing pool of threads. Each worker has its own queue: it pushes and
+// pops the tasks at the back, while the idle workers steal them from the front
+// of the other queues. A thread that waits for a task executes the pending
+// tasks in the meantime, so the tasks can spawn and wait for nested tasks
+// without exhausting the pool.
+class TaskPool {
+  public:
+    class Task;
+    using TaskPtr = std::shared_ptr<Task>;
+
+    // The thread that creates the pool is one of the workers (it runs the tasks
+    // while it waits for them), so only threads_num - 1 threads are started
+    explicit TaskPool(size_t threads_num);
+    ~TaskPool();
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    TaskPtr submit(std::function<void()> func);
+    void wait(const TaskPtr &task);
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<TaskPtr> tasks;
+    };
+
+    size_t getWorkerIdx();
+    TaskPtr pop(size_t worker_idx);
+    void run(const TaskPtr &task);
+    void workerLoop(size_t worker_idx);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Idle workers sleep until there is something to do
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<size_t> pending_num;
+    bool stop;
+};
+
+class TaskPool::Task {
+  public:
+    explicit Task(std::function<void()> _func)
+        : func(std::move(_func)), done(false) {}
+
+  private:
+    friend class TaskPool;
+    std::function<void()> func;
+    std::atomic<bool> done;
+};
+
+} // namespace yarpgen
@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2020, Intel Corporation
+Copyright (c) 2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "trace.h"
+#include "session.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+
+using namespace yarpgen;
+
+Tracer &Tracer::getInstance() {
+    return GenerationSession::getCurrent().getTracer();
+}
+
+uint64_t Tracer::getTimeNs() {
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - origin)
+        .count();
+}
+
+static size_t getThreadIdx() {
+    static std::atomic<size_t> last_thread_idx(0);
+    static thread_local size_t thread_idx = ++last_thread_idx;
+    return thread_idx;
+}
+
+void Tracer::addSpan(const char *name, const char *category, uint64_t start_ns,
+                     uint64_t end_ns, Args args) {
+    events.push_back(Event{name, category, start_ns, end_ns - start_ns,
+                           getThreadIdx(), std::move(args)});
+}
+
+void Tracer::merge(const Tracer &other) {
+    events.insert(events.end(), other.events.begin(), other.events.end());
+}
+
+// Trace-event format expects microseconds
+static void dumpUs(std::ostream &stream, uint64_t ns) {
+    stream << ns / 1000 << "." << std::setw(3) << std::setfill('0') << ns % 1000
+           << std::setfill(' ');
+}
+
+bool Tracer::dumpEvents(std::ostream &stream, size_t pid, bool is_first) {
+    for (const auto &event : events) {
+        stream << (is_first ? "" : ",\n");
+        is_first = false;
+        stream << "{\"name\": \"" << event.name << "\", \"cat\": \""
+               << event.category << "\", \"ph\": \"X\", \"ts\": ";
+        dumpUs(stream, event.start_ns);
+        stream << ", \"dur\": ";
+        dumpUs(stream, event.dur_ns);
+        stream << ", \"pid\": " << pid << ", \"tid\": " << event.tid;
+        if (!event.args.empty()) {
+            stream << ", \"args\": {";
+            for (size_t i = 0; i < event.args.size(); ++i)
+                stream << (i == 0 ? "" : ", ") << "\"" << event.args.at(i).first
+                       << "\": " << event.args.at(i).second;
+            stream << "}";
+        }
+        stream << "}";
+    }
+    return is_first;
+}
+
+void Tracer::dumpJSON(std::ostream &stream) {
+    stream << "{\"traceEvents\": [\n";
+    dumpEvents(stream, 1, true);
+    stream << "\n]}\n";
+}
+
+TraceSpan::TraceSpan(const char *_name, const char *_category)
+    : tracer(nullptr), name(_name), category(_category), start_ns(0) {
+    Tracer &cur_tracer = Tracer::getInstance();
+    if (!cur_tracer.isEnabled())
+        return;
+    tracer = &cur_tracer;
+    start_ns = Tracer::getTimeNs();
+}
+
+TraceSpan::~TraceSpan() {
+    if (tracer != nullptr)
+        tracer->addSpan(name, category, start_ns, Tracer::getTimeNs(),
+                        std::move(args));
+}
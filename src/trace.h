@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2020, Intel Corporation
+Copyright (c) 2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+     http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace yarpgen {
+
+// Tracer collects the spans of the generation of a single program. They are
+// dumped in Chrome trace-event format, so a slow seed can be inspected in
+// chrome://tracing or Perfetto. Tracing is enabled with --trace; otherwise
+// the spans are never recorded.
+class Tracer {
+  public:
+    // Tracer of the session that is bound to the current thread
+    static Tracer &getInstance();
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    bool isEnabled() { return enabled; }
+
+    using Args = std::vector<std::pair<const char *, uint64_t>>;
+    // Names and categories are expected to be string literals
+    void addSpan(const char *name, const char *category, uint64_t start_ns,
+                 uint64_t end_ns, Args args);
+
+    void merge(const Tracer &other);
+
+    // Dumps the events only (without the enclosing object). The programs of
+    // a bundle are distinguished by the process id.
+    // It returns false if something was written.
+    bool dumpEvents(std::ostream &stream, size_t pid, bool is_first);
+    // Dumps a complete trace
+    void dumpJSON(std::ostream &stream);
+
+    // All of the events use the same time origin, so the events of the task
+    // sessions and of the programs in a bundle line up
+    static uint64_t getTimeNs();
+
+  private:
+    friend class GenerationSession;
+    explicit Tracer(bool _enabled) : enabled(_enabled) {}
+
+    struct Event {
+        const char *name;
+        const char *category;
+        uint64_t start_ns;
+        uint64_t dur_ns;
+        // Small index of the thread, so the viewer shows the work of each
+        // population task on its own track
+        size_t tid;
+        Args args;
+    };
+
+    bool enabled;
+    std::vector<Event> events;
+};
+
+// RAII helper that records a span from its construction to its destruction.
+// If tracing is disabled, it doesn't touch the clock and doesn't allocate.
+class TraceSpan {
+  public:
+    TraceSpan(const char *_name, const char *_category);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    bool isEnabled() { return tracer != nullptr; }
+    // Extra information that is shown for the span in the viewer
+    void addArg(const char *arg_name, uint64_t val) {
+        if (tracer != nullptr)
+            args.emplace_back(arg_name, val);
+    }
+
+  private:
+    Tracer *tracer;
+    const char *name;
+    const char *category;
+    uint64_t start_ns;
+    Tracer::Args args;
+};
+
+} // namespace yarpgen
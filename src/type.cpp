@@ -24,18 +24,12 @@ limitations under the License.
 #include "enums.h"
 #include "expr.h"
 #include "ir_value.h"
+#include "session.h"
 #include "type.h"
 #include "utils.h"
 
 using namespace yarpgen;
 
-std::unordered_map<IntTypeKey, std::shared_ptr<IntegralType>, IntTypeKeyHasher>
-    yarpgen::IntegralType::int_type_set;
-
-std::unordered_map<ArrayTypeKey, std::shared_ptr<ArrayType>, ArrayTypeKeyHasher>
-    yarpgen::ArrayType::array_type_set;
-size_t yarpgen::ArrayType::uid_counter = 0;
-
 std::shared_ptr<IntegralType> yarpgen::IntegralType::init(IntTypeID _type_id) {
     return init(_type_id, false, CVQualifier::NONE);
 }
@@ -46,6 +40,7 @@ std::shared_ptr<IntegralType> IntegralType::init(IntTypeID _type_id,
                                                  bool _is_uniform) {
     // Folding set lookup
     IntTypeKey key(_type_id, _is_static, _cv_qual, _is_uniform);
+    auto &int_type_set = GenerationSession::getCurrent().getIntTypeSet();
     auto find_result = int_type_set.find(key);
     if (find_result != int_type_set.end())
         return find_result->second;
@@ -91,6 +86,8 @@ std::shared_ptr<IntegralType> IntegralType::init(IntTypeID _type_id,
     ret->setIsUniform(_is_uniform);
 
     int_type_set[key] = ret;
+    Statistics::getInstance().getAllocStats().addObject(AllocKind::INT_TYPE,
+                                                        sizeof(*ret));
     return ret;
 }
 
@@ -237,14 +234,18 @@ ArrayType::init(std::shared_ptr<Type> _base_type, std::vector<size_t> _dims,
                 bool _is_static, CVQualifier _cv_qual, bool _is_uniform) {
     ArrayTypeKey key(_base_type, _dims, ArrayKind::MAX_ARRAY_KIND, _is_static,
                      _cv_qual, _is_uniform);
+    GenerationSession &session = GenerationSession::getCurrent();
+    auto &array_type_set = session.getArrayTypeSet();
     auto find_res = array_type_set.find(key);
     if (find_res != array_type_set.end())
         return find_res->second;
 
-    auto ret = std::make_shared<ArrayType>(_base_type, _dims, _is_static,
-                                           _cv_qual, uid_counter++);
+    auto ret = std::make_shared<ArrayType>(
+        _base_type, _dims, _is_static, _cv_qual, session.getNextArrayTypeUID());
     ret->setIsUniform(_is_uniform);
     array_type_set[key] = ret;
+    Statistics::getInstance().getAllocStats().addObject(AllocKind::ARRAY_TYPE,
+                                                        sizeof(*ret));
     return ret;
 }
 
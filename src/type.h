@@ -134,13 +134,6 @@ class IntegralType : public ArithmeticType {
         return (isUniform() ? "uniform" : "varying") + std::string(" ");
     }
     std::string getNameImpl(std::shared_ptr<EmitCtx> ctx, std::string raw_name);
-
-  private:
-    // There is a fixed small number of possible integral types,
-    // so we use a folding set in order to save memory
-    static std::unordered_map<IntTypeKey, std::shared_ptr<IntegralType>,
-                              IntTypeKeyHasher>
-        int_type_set;
 };
 
 template <typename T> class IntegralTypeHelper : public IntegralType {
@@ -328,14 +321,6 @@ class ArrayType : public Type {
     std::shared_ptr<Type> makeVarying() override;
 
   private:
-    // Folding set for all of the array types.
-    static std::unordered_map<ArrayTypeKey, std::shared_ptr<ArrayType>,
-                              ArrayTypeKeyHasher>
-        array_type_set;
-    // The easiest way to compare array types is to assign a unique identifier
-    // to each of them and then compare it.
-    static size_t uid_counter;
-
     std::shared_ptr<Type> base_type;
     // Number of elements in each dimension
     std::vector<size_t> dimensions;
@@ -723,9 +723,51 @@ void singleCastTest(IntTypeID to_type_id, IntTypeID from_type_id) {
 
 ///////////////////////////////////////////////////////////////////////////
 
+template <typename T> void singleValueVectorTest(IntTypeID type_id) {
+    auto distr = getDistribution<T>();
+    auto bool_distr = getDistribution<bool>();
+    const size_t vals_num = 16;
+    IRValueVector vals;
+    std::vector<IRValue> expected;
+    for (size_t i = 0; i < vals_num; ++i) {
+        IRValue a(type_id);
+        a.getValueRef<T>() = static_cast<T>(distr(generator));
+        a.setUBCode(bool_distr(generator) ? UBKind::NoUB : UBKind::SignOvf);
+        vals.push_back(a);
+        expected.push_back(a);
+    }
+
+    // Overwrite one of the values to check that the arrays stay in sync
+    std::uniform_int_distribution<size_t> idx_distr(0, vals_num - 1);
+    size_t idx = idx_distr(generator);
+    expected.at(idx) = IRValue(type_id, IRValue::AbsValue{false, 1});
+    vals.set(idx, expected.at(idx));
+
+    for (size_t i = 0; i < vals_num; ++i) {
+        IRValue val = vals.get(i);
+        if (val.getIntTypeID() != expected.at(i).getIntTypeID() ||
+            vals.getIntTypeID(i) != type_id ||
+            val.getUBCode() != expected.at(i).getUBCode() ||
+            vals.hasUB(i) != expected.at(i).hasUB() ||
+            val.getValueRef<T>() != expected.at(i).getValueRef<T>())
+            std::cout << "ERROR: " << __FUNCTION__ << " " << typeid(T).name()
+                      << " " << i << std::endl;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 void ir_value_test() {
     int test_num = 100000;
 
+    for (int i = 0; i < test_num / 100; ++i) {
+        singleValueVectorTest<TypeBool::value_type>(IntTypeID::BOOL);
+        singleValueVectorTest<TypeSChar::value_type>(IntTypeID::SCHAR);
+        singleValueVectorTest<TypeUShort::value_type>(IntTypeID::USHORT);
+        singleValueVectorTest<TypeSInt::value_type>(IntTypeID::INT);
+        singleValueVectorTest<TypeULLong::value_type>(IntTypeID::ULLONG);
+    }
+
     for (int i = 0; i < test_num; ++i) {
         singleAddTest<TypeSInt::value_type>(IntTypeID::INT);
         singleAddTest<TypeUInt::value_type>(IntTypeID::UINT);
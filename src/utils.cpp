@@ -18,14 +18,19 @@ limitations under the License.
 //////////////////////////////////////////////////////////////////////////////
 
 #include "utils.h"
+#include "session.h"
 #include "type.h"
 #include <memory>
 
 using namespace yarpgen;
 
-std::shared_ptr<RandValGen> yarpgen::rand_val_gen;
+thread_local std::shared_ptr<RandValGen> yarpgen::rand_val_gen;
 
-RandValGen::RandValGen(uint64_t _seed) {
+NameHandler &NameHandler::getInstance() {
+    return GenerationSession::getCurrent().getNameHandler();
+}
+
+RandValGen::RandValGen(uint64_t _seed) : mut_seed(0), active_engine(0) {
     if (_seed != 0) {
         seed = _seed;
     }
@@ -33,8 +38,7 @@ RandValGen::RandValGen(uint64_t _seed) {
         std::random_device rd;
         seed = rd();
     }
-    std::cout << "/*SEED " << seed << "*/" << std::endl;
-    rand_gen = std::mt19937_64(seed);
+    getEngine() = std::mt19937_64(seed);
 }
 
 #define RandValueCase(__type_id__, gen_name, type_name)                        \
@@ -73,11 +77,11 @@ IRValue RandValGen::getRandValue(IntTypeID type_id) {
 }
 
 // Swap random generators that we use to make random decisions
-void RandValGen::switchMutationStates() { std::swap(prev_gen, rand_gen); }
+void RandValGen::switchMutationStates() { active_engine = 1 - active_engine; }
 
 void RandValGen::setSeed(uint64_t new_seed) {
     seed = new_seed;
-    rand_gen = std::mt19937_64(seed);
+    getEngine() = std::mt19937_64(seed);
 }
 
 // Mutations are driven by auxiliary random generator.
@@ -87,6 +91,33 @@ void RandValGen::setMutationSeed(uint64_t mutation_seed) {
         std::random_device rd;
         mutation_seed = rd();
     }
-    std::cout << "/*MUTATION_SEED " << mutation_seed << "*/" << std::endl;
-    prev_gen = std::mt19937_64(mutation_seed);
+    mut_seed = mutation_seed;
+    engines[1 - active_engine] = std::mt19937_64(mutation_seed);
+}
+
+// SplitMix64 finalizer. It is a bijection with good avalanche properties,
+// so close stream ids produce unrelated seeds.
+static uint64_t mixSeed(uint64_t val) {
+    val += 0x9e3779b97f4a7c15ULL;
+    val = (val ^ (val >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    val = (val ^ (val >> 27)) * 0x94d049bb133111ebULL;
+    return val ^ (val >> 31);
+}
+
+static uint64_t deriveSeed(uint64_t parent_seed, uint64_t stream_id) {
+    uint64_t ret = mixSeed(mixSeed(parent_seed) ^ stream_id);
+    // Zero seed is reserved
+    return ret != 0 ? ret : 1;
+}
+
+std::shared_ptr<RandValGen> RandValGen::split(uint64_t stream_id) const {
+    auto ret = std::make_shared<RandValGen>(deriveSeed(seed, stream_id));
+    if (mut_seed != 0) {
+        ret->mut_seed = deriveSeed(mut_seed, stream_id);
+        ret->engines[1] = std::mt19937_64(ret->mut_seed);
+    }
+    // The child continues in the same mode as its parent
+    if (active_engine != 0)
+        ret->switchMutationStates();
+    return ret;
 }
@@ -22,11 +22,15 @@ limitations under the License.
 #include "enums.h"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <iostream>
 #include <memory>
 #include <random>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace yarpgen {
 
@@ -42,7 +46,7 @@ class IRValue;
     } while (false)
 
 // This class links together id (for example, type of unary operator) and its
-// probability. Usually it is used in the form of std::vector<Probability<id>>
+// probability. Usually it is used in the form of ProbDistr<id> (see below)
 // and defines all possible variants for random decision (probability itself
 // measured in parts, similarly to std::discrete_distribution). Preferably, sum
 // of all probabilities in vector should be 100 (so we can treat 1 part as 1
@@ -50,8 +54,8 @@ class IRValue;
 template <typename T> class Probability {
   public:
     Probability(T _id, uint64_t _prob) : id(_id), prob(_prob) {}
-    T getId() { return id; }
-    uint64_t getProb() { return prob; }
+    T getId() const { return id; }
+    uint64_t getProb() const { return prob; }
 
     void increaseProb(uint64_t add_prob) { prob += add_prob; }
     void zeroProb() { prob = 0; }
@@ -80,6 +84,78 @@ operator<<(std::ostream &os, const Probability<T> &_prob) {
     return os;
 }
 
+// Distribution of IDs for random decisions. It behaves like
+// std::vector<Probability<id>>, but it also keeps a sampler, so we don't have
+// to build a new one for every random decision. The sampler is built on the
+// first use and dropped on any non-const access to the distribution.
+// Policies are copied a lot and usually only a few distributions are changed
+// in a copy, so the probabilities are shared between copies until one of them
+// is modified (copy-on-write). Because of that, iterators and references that
+// were obtained through non-const access shouldn't outlive a copy.
+template <typename T> class ProbDistr {
+  public:
+    using ProbVector = std::vector<Probability<T>>;
+    using iterator = typename ProbVector::iterator;
+    using const_iterator = typename ProbVector::const_iterator;
+
+    ProbDistr() = default;
+    ProbDistr(ProbVector _probs)
+        : probs(std::make_shared<ProbVector>(std::move(_probs))) {}
+
+    template <typename... Args> void emplace_back(Args &&... args) {
+        modify().emplace_back(std::forward<Args>(args)...);
+    }
+    void push_back(const Probability<T> &prob) { modify().push_back(prob); }
+    iterator erase(const_iterator first, const_iterator last) {
+        return modify().erase(first, last);
+    }
+    iterator erase(const_iterator pos) { return modify().erase(pos); }
+    void clear() { modify().clear(); }
+    void reserve(size_t size) { modify().reserve(size); }
+
+    iterator begin() { return modify().begin(); }
+    iterator end() { return modify().end(); }
+    const_iterator begin() const { return view().begin(); }
+    const_iterator end() const { return view().end(); }
+    Probability<T> &at(size_t idx) { return modify().at(idx); }
+    const Probability<T> &at(size_t idx) const { return view().at(idx); }
+    size_t size() const { return view().size(); }
+    bool empty() const { return view().empty(); }
+
+  private:
+    friend class RandValGen;
+
+    using Sampler = std::discrete_distribution<size_t>;
+    Sampler &getSampler() const {
+        if (!sampler) {
+            std::vector<double> weights;
+            weights.reserve(size());
+            for (const auto &prob : view())
+                weights.push_back(static_cast<double>(prob.getProb()));
+            sampler = std::make_shared<Sampler>(weights.begin(), weights.end());
+        }
+        return *sampler;
+    }
+
+    // Null pointer represents an empty distribution
+    const ProbVector &view() const {
+        static const ProbVector empty;
+        return probs ? *probs : empty;
+    }
+    ProbVector &modify() {
+        sampler.reset();
+        if (!probs)
+            probs = std::make_shared<ProbVector>();
+        else if (probs.use_count() > 1)
+            probs = std::make_shared<ProbVector>(*probs);
+        return *probs;
+    }
+
+    std::shared_ptr<ProbVector> probs;
+    // Copies of the distribution share the sampler until one of them changes
+    mutable std::shared_ptr<Sampler> sampler;
+};
+
 // According to the agreement, Random Value Generator is the only way to get any
 // random value in YARPGen. It is used for different random decisions all over
 // the source code.
@@ -99,7 +175,7 @@ class RandValGen {
         // $26.5.1.1e [rand.req.genl]. This issue is also discussed in issue
         // 2326 (closed as not a defect and reopened as feature request N4296).
         std::uniform_int_distribution<long long> dis(from, to);
-        return static_cast<T>(dis(rand_gen));
+        return static_cast<T>(dis(getEngine()));
     }
 
     template <typename T> T getRandValue() {
@@ -107,34 +183,33 @@ class RandValGen {
         std::uniform_int_distribution<long long> dis(
             static_cast<long long>(std::numeric_limits<T>::min()),
             static_cast<long long>(std::numeric_limits<T>::max()));
-        return static_cast<T>(dis(rand_gen));
+        return static_cast<T>(dis(getEngine()));
     }
 
     template <typename T> T getRandUnsignedValue() {
         // See note above about long long hack
         std::uniform_int_distribution<unsigned long long> dis(
             0, static_cast<unsigned long long>(std::numeric_limits<T>::max()));
-        return static_cast<T>(dis(rand_gen));
+        return static_cast<T>(dis(getEngine()));
     }
 
     IRValue getRandValue(IntTypeID type_id);
 
-    // Randomly chooses one of IDs, basing on std::vector<Probability<id>>.
-    template <typename T> T getRandId(std::vector<Probability<T>> vec) {
-        std::vector<double> discrete_dis_init;
-        for (auto i : vec)
-            discrete_dis_init.push_back(static_cast<double>(i.getProb()));
-
-        std::discrete_distribution<size_t> discrete_dis(
-            discrete_dis_init.begin(), discrete_dis_init.end());
-        size_t idx = discrete_dis(rand_gen);
-        return vec.at(idx).getId();
+    // Randomly chooses one of IDs, basing on ProbDistr<id>.
+    template <typename T> T getRandId(const ProbDistr<T> &distr) {
+        size_t idx = distr.getSampler()(getEngine());
+        return distr.at(idx).getId();
     }
 
     // Randomly choose element from a vector
     template <typename T> T &getRandElem(std::vector<T> &vec) {
         std::uniform_int_distribution<size_t> distr(0, vec.size() - 1);
-        size_t idx = distr(rand_gen);
+        size_t idx = distr(getEngine());
+        return vec.at(idx);
+    }
+    template <typename T> const T &getRandElem(const std::vector<T> &vec) {
+        std::uniform_int_distribution<size_t> distr(0, vec.size() - 1);
+        size_t idx = distr(getEngine());
         return vec.at(idx);
     }
 
@@ -144,7 +219,7 @@ class RandValGen {
         std::vector<T> ret;
         ret.reserve(num);
         std::sample(vec.begin(), vec.end(), std::back_inserter(ret), num,
-                    rand_gen);
+                    getEngine());
         return ret;
     }
 
@@ -152,20 +227,19 @@ class RandValGen {
     template <typename T>
     std::vector<T> getRandElems(const std::vector<T> &vec, size_t num) {
         auto ret = getRandElemsInOrder(vec, num);
-        std::shuffle(ret.begin(), ret.end(), rand_gen);
+        std::shuffle(ret.begin(), ret.end(), getEngine());
         return ret;
     }
 
     template <class T> void shuffleVector(std::vector<T> vec) {
-        std::shuffle(vec.begin(), vec.end(), rand_gen);
+        std::shuffle(vec.begin(), vec.end(), getEngine());
     }
 
     // To improve variety of generated tests, we implement shuffling of
     // input probabilities (they are stored in GenPolicy).
     // TODO: sometimes this action increases test complexity, and tests becomes
     // non-generatable.
-    template <typename T>
-    void shuffleProb(std::vector<Probability<T>> &prob_vec) {
+    template <typename T> void shuffleProb(ProbDistr<T> &prob_vec) {
         uint64_t total_prob = 0;
         std::vector<double> discrete_dis_init;
         std::vector<Probability<T>> new_prob;
@@ -176,13 +250,13 @@ class RandValGen {
         }
 
         std::uniform_int_distribution<uint64_t> dis(1ULL, total_prob);
-        auto delta = static_cast<uint64_t>(
-            round(((double)total_prob) / static_cast<double>(dis(rand_gen))));
+        auto delta = static_cast<uint64_t>(round(
+            ((double)total_prob) / static_cast<double>(dis(getEngine()))));
 
         std::discrete_distribution<uint64_t> discrete_dis(
             discrete_dis_init.begin(), discrete_dis_init.end());
         for (uint64_t i = 0; i < total_prob; i += delta)
-            new_prob.at(static_cast<size_t>(discrete_dis(rand_gen)))
+            new_prob.at(static_cast<size_t>(discrete_dis(getEngine())))
                 .increaseProb(delta);
 
         prob_vec = new_prob;
@@ -192,41 +266,71 @@ class RandValGen {
     void setSeed(uint64_t new_seed);
     void switchMutationStates();
     void setMutationSeed(uint64_t mutation_seed);
+    uint64_t getMutationSeed() const { return mut_seed; }
+
+    // Creates an independent random generator for the given stream. It
+    // depends only on the seeds and the stream id, and it doesn't use or
+    // change the state of the current generator. This way independent parts
+    // of the test can be generated in any order (or in parallel) and still
+    // produce the same test. A generator of a stream can be split further.
+    std::shared_ptr<RandValGen> split(uint64_t stream_id) const;
 
   private:
+    std::mt19937_64 &getEngine() { return engines[active_engine]; }
+
     uint64_t seed;
-    std::mt19937_64 rand_gen;
-    // Auxiliary random generator, used for mutation
-    std::mt19937_64 prev_gen;
+    uint64_t mut_seed;
+    // Main and auxiliary (used for mutation) random generators.
+    // Switching between them just changes the index of the active one.
+    std::array<std::mt19937_64, 2> engines;
+    size_t active_engine;
 };
 
 template <> inline bool RandValGen::getRandValue<bool>(bool from, bool to) {
     std::uniform_int_distribution<int> dis((int)from, (int)to);
-    return (bool)dis(rand_gen);
+    return (bool)dis(getEngine());
 }
 
-extern std::shared_ptr<RandValGen> rand_val_gen;
+// Random generator of the generation session that is active on the current
+// thread (see GenerationSession::Scope)
+extern thread_local std::shared_ptr<RandValGen> rand_val_gen;
 
 class NameHandler {
   public:
-    static NameHandler &getInstance() {
-        static NameHandler instance;
-        return instance;
-    }
+    // NameHandler of the generation session that is active on the current
+    // thread
+    static NameHandler &getInstance();
     NameHandler(const NameHandler &root) = delete;
     NameHandler &operator=(const NameHandler &) = delete;
 
     std::string getStubStmtIdx() { return std::to_string(stub_stmt_idx++); }
-    std::string getVarName() { return "var_" + std::to_string(var_idx++); }
-    std::string getArrayName() { return "arr_" + std::to_string(arr_idx++); }
+    std::string getVarName() {
+        return prefix + "var_" + std::to_string(var_idx++);
+    }
+    std::string getArrayName() {
+        return prefix + "arr_" + std::to_string(arr_idx++);
+    }
     std::string getIterName() { return "i_" + std::to_string(iter_idx++); }
 
+    // Data that was created by parallel population tasks has to be renamed,
+    // so the numbering starts again after the given number of vars and arrays
+    void restartDataNames(uint32_t vars_num, uint32_t arrays_num) {
+        var_idx = vars_num;
+        arr_idx = arrays_num;
+    }
+
+    // Global data of different tests in one bundle must have different names
+    void setPrefix(std::string _prefix) { prefix = std::move(_prefix); }
+    std::string getPrefix() { return prefix; }
+
   private:
+    friend class GenerationSession;
     NameHandler() : var_idx(0), arr_idx(0), iter_idx(0), stub_stmt_idx(0) {}
 
     uint32_t var_idx;
     uint32_t arr_idx;
     uint32_t iter_idx;
     uint32_t stub_stmt_idx;
+    std::string prefix;
 };
 } // namespace yarpgen
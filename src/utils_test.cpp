@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2020, Intel Corporation
+Copyright (c) 2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "utils.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace yarpgen;
+
+#define CHECK(cond, msg)                                                       \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            std::cerr << "ERROR at " << __FILE__ << ":" << __LINE__            \
+                      << ", function " << __func__ << "():\n    " << (msg)     \
+                      << std::endl;                                            \
+            abort();                                                           \
+        }                                                                      \
+    } while (false)
+
+static const size_t VALS_NUM = 256;
+static const uint64_t STREAMS_NUM = 64;
+
+static std::vector<uint64_t> getVals(RandValGen &gen) {
+    std::vector<uint64_t> ret;
+    ret.reserve(VALS_NUM);
+    for (size_t i = 0; i < VALS_NUM; ++i)
+        ret.push_back(gen.getRandUnsignedValue<uint64_t>());
+    return ret;
+}
+
+// The child streams depend only on the seed and the stream id
+static void splitReproducibilityTest() {
+    for (uint64_t seed : {1ULL, 42ULL, 0xffffffffffffffffULL}) {
+        RandValGen gen(seed);
+        RandValGen same_gen(seed);
+        // The state of the parent doesn't matter
+        getVals(same_gen);
+        for (uint64_t stream_id = 0; stream_id < STREAMS_NUM; ++stream_id) {
+            auto child = gen.split(stream_id);
+            auto same_child = same_gen.split(stream_id);
+            CHECK(child->getSeed() != 0, "Zero seed of a stream");
+            CHECK(child->getSeed() == same_child->getSeed(), "Stream seed");
+            CHECK(getVals(*child) == getVals(*same_child), "Stream values");
+            CHECK(getVals(*child->split(stream_id)) ==
+                      getVals(*same_child->split(stream_id)),
+                  "Nested stream values");
+        }
+
+        // Splitting doesn't change the state of the parent
+        RandValGen ref_gen(seed);
+        RandValGen split_gen(seed);
+        split_gen.split(0);
+        split_gen.split(1);
+        CHECK(getVals(ref_gen) == getVals(split_gen), "Parent state");
+    }
+
+    // Mutation seed is inherited by the streams, so the mutated tests can be
+    // reproduced as well
+    RandValGen mut_gen(42);
+    mut_gen.setMutationSeed(7);
+    RandValGen same_mut_gen(42);
+    same_mut_gen.setMutationSeed(7);
+    auto mut_child = mut_gen.split(3);
+    auto same_mut_child = same_mut_gen.split(3);
+    CHECK(mut_child->getMutationSeed() != 0, "Mutation seed of a stream");
+    CHECK(mut_child->getMutationSeed() == same_mut_child->getMutationSeed(),
+          "Mutation seed");
+    mut_child->switchMutationStates();
+    same_mut_child->switchMutationStates();
+    CHECK(getVals(*mut_child) == getVals(*same_mut_child),
+          "Mutation stream values");
+}
+
+// The streams of the parent, their own streams and the streams of the other
+// seeds have different seeds and don't share any of the values
+static void splitOverlapTest() {
+    std::map<uint64_t, std::string> seeds;
+    std::map<uint64_t, std::string> vals;
+    auto add_stream = [&seeds, &vals](RandValGen &gen,
+                                      const std::string &name) {
+        auto seed_res = seeds.emplace(gen.getSeed(), name);
+        CHECK(seed_res.second, "Seed of " + name + " is the same as of " +
+                                   seed_res.first->second);
+        for (uint64_t val : getVals(gen)) {
+            auto val_res = vals.emplace(val, name);
+            CHECK(val_res.second || val_res.first->second == name,
+                  "Stream " + name + " overlaps with " + val_res.first->second);
+        }
+    };
+
+    for (uint64_t seed : {1ULL, 2ULL, 42ULL}) {
+        std::string seed_name = std::to_string(seed);
+        RandValGen gen(seed);
+        for (uint64_t stream_id = 0; stream_id < STREAMS_NUM; ++stream_id) {
+            std::string name = seed_name + "." + std::to_string(stream_id);
+            auto child = gen.split(stream_id);
+            for (uint64_t nested_id = 0; nested_id < 4; ++nested_id)
+                add_stream(*child->split(nested_id),
+                           name + "." + std::to_string(nested_id));
+            add_stream(*child, name);
+        }
+        add_stream(gen, seed_name);
+    }
+}
+
+int main() {
+    splitReproducibilityTest();
+    splitOverlapTest();
+}
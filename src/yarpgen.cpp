@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#include "yarpgen.h"
+#include "options.h"
+#include "program.h"
+#include "session.h"
+
+#include <sstream>
+
+using namespace yarpgen;
+
+GenOptions::GenOptions() {
+    holder = GenerationSession::createOptionsHolder(
+        GenerationSession::getDefault().getOptions());
+    // The default session might hold command-line options, so we reset
+    // everything to the defaults
+    GenerationSession::Scope options_scope(*holder);
+    OptionParser::initOptions();
+    // Raw options are used to reproduce the test from the command line
+    Options::getInstance().setRawOptions({"yarpgen"});
+}
+
+GenOptions::GenOptions(const GenOptions &other)
+    : holder(
+          GenerationSession::createOptionsHolder(other.holder->getOptions())) {}
+
+bool GenOptions::set(const std::vector<std::string> &args,
+                     std::string &err_msg) {
+    // The arguments are applied to a copy, so the options stay consistent if
+    // any of them is rejected
+    auto new_holder =
+        GenerationSession::createOptionsHolder(holder->getOptions());
+    GenerationSession::Scope options_scope(*new_holder);
+    if (!OptionParser::parseOverrides(args, err_msg) ||
+        !OptionParser::validate(err_msg))
+        return false;
+    std::vector<std::string> raw_options =
+        new_holder->getOptions().getRawOptions();
+    raw_options.insert(raw_options.end(), args.begin(), args.end());
+    new_holder->getOptions().setRawOptions(raw_options);
+    holder = std::move(new_holder);
+    return true;
+}
+
+Options &GenOptions::getOptions() const { return holder->getOptions(); }
+
+GeneratedProgram yarpgen::generate(const GenOptions &options, uint64_t seed) {
+    Options prog_options(options.getOptions());
+    prog_options.setSeed(seed);
+
+    // Seed banners are not interesting, the seed is returned
+    std::stringstream log;
+    auto session = std::make_shared<GenerationSession>(prog_options, log);
+    Options &session_options = session->getOptions();
+    std::vector<std::string> raw_options = session_options.getRawOptions();
+    raw_options.push_back("--seed=" +
+                          std::to_string(session_options.getSeed()));
+    session_options.setRawOptions(raw_options);
+    ProgramGenerator program(session);
+
+    std::stringstream init_ss, func_ss, driver_ss;
+    std::vector<std::string> part_file_names = program.getFuncPartFileNames();
+    std::vector<std::stringstream> part_ss(part_file_names.size());
+    std::vector<std::ostream *> part_streams;
+    for (auto &ss : part_ss)
+        part_streams.push_back(&ss);
+    program.emit(init_ss, func_ss, part_streams, driver_ss);
+
+    GeneratedProgram ret;
+    ret.seed = session_options.getSeed();
+    ret.init = {"init.h", init_ss.str()};
+    ret.func = {program.getFuncFileName(), func_ss.str()};
+    ret.driver = {program.getDriverFileName(), driver_ss.str()};
+    for (size_t i = 0; i < part_ss.size(); ++i)
+        ret.func_parts.push_back({part_file_names.at(i), part_ss.at(i).str()});
+    ret.checksum = 0;
+    ret.has_checksum = program.getPrecomputedHash(ret.checksum);
+    return ret;
+}
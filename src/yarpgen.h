@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2015-2020, Intel Corporation
+Copyright (c) 2019-2020, University of Utah
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Public in-memory interface of yarpgen_lib. It allows to generate tests
+// without touching the filesystem (e.g., from a fuzzing harness or from
+// an in-process compiler driver). The only exception is "--stream-emit",
+// which keeps the memory bounded by spilling the body of the test function
+// to an anonymous temporary file.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace yarpgen {
+
+class GenerationSession;
+class Options;
+
+// Options of the generated program. They start with the same defaults as
+// the command-line tool and can be changed with the same long-form
+// arguments (e.g., "--std=c" or "--check-algo=asserts").
+class GenOptions {
+  public:
+    GenOptions();
+    GenOptions(const GenOptions &other);
+    GenOptions &operator=(const GenOptions &) = delete;
+
+    // Applies the arguments in order. If any of them is unknown or has
+    // an invalid value, or the resulting options can't be used together
+    // (e.g., "--std=sycl" and "--tu-count=2"), it returns false, sets the
+    // error message and leaves the options unchanged.
+    // Options that don't make sense for a single program (e.g., --batch)
+    // or write additional files (e.g., --stats-json) are rejected.
+    bool set(const std::vector<std::string> &args, std::string &err_msg);
+
+    Options &getOptions() const;
+
+  private:
+    // Options are modified with the OptionParser, so they have to live inside
+    // of a session that can be bound to the thread
+    std::shared_ptr<GenerationSession> holder;
+};
+
+struct GeneratedFile {
+    std::string name;
+    std::string content;
+};
+
+struct GeneratedProgram {
+    // The seed that was actually used (if zero seed was requested,
+    // it is chosen randomly)
+    uint64_t seed;
+    GeneratedFile init;
+    GeneratedFile func;
+    GeneratedFile driver;
+    // Translation units with the parts of the test function
+    // (only if it was generated with "--tu-count" greater than one)
+    std::vector<GeneratedFile> func_parts;
+    // The checksum that the test is expected to print. It is known only if
+    // the test was generated with "--check-algo=precompute" or
+    // "--check-algo=tree-hash" and the elements that the test writes to each
+    // of the output arrays can be determined.
+    bool has_checksum;
+    uint64_t checksum;
+};
+
+// Generates a single test program. Zero seed means "choose any".
+// It is safe to call it from several threads at the same time.
+GeneratedProgram generate(const GenOptions &options, uint64_t seed);
+
+} // namespace yarpgen